@@ -12,23 +12,71 @@ TARGET = OpenGL_buzzballs
 TEMPLATE = app
 CONFIG += c++14
 
+# Frame profiler, toggled with the 'P' key. Remove to compile it out entirely.
+DEFINES += BUZZ_PROFILING
+
 SOURCES += main.cpp\
     mainwindow.cpp \
     mainview.cpp \
     user_input.cpp \
     model.cpp \
+    model_cache.cpp \
+    objparser.cpp \
     batch.cpp \
+    mesh_arena.cpp \
+    range_allocator.cpp \
     transform.cpp \
     material.cpp \
-    animation.cpp
+    animation.cpp \
+    animation_graph.cpp \
+    job_system.cpp \
+    culling.cpp \
+    lod.cpp \
+    instancing.cpp \
+    deform_cache.cpp \
+    ring_buffer.cpp \
+    render_queue.cpp \
+    shader_permutations.cpp \
+    light_grid.cpp \
+    program_cache.cpp \
+    texture_loader.cpp \
+    texture_compression.cpp \
+    buzz_reference.cpp \
+    scene.cpp \
+    headless.cpp \
+    profiler.cpp
 
 HEADERS  += mainwindow.h \
     mainview.h \
     model.h \
+    objparser.h \
+    parallel.h \
     batch.h \
+    mesh_arena.h \
+    range_allocator.h \
     transform.h \
     material.h \
-    animation.h
+    animation.h \
+    animation_graph.h \
+    job_system.h \
+    culling.h \
+    lod.h \
+    instancing.h \
+    deform_cache.h \
+    ring_buffer.h \
+    render_queue.h \
+    radix_sort.h \
+    shader_permutations.h \
+    light_grid.h \
+    program_cache.h \
+    texture_loader.h \
+    texture_compression.h \
+    buzz_reference.h \
+    scene.h \
+    headless.h \
+    profiler.h \
+    uniforms.h \
+    simd.h
 
 FORMS    += mainwindow.ui
 
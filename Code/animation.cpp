@@ -1,5 +1,7 @@
 #include "animation.h"
 
+#include <algorithm>
+
 // Documentation can be found in the animation.h file
 
 AnimatedBatch::AnimatedBatch( std::shared_ptr< GeneralBatch > pBatch,
@@ -11,20 +13,34 @@ AnimatedBatch::AnimatedBatch( std::shared_ptr< GeneralBatch > pBatch,
 
 }
 
-void AnimatedBatch::render( QOpenGLShaderProgram *pProgram, float time ) {
-    // Bind materials
-    pMaterial->applyTo( *pProgram );
+RingBuffer::Allocation AnimatedBatch::writeObject( RingBuffer& ringBuffer, const QMatrix4x4& modelMat,
+                                                  const QMatrix3x3& normalMat, float spike ) {
+    RingBuffer::Allocation allocation = ringBuffer.allocateUniform( sizeof( ObjectBlock ) );
+    ObjectBlock& block = *static_cast< ObjectBlock * >( allocation.pData );
 
-    QMatrix4x4 composedMat;
-    for ( std::shared_ptr< TransformAnimator >& aTrans : animators ) {
-        composedMat = composedMat * aTrans->transformAt( time ).matrix( );
+    std::copy( modelMat.constData( ), modelMat.constData( ) + 16, block.modelMat );
+    for ( int column = 0; column < 3; column++ ) {
+        std::copy( normalMat.constData( ) + 3 * column, normalMat.constData( ) + 3 * column + 3, block.normalMat[ column ] );
     }
+    block.spike = spike;
+    return allocation;
+}
+
+void AnimatedBatch::render( RingBuffer& ringBuffer, const RingBuffer::Allocation& object, int level ) {
+    // Bind materials
+    pMaterial->applyTo( );
 
-    pProgram->setUniformValue( "u_modelMat", composedMat );
-    pProgram->setUniformValue( "u_normalMat", composedMat.normalMatrix() );
+    ringBuffer.bindUniform( UB_OBJECT, object );
 
     // Draw here
-    pBatch->draw( );
+    levelBatch( level )->draw( );
+}
+
+const std::shared_ptr< GeneralBatch >& AnimatedBatch::levelBatch( int level ) const {
+    if ( level <= 0 || lodBatches.empty( ) ) {
+        return pBatch;
+    }
+    return lodBatches[ std::min( level, int( lodBatches.size( ) ) ) - 1 ];
 }
 
 // -- RotationAnimator --
@@ -8,6 +8,7 @@
 #include "transform.h"
 #include "material.h"
 #include "batch.h"
+#include "ring_buffer.h"
 
 /**
  * @brief The TransformAnimator class is the super class for any animation
@@ -26,6 +27,8 @@ public:
 class AnimatedBatch {
 public:
     std::shared_ptr< GeneralBatch > pBatch;
+    // Coarser versions of pBatch, from fine to coarse. May be empty.
+    std::vector< std::shared_ptr< GeneralBatch > > lodBatches;
     std::shared_ptr< Material > pMaterial;
     std::vector< std::shared_ptr< TransformAnimator > > animators;
 
@@ -33,11 +36,29 @@ public:
                    const std::shared_ptr< Material >& pMaterial,
                    std::vector< std::shared_ptr< TransformAnimator > >& animators );
     /**
-     * @brief render Renders the batch with the transformation at the specified time
-     * @param pProgram The program for which the material should be set
-     * @param time The time at which the transforms should be evaluated
+     * @brief writeObject Writes the per-object parameters of the batch for this frame
+     * @param ringBuffer The buffer to write the 'Object' uniform block to
+     * @param modelMat The model matrix of the batch, as obtained from an AnimationGraph
+     * @param normalMat The normal matrix belonging to the model matrix
+     * @param spike The spike factor of the buzz ball
+     * @return The range to pass to render( ), once the ring buffer is unmapped
      */
-    void render( QOpenGLShaderProgram *pProgram, float time );
+    static RingBuffer::Allocation writeObject( RingBuffer& ringBuffer, const QMatrix4x4& modelMat,
+                                               const QMatrix3x3& normalMat, float spike );
+
+    /**
+     * @brief render Renders the batch with the given per-object parameters
+     * @param ringBuffer The buffer the parameters were written to
+     * @param object The parameters, as returned by writeObject( )
+     * @param level The level of detail to draw, see levelBatch( )
+     */
+    void render( RingBuffer& ringBuffer, const RingBuffer::Allocation& object, int level = 0 );
+
+    /**
+     * @brief levelBatch Returns the batch of the given level of detail, where level 0
+     *   is pBatch. Levels beyond the coarsest one return the coarsest one.
+     */
+    const std::shared_ptr< GeneralBatch >& levelBatch( int level ) const;
 private:
     QOpenGLFunctions_3_3_Core *pGl;
 };
@@ -50,6 +71,8 @@ class RotationAnimator : public TransformAnimator {
 public:
     RotationAnimator( QVector3D rotVec );
     Transform3f transformAt( float time );
+
+    QVector3D rotationVector( ) const { return rotVec; }
 private:
     QVector3D rotVec;
 };
@@ -62,6 +85,10 @@ class BounceAnimator : public TransformAnimator {
 public:
     BounceAnimator( float lowY, float highY, float speed );
     Transform3f transformAt( float time );
+
+    float lowestY( ) const { return lowY; }
+    float highestY( ) const { return highY; }
+    float bounceSpeed( ) const { return speed; }
 private:
     float lowY, highY;
     float speed;
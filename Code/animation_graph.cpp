@@ -0,0 +1,344 @@
+#include "animation_graph.h"
+#include "job_system.h"
+#include "simd.h"
+
+#include <algorithm>
+
+// Documentation can be found in the animation_graph.h file
+
+// Converts a matrix to affine form; column-major without the last row
+static void toAffine( const QMatrix4x4& matrix, float out[ 12 ] ) {
+    const float *data = matrix.constData( );
+    for ( int c = 0; c < 4; c++ ) {
+        for ( int r = 0; r < 3; r++ ) {
+            out[ c * 3 + r ] = data[ c * 4 + r ];
+        }
+    }
+}
+
+// out = a * b, for affine matrices. out may not be a or b.
+template< typename S >
+static inline void mulAffine( const S a[ 12 ], const S b[ 12 ], S out[ 12 ] ) {
+    for ( int c = 0; c < 4; c++ ) {
+        for ( int r = 0; r < 3; r++ ) {
+            S value = a[ r ] * b[ c * 3 ] + a[ 3 + r ] * b[ c * 3 + 1 ] + a[ 6 + r ] * b[ c * 3 + 2 ];
+            out[ c * 3 + r ] = ( c == 3 ) ? value + a[ 9 + r ] : value;
+        }
+    }
+}
+
+// m = m * r, where r is a column-major 3x3 rotation
+template< typename S >
+static inline void mulRotation( S m[ 12 ], const S r[ 9 ] ) {
+    S out[ 9 ];
+    for ( int c = 0; c < 3; c++ ) {
+        for ( int row = 0; row < 3; row++ ) {
+            out[ c * 3 + row ] = m[ row ] * r[ c * 3 ] + m[ 3 + row ] * r[ c * 3 + 1 ] + m[ 6 + row ] * r[ c * 3 + 2 ];
+        }
+    }
+    std::copy( out, out + 9, m );
+}
+
+// The cofactors of the upper 3x3 of an affine matrix, column-major, divided by its
+// determinant. This is the inverse transpose, as QMatrix4x4::normalMatrix( ), except that
+// the matrices with a determinant of 0 (returned as well) should get the identity instead.
+template< typename S >
+static inline S normalMatrix( const S m[ 12 ], S n[ 9 ] ) {
+    // Element ( r, c ) is at m[ c * 3 + r ]; the indices of a cofactor wrap around
+    for ( int c = 0; c < 3; c++ ) {
+        const int c1 = ( c + 1 ) % 3, c2 = ( c + 2 ) % 3;
+        for ( int r = 0; r < 3; r++ ) {
+            const int r1 = ( r + 1 ) % 3, r2 = ( r + 2 ) % 3;
+            n[ c * 3 + r ] = m[ c1 * 3 + r1 ] * m[ c2 * 3 + r2 ] - m[ c2 * 3 + r1 ] * m[ c1 * 3 + r2 ];
+        }
+    }
+    const S det = m[ 0 ] * n[ 0 ] + m[ 3 ] * n[ 3 ] + m[ 6 ] * n[ 6 ];
+    const S invDet = divideUnlessZero( S( 1.0f ), det );
+    for ( int k = 0; k < 9; k++ ) {
+        n[ k ] = n[ k ] * invDet;
+    }
+    return det;
+}
+
+// Half of the given angle, converted from degrees to radians. The angle is first reduced
+// to [0, 360), which at most negates the quaternion, and thereby leaves the rotation as is.
+template< typename S >
+static inline S halfRadians( S degrees ) {
+    S reduced = degrees - S( 360.0f ) * floorS( degrees * S( 1.0f / 360.0f ) );
+    return reduced * S( 3.14159265358979f / 360.0f );
+}
+
+// The rotation matrix of Transform3f::setRotation( x, y, z ), in closed form. This follows
+// QQuaternion::fromEulerAngles( ), followed by QMatrix4x4::rotate( QQuaternion ).
+template< typename S >
+static inline void eulerRotation( S xDegrees, S yDegrees, S zDegrees, S r[ 9 ] ) {
+    S s1, c1, s2, c2, s3, c3;
+    sinCosS( halfRadians( yDegrees ), s1, c1 ); // yaw
+    sinCosS( halfRadians( zDegrees ), s2, c2 ); // roll
+    sinCosS( halfRadians( xDegrees ), s3, c3 ); // pitch
+
+    const S c1c2 = c1 * c2;
+    const S s1s2 = s1 * s2;
+    const S w = c1c2 * c3 + s1s2 * s3;
+    const S x = c1c2 * s3 + s1s2 * c3;
+    const S y = s1 * c2 * c3 - c1 * s2 * s3;
+    const S z = c1 * s2 * c3 - s1 * c2 * s3;
+
+    const S f2x = x * S( 2.0f ), f2y = y * S( 2.0f ), f2z = z * S( 2.0f );
+    const S f2xw = f2x * w, f2yw = f2y * w, f2zw = f2z * w;
+    const S f2xx = f2x * x, f2xy = f2x * y, f2xz = f2x * z;
+    const S f2yy = f2y * y, f2yz = f2y * z, f2zz = f2z * z;
+
+    r[ 0 ] = S( 1.0f ) - ( f2yy + f2zz );
+    r[ 1 ] = f2xy + f2zw;
+    r[ 2 ] = f2xz - f2yw;
+    r[ 3 ] = f2xy - f2zw;
+    r[ 4 ] = S( 1.0f ) - ( f2xx + f2zz );
+    r[ 5 ] = f2yz + f2xw;
+    r[ 6 ] = f2xz + f2yw;
+    r[ 7 ] = f2yz - f2xw;
+    r[ 8 ] = S( 1.0f ) - ( f2xx + f2yy );
+}
+
+// Equals ( ( int ) a / 2 ) * 2, as in BounceAnimator::transformAt( )
+static inline float truncateToEven( float a ) {
+    return float( ( (int) a / 2 ) * 2 );
+}
+
+#if defined( __SSE2__ )
+static inline F4 truncateToEven( F4 a ) {
+    // Integer division truncates toward zero, so negative odd values are rounded up
+    __m128i i = _mm_cvttps_epi32( a.v );
+    i = _mm_add_epi32( i, _mm_srli_epi32( i, 31 ) );
+    i = _mm_and_si128( i, _mm_set1_epi32( ~1 ) );
+    return _mm_cvtepi32_ps( i );
+}
+#endif
+
+AnimationGraph::AnimationGraph( ) {
+
+}
+
+int AnimationGraph::add( const std::vector< std::shared_ptr< TransformAnimator > >& animators ) {
+    struct Node {
+        NodeType type;
+        float params[ 3 ];
+        std::shared_ptr< TransformAnimator > animator;
+        QMatrix4x4 suffix;
+        bool hasSuffix;
+    };
+
+    // Constant transforms are folded into the prefix, or the suffix of the preceding node
+    QMatrix4x4 prefix;
+    std::vector< Node > nodes;
+    for ( const std::shared_ptr< TransformAnimator >& pAnimator : animators ) {
+        if ( ConstantAnimator *pConstant = dynamic_cast< ConstantAnimator * >( pAnimator.get( ) ) ) {
+            QMatrix4x4 matrix = pConstant->transformAt( 0 ).matrix( );
+            if ( nodes.empty( ) ) {
+                prefix = prefix * matrix;
+            } else {
+                nodes.back( ).suffix = nodes.back( ).suffix * matrix;
+                nodes.back( ).hasSuffix = true;
+            }
+            continue;
+        }
+
+        Node node = { };
+        if ( RotationAnimator *pRotation = dynamic_cast< RotationAnimator * >( pAnimator.get( ) ) ) {
+            node.type = ROTATION;
+            node.params[ 0 ] = pRotation->rotationVector( ).x( );
+            node.params[ 1 ] = pRotation->rotationVector( ).y( );
+            node.params[ 2 ] = pRotation->rotationVector( ).z( );
+        } else if ( BounceAnimator *pBounce = dynamic_cast< BounceAnimator * >( pAnimator.get( ) ) ) {
+            node.type = BOUNCE;
+            node.params[ 0 ] = pBounce->lowestY( );
+            node.params[ 1 ] = pBounce->highestY( );
+            node.params[ 2 ] = pBounce->bounceSpeed( );
+        } else {
+            node.type = GENERIC;
+            node.animator = pAnimator;
+        }
+        nodes.push_back( node );
+    }
+
+    std::vector< NodeType > signature;
+    for ( const Node& node : nodes ) {
+        signature.push_back( node.type );
+    }
+
+    int groupIndex = 0;
+    while ( groupIndex < int( groups.size( ) ) && groups[ groupIndex ].signature != signature ) {
+        groupIndex++;
+    }
+    if ( groupIndex == int( groups.size( ) ) ) {
+        Group group;
+        group.signature = signature;
+        group.size = 0;
+        group.stages.resize( signature.size( ) );
+        for ( size_t i = 0; i < signature.size( ); i++ ) {
+            group.stages[ i ].type = signature[ i ];
+            group.stages[ i ].hasSuffix = false;
+        }
+        groups.push_back( group );
+    }
+
+    Group& group = groups[ groupIndex ];
+    const int index = group.size++;
+    const size_t paddedSize = ( ( group.size + SIMD_WIDTH - 1 ) / SIMD_WIDTH ) * SIMD_WIDTH;
+
+    float matrix[ 12 ];
+    toAffine( prefix, matrix );
+    for ( int k = 0; k < 12; k++ ) {
+        group.prefix.m[ k ].resize( paddedSize );
+        group.prefix.m[ k ][ index ] = matrix[ k ];
+    }
+
+    for ( size_t i = 0; i < nodes.size( ); i++ ) {
+        Stage& stage = group.stages[ i ];
+        for ( int p = 0; p < 3; p++ ) {
+            stage.params[ p ].resize( paddedSize );
+            stage.params[ p ][ index ] = nodes[ i ].params[ p ];
+        }
+        if ( stage.type == GENERIC ) {
+            stage.animators.resize( group.size );
+            stage.animators[ index ] = nodes[ i ].animator;
+        }
+
+        toAffine( nodes[ i ].suffix, matrix );
+        for ( int k = 0; k < 12; k++ ) {
+            stage.suffix.m[ k ].resize( paddedSize );
+            stage.suffix.m[ k ][ index ] = matrix[ k ];
+        }
+        stage.hasSuffix = stage.hasSuffix || nodes[ i ].hasSuffix;
+    }
+
+    group.entryIndices.push_back( int( entries.size( ) ) );
+    entries.push_back( std::make_pair( groupIndex, index ) );
+    return int( entries.size( ) - 1 );
+}
+
+void AnimationGraph::clear( ) {
+    groups.clear( );
+    entries.clear( );
+}
+
+template< typename S >
+void AnimationGraph::evaluateBlock( const Group& group, int offset, float time, TransformBuffer& out ) {
+    const S t( time );
+
+    S m[ 12 ];
+    for ( int k = 0; k < 12; k++ ) {
+        m[ k ] = load< S >( &group.prefix.m[ k ][ offset ] );
+    }
+
+    for ( const Stage& stage : group.stages ) {
+        switch ( stage.type ) {
+        case ROTATION: {
+            S r[ 9 ];
+            eulerRotation( load< S >( &stage.params[ 0 ][ offset ] ) * t,
+                           load< S >( &stage.params[ 1 ][ offset ] ) * t,
+                           load< S >( &stage.params[ 2 ][ offset ] ) * t, r );
+            mulRotation( m, r );
+            break;
+        }
+        case BOUNCE: {
+            // A translation along the y-axis only affects the last column
+            S frac = load< S >( &stage.params[ 2 ][ offset ] ) * t;
+            frac = frac - truncateToEven( frac ); // Put in range [0,2]
+            frac = mirrorAbove( frac, 1.0f );
+            S y = load< S >( &stage.params[ 1 ][ offset ] ) * frac + load< S >( &stage.params[ 0 ][ offset ] ) * ( S( 1.0f ) - frac );
+            for ( int r = 0; r < 3; r++ ) {
+                m[ 9 + r ] = m[ 9 + r ] + m[ 3 + r ] * y;
+            }
+            break;
+        }
+        case GENERIC: {
+            // Evaluated per chain through the virtual function
+            float lanes[ 12 ][ SIMD_WIDTH ];
+            for ( int k = 0; k < 12; k++ ) {
+                store( lanes[ k ], m[ k ] );
+            }
+            const int width = int( sizeof( S ) / sizeof( float ) );
+            for ( int lane = 0; lane < width && offset + lane < group.size; lane++ ) {
+                float a[ 12 ], b[ 12 ], product[ 12 ];
+                for ( int k = 0; k < 12; k++ ) {
+                    a[ k ] = lanes[ k ][ lane ];
+                }
+                toAffine( stage.animators[ offset + lane ]->transformAt( time ).matrix( ), b );
+                mulAffine( a, b, product );
+                for ( int k = 0; k < 12; k++ ) {
+                    lanes[ k ][ lane ] = product[ k ];
+                }
+            }
+            for ( int k = 0; k < 12; k++ ) {
+                m[ k ] = load< S >( lanes[ k ] );
+            }
+            break;
+        }
+        }
+
+        if ( stage.hasSuffix ) {
+            S suffix[ 12 ], product[ 12 ];
+            for ( int k = 0; k < 12; k++ ) {
+                suffix[ k ] = load< S >( &stage.suffix.m[ k ][ offset ] );
+            }
+            mulAffine( m, suffix, product );
+            std::copy( product, product + 12, m );
+        }
+    }
+
+    S n[ 9 ];
+    const S det = normalMatrix( m, n );
+
+    float lanes[ 12 ][ SIMD_WIDTH ];
+    float normalLanes[ 9 ][ SIMD_WIDTH ];
+    float detLanes[ SIMD_WIDTH ];
+    for ( int k = 0; k < 12; k++ ) {
+        store( lanes[ k ], m[ k ] );
+    }
+    for ( int k = 0; k < 9; k++ ) {
+        store( normalLanes[ k ], n[ k ] );
+    }
+    store( detLanes, det );
+    const int width = int( sizeof( S ) / sizeof( float ) );
+    for ( int lane = 0; lane < width && offset + lane < group.size; lane++ ) {
+        const int entry = group.entryIndices[ offset + lane ];
+        float *data = out.modelMats[ entry ].data( );
+        for ( int c = 0; c < 4; c++ ) {
+            for ( int r = 0; r < 3; r++ ) {
+                data[ c * 4 + r ] = lanes[ c * 3 + r ][ lane ];
+            }
+            data[ c * 4 + 3 ] = ( c == 3 ) ? 1.0f : 0.0f;
+        }
+
+        // A singular matrix has the identity as normal matrix, as in QMatrix4x4
+        QMatrix3x3& normalMat = out.normalMats[ entry ];
+        normalMat.setToIdentity( );
+        if ( detLanes[ lane ] != 0 ) {
+            float *normalData = normalMat.data( );
+            for ( int k = 0; k < 9; k++ ) {
+                normalData[ k ] = normalLanes[ k ][ lane ];
+            }
+        }
+    }
+}
+
+void AnimationGraph::evaluate( float time, TransformBuffer& out ) const {
+    out.modelMats.resize( entries.size( ) );
+    out.normalMats.resize( entries.size( ) );
+
+    for ( const Group& group : groups ) {
+        const int numBlocks = ( group.size + SIMD_WIDTH - 1 ) / SIMD_WIDTH;
+        JobSystem::instance( ).parallelFor( numBlocks, CHUNK_SIZE / SIMD_WIDTH, [&]( int begin, int end ) {
+            for ( int block = begin; block < end; block++ ) {
+#if defined( __SSE2__ )
+                evaluateBlock< F4 >( group, block * SIMD_WIDTH, time, out );
+#else
+                for ( int i = 0; i < SIMD_WIDTH; i++ ) {
+                    evaluateBlock< float >( group, block * SIMD_WIDTH + i, time, out );
+                }
+#endif
+            }
+        } );
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef ANIMATION_GRAPH_H
+#define ANIMATION_GRAPH_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+#include <QMatrix4x4>
+#include <QMatrix3x3>
+#include "animation.h"
+
+/**
+ * @brief The TransformBuffer struct holds the model and normal matrix of every chain
+ *   of an AnimationGraph, at the index returned by AnimationGraph::add( )
+ */
+struct TransformBuffer {
+    std::vector< QMatrix4x4 > modelMats;
+    std::vector< QMatrix3x3 > normalMats;
+};
+
+/**
+ * @brief The AnimationGraph class evaluates the animator chains of many batches at once,
+ *   replacing a virtual transformAt( ) call and matrix product per animator.
+ *
+ * Upon adding, a chain is flattened. Consecutive constant transforms are multiplied into
+ *   a single matrix, such that a chain becomes a constant prefix followed by animated
+ *   transforms, each with a constant suffix. Chains with the same sequence of animated
+ *   transform types are stored together in structure-of-arrays form, and evaluated in a
+ *   single pass that processes 4 chains at once with SSE. Rotation and bounce animators
+ *   are evaluated in closed form; animators of any other type through transformAt( ).
+ *   The chains are split into chunks, which are evaluated as jobs of the JobSystem.
+ *
+ * The model matrix of a chain is the product of the transformAt( ) matrices of its
+ *   animators, in order, apart from rounding. Note that the animators are read when
+ *   added, so later changes to them are not seen. Animators of other types should be
+ *   safe to evaluate from multiple threads at once.
+ */
+class AnimationGraph {
+public:
+    AnimationGraph( );
+
+    /**
+     * @brief add Flattens the given animator chain and adds it to the graph
+     * @param animators The chain, whose transforms are concatenated in order
+     * @return The index of the chain, at which its matrices are stored by evaluate( )
+     */
+    int add( const std::vector< std::shared_ptr< TransformAnimator > >& animators );
+
+    /**
+     * @brief clear Removes all chains
+     */
+    void clear( );
+
+    int size( ) const { return int( entries.size( ) ); }
+
+    /**
+     * @brief evaluate Computes the model and normal matrices of all chains at the given
+     *   time, on all threads of the JobSystem. May be called from within a job. The graph
+     *   may not be modified until it returns.
+     * @param time The time at which the transforms should be evaluated
+     * @param out Receives the matrices; resized to the number of chains
+     */
+    void evaluate( float time, TransformBuffer& out ) const;
+
+private:
+    enum NodeType {
+        ROTATION, // params: rotation vector x, y, z
+        BOUNCE, // params: lowY, highY, speed
+        GENERIC // Evaluated through transformAt( )
+    };
+
+    // Affine matrices in structure-of-arrays form. Element m[ c * 3 + r ][ i ]
+    // holds row r of column c of matrix i; the last row is always ( 0, 0, 0, 1 ).
+    struct AffineArrays {
+        std::vector< float > m[ 12 ];
+    };
+
+    // An animated transform, followed by a constant transform
+    struct Stage {
+        NodeType type;
+        std::vector< float > params[ 3 ];
+        std::vector< std::shared_ptr< TransformAnimator > > animators; // Only for GENERIC
+        bool hasSuffix; // False if all suffixes are identity
+        AffineArrays suffix;
+    };
+
+    // All chains with the same sequence of animated transform types
+    struct Group {
+        std::vector< NodeType > signature;
+        int size; // The number of chains. The arrays are padded to a multiple of 4.
+        AffineArrays prefix;
+        std::vector< Stage > stages;
+        std::vector< int > entryIndices; // The index of every chain in the graph
+    };
+
+    // The number of chains evaluated per job
+    static const int CHUNK_SIZE = 256;
+
+    template< typename S >
+    static void evaluateBlock( const Group& group, int offset, float time, TransformBuffer& out );
+
+    std::vector< Group > groups;
+
+    // For every chain the index of its group, and its index within that group
+    std::vector< std::pair< int, int > > entries;
+};
+
+#endif // ANIMATION_GRAPH_H
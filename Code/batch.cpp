@@ -2,57 +2,103 @@
 
 #include "batch.h"
 
+#include <QByteArray>
 #include <QDebug>
+#include <QHash>
+#include <algorithm>
+#include <cstring>
 
 // Documentation can be found in the batch.h file
 
 template class Batch< Vertex3 >;
 template class Batch< BuzzVertex3 >;
+template class Batch< QVector3D >;
 
-template< typename T >
-Batch< T >::Batch( QOpenGLFunctions_3_3_Core *pGl, QVector< T > vertices, QVector< Triangle > triangles )
-        : pGl( pGl ), numTriangles( triangles.length( ) ) {
+// Copies the indices of the triangles into a buffer of the given index type
+template< typename I >
+static QVector< I > packIndices( const QVector< Triangle >& triangles ) {
+    QVector< I > indices( 3 * triangles.length( ) );
+    for ( int i = 0; i < triangles.length( ); i++ ) {
+        indices[ i * 3 + 0 ] = I( triangles[ i ].v1 );
+        indices[ i * 3 + 1 ] = I( triangles[ i ].v2 );
+        indices[ i * 3 + 2 ] = I( triangles[ i ].v3 );
+    }
+    return indices;
+}
 
-    GLuint vbos[2];
-    pGl->glGenBuffers( 2, vbos );
-    verticesVbo = vbos[0];
-    indicesVbo = vbos[1];
-    pGl->glGenBuffers( 1, &verticesVbo );
-    pGl->glGenVertexArrays( 1, &vao );
+// Packs the triangles into the narrowest index type that can hold the largest index, such
+// that small meshes take less bandwidth. Returns that index type.
+static GLenum packTriangles( const QVector< Triangle >& triangles, QByteArray& indexData ) {
+    uint32_t maxIndex = 0;
+    for ( const Triangle& t : triangles ) {
+        maxIndex = std::max( maxIndex, std::max( t.v1, std::max( t.v2, t.v3 ) ) );
+    }
 
-    pGl->glBindVertexArray( vao );
+    if ( maxIndex <= UINT8_MAX ) {
+        QVector< uint8_t > indices = packIndices< uint8_t >( triangles );
+        indexData = QByteArray( reinterpret_cast< const char * >( indices.constData( ) ), int( sizeof( uint8_t ) * indices.length( ) ) );
+        return GL_UNSIGNED_BYTE;
+    } else if ( maxIndex <= UINT16_MAX ) {
+        QVector< uint16_t > indices = packIndices< uint16_t >( triangles );
+        indexData = QByteArray( reinterpret_cast< const char * >( indices.constData( ) ), int( sizeof( uint16_t ) * indices.length( ) ) );
+        return GL_UNSIGNED_SHORT;
+    } else {
+        static_assert( sizeof( Triangle ) == 3 * sizeof( uint32_t ), "Triangle must be tightly packed" );
+        indexData = QByteArray( reinterpret_cast< const char * >( triangles.constData( ) ), int( sizeof( Triangle ) * triangles.length( ) ) );
+        return GL_UNSIGNED_INT;
+    }
+}
 
-    // Upload data to GPU
-    pGl->glBindBuffer( GL_ARRAY_BUFFER, verticesVbo );
-    pGl->glBufferData( GL_ARRAY_BUFFER, sizeof( T ) * vertices.length( ), vertices.constData( ), GL_STATIC_READ );
-    pGl->glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indicesVbo );
-    pGl->glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof( Triangle ) * triangles.length( ), triangles.constData( ), GL_STATIC_READ );
+template< typename T >
+Batch< T >::Batch( MeshArena& arena, QVector< T > vertices, QVector< Triangle > triangles )
+        : pGl( arena.functions( ) ), arena( arena ), numTriangles( triangles.length( ) ) {
+    Q_ASSERT( size_t( arena.vertexSize( ) ) == sizeof( T ) );
 
-    // Note that the memory layout has not yet been setup. This should be done in sub-classes
+    QByteArray indexData;
+    indexType = packTriangles( triangles, indexData );
+    mesh = arena.allocate( vertices.constData( ), vertices.length( ), indexData.constData( ), indexData.size( ) );
 }
 
 template< typename T >
 Batch< T >::~Batch( ) {
     qDebug( ) << "Batch destructed";
-    GLuint vbos[2];
-    vbos[ 0 ] = verticesVbo;
-    vbos[ 1 ] = indicesVbo;
-    pGl->glDeleteBuffers( 2, vbos );
-    pGl->glDeleteVertexArrays( 1, &vao );
+    arena.free( mesh );
 }
 
 template< typename T >
 void Batch< T >::draw( ) {
-    pGl->glBindVertexArray( vao );
-    pGl->glDrawElements( GL_TRIANGLES, 3 * numTriangles, GL_UNSIGNED_SHORT, (void *) 0 );
+    arena.bind( );
+    drawBound( );
 }
 
-DefaultBatch::DefaultBatch( QOpenGLFunctions_3_3_Core *pGl, QVector< Vertex3 > vertices, QVector< Triangle > triangles  )
-        : Batch< Vertex3 >( pGl, vertices, triangles ) {
-    setupMemoryLayout( );
+template< typename T >
+void Batch< T >::drawBound( ) {
+    const MeshArena::Mesh& range = arena.mesh( mesh );
+    pGl->glDrawElementsBaseVertex( GL_TRIANGLES, 3 * numTriangles, indexType, (void *) range.indexOffset, range.baseVertex );
 }
 
-void DefaultBatch::setupMemoryLayout( ) {
+template< typename T >
+void Batch< T >::bind( ) {
+    arena.bind( );
+}
+
+template< typename T >
+void Batch< T >::drawInstanced( int numInstances ) {
+    const MeshArena::Mesh& range = arena.mesh( mesh );
+    pGl->glDrawElementsInstancedBaseVertex( GL_TRIANGLES, 3 * numTriangles, indexType, (void *) range.indexOffset,
+                                            numInstances, range.baseVertex );
+}
+
+DefaultBatch::DefaultBatch( MeshArena& arena, QVector< Vertex3 > vertices, QVector< Triangle > triangles  )
+        : Batch< Vertex3 >( arena, vertices, triangles ) {
+
+}
+
+std::unique_ptr< MeshArena > DefaultBatch::createArena( QOpenGLFunctions_3_3_Core *pGl ) {
+    return std::make_unique< MeshArena >( pGl, sizeof( Vertex3 ), &DefaultBatch::setupMemoryLayout );
+}
+
+void DefaultBatch::setupMemoryLayout( QOpenGLFunctions_3_3_Core *pGl ) {
     qDebug( ) << "DefaultBatch::setupMemoryLayout()";
 
     // Describe memory layout to OpenGL
@@ -69,12 +115,16 @@ void DefaultBatch::setupMemoryLayout( ) {
     pGl->glVertexAttribPointer( II_BITANGENT, 3, GL_FLOAT, GL_FALSE, sizeof( Vertex3 ), (void *) ( 3 * sizeof( QVector3D ) + sizeof( QVector2D ) ) );
 }
 
-BuzzBatch::BuzzBatch( QOpenGLFunctions_3_3_Core *pGl, QVector< BuzzVertex3 > vertices, QVector< Triangle > triangles  )
-        : Batch< BuzzVertex3 >( pGl, vertices, triangles ) {
-    setupMemoryLayout( );
+BuzzBatch::BuzzBatch( MeshArena& arena, QVector< BuzzVertex3 > vertices, QVector< Triangle > triangles  )
+        : Batch< BuzzVertex3 >( arena, vertices, triangles ) {
+
 }
 
-void BuzzBatch::setupMemoryLayout( ) {
+std::unique_ptr< MeshArena > BuzzBatch::createArena( QOpenGLFunctions_3_3_Core *pGl ) {
+    return std::make_unique< MeshArena >( pGl, sizeof( BuzzVertex3 ), &BuzzBatch::setupMemoryLayout );
+}
+
+void BuzzBatch::setupMemoryLayout( QOpenGLFunctions_3_3_Core *pGl ) {
     // Describe memory layout to OpenGL
     pGl->glEnableVertexAttribArray( II_POSITION );
     pGl->glEnableVertexAttribArray( II_POSITION2 );
@@ -85,6 +135,22 @@ void BuzzBatch::setupMemoryLayout( ) {
     pGl->glVertexAttribPointer( II_POSITION3, 3, GL_FLOAT, GL_FALSE, sizeof( BuzzVertex3 ), (void *) ( 2 * sizeof( QVector3D ) ) );
 }
 
+IndexedBuzzBatch::IndexedBuzzBatch( MeshArena& arena, QVector< QVector3D > vertices, QVector< Triangle > triangles  )
+        : Batch< QVector3D >( arena, vertices, triangles ) {
+
+}
+
+std::unique_ptr< MeshArena > IndexedBuzzBatch::createArena( QOpenGLFunctions_3_3_Core *pGl ) {
+    return std::make_unique< MeshArena >( pGl, sizeof( QVector3D ), &IndexedBuzzBatch::setupMemoryLayout );
+}
+
+void IndexedBuzzBatch::setupMemoryLayout( QOpenGLFunctions_3_3_Core *pGl ) {
+    // Describe memory layout to OpenGL
+    pGl->glEnableVertexAttribArray( II_POSITION );
+
+    pGl->glVertexAttribPointer( II_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof( QVector3D ), (void *) 0 );
+}
+
 // Writes the tangent and bitangent vectors to the vertices
 // These are computed from the positions and UVs.
 // Used for computing the per-fragment normals.
@@ -124,7 +190,7 @@ void computeTangents( QVector< Vertex3 >& vertices, const QVector<unsigned>& ind
     }
 }
 
-std::unique_ptr< DefaultBatch > defaultBatchFromModel( QOpenGLFunctions_3_3_Core *pGl, Model model ) {
+std::unique_ptr< DefaultBatch > defaultBatchFromModel( MeshArena& arena, Model model ) {
     QVector< QVector3D > positions = model.getVertices_indexed( );
     QVector< QVector3D > normals = model.getNormals_indexed( );
     QVector< QVector2D > texCoords = model.getTextureCoords_indexed( );
@@ -145,10 +211,10 @@ std::unique_ptr< DefaultBatch > defaultBatchFromModel( QOpenGLFunctions_3_3_Core
                                  , indices[ i * 3 + 2 ] );
     }
 
-    return std::make_unique< DefaultBatch >( pGl, vertices, triangles );
+    return std::make_unique< DefaultBatch >( arena, vertices, triangles );
 }
 
-std::unique_ptr< BuzzBatch > buzzBatchFromModel( QOpenGLFunctions_3_3_Core *pGl, Model model ) {
+std::unique_ptr< BuzzBatch > buzzBatchFromModel( MeshArena& arena, Model model ) {
     QVector< QVector3D > positions = model.getVertices( );
 
     QVector< QVector3D > normals = model.getNormals( );
@@ -165,5 +231,77 @@ std::unique_ptr< BuzzBatch > buzzBatchFromModel( QOpenGLFunctions_3_3_Core *pGl,
         triangles[ i ] = Triangle( i * 3 + 0, i * 3 + 1, i * 3 + 2 );
     }
 
-    return std::make_unique< BuzzBatch >( pGl, vertices, triangles );
+    return std::make_unique< BuzzBatch >( arena, vertices, triangles );
+}
+
+// Key for welding positions on their exact bit pattern
+struct PositionKey {
+    quint32 bits[3];
+
+    PositionKey( const QVector3D& v ) {
+        // Adding 0 folds -0 into +0, as these compare equal as floats
+        float xyz[3] = { v.x( ) + 0.0f, v.y( ) + 0.0f, v.z( ) + 0.0f };
+        std::memcpy( bits, xyz, sizeof( bits ) );
+    }
+
+    bool operator==( const PositionKey& other ) const {
+        return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+    }
+};
+
+inline uint qHash( const PositionKey& key, uint seed = 0 ) {
+    return qHashBits( key.bits, sizeof( key.bits ), seed );
+}
+
+std::unique_ptr< IndexedBuzzBatch > indexedBuzzBatchFromModel( MeshArena& arena, Model model ) {
+    return indexedBuzzBatchFromMesh( arena, buzzMeshFromModel( model ) );
+}
+
+BuzzMesh buzzMeshFromModel( Model model ) {
+    QVector< QVector3D > positions = model.getVertices_indexed( );
+    QVector< unsigned > indices = model.getIndices( );
+
+    // The model is welded on its normals as well, which may leave several vertices
+    // at the same position
+    BuzzMesh mesh;
+    QVector< unsigned > remap( positions.size( ) );
+    QHash< PositionKey, unsigned > welded;
+    for ( int i = 0; i < positions.size( ); i++ ) {
+        QHash< PositionKey, unsigned >::const_iterator it = welded.constFind( PositionKey( positions[ i ] ) );
+        if ( it != welded.constEnd( ) ) {
+            remap[ i ] = it.value( );
+        } else {
+            remap[ i ] = mesh.vertices.size( );
+            welded.insert( PositionKey( positions[ i ] ), mesh.vertices.size( ) );
+            mesh.vertices.append( positions[ i ] );
+        }
+    }
+
+    mesh.triangles.resize( indices.size( ) / 3 );
+    for ( int i = 0; i < mesh.triangles.size( ); i++ ) {
+        mesh.triangles[ i ] = Triangle( remap[ indices[ i * 3 + 0 ] ]
+                                      , remap[ indices[ i * 3 + 1 ] ]
+                                      , remap[ indices[ i * 3 + 2 ] ] );
+    }
+    return mesh;
+}
+
+std::unique_ptr< BuzzBatch > buzzBatchFromMesh( MeshArena& arena, const BuzzMesh& mesh ) {
+    // Every corner of a triangle gets its own vertex, which includes the other two corners
+    QVector< BuzzVertex3 > vertices( mesh.triangles.size( ) * 3 );
+    QVector< Triangle > triangles( mesh.triangles.size( ) );
+    for ( int i = 0; i < mesh.triangles.size( ); i++ ) {
+        const QVector3D& p1 = mesh.vertices[ mesh.triangles[ i ].v1 ];
+        const QVector3D& p2 = mesh.vertices[ mesh.triangles[ i ].v2 ];
+        const QVector3D& p3 = mesh.vertices[ mesh.triangles[ i ].v3 ];
+        vertices[ i * 3 + 0 ] = BuzzVertex3( p1, p2, p3 );
+        vertices[ i * 3 + 1 ] = BuzzVertex3( p2, p3, p1 );
+        vertices[ i * 3 + 2 ] = BuzzVertex3( p3, p1, p2 );
+        triangles[ i ] = Triangle( i * 3 + 0, i * 3 + 1, i * 3 + 2 );
+    }
+    return std::make_unique< BuzzBatch >( arena, vertices, triangles );
+}
+
+std::unique_ptr< IndexedBuzzBatch > indexedBuzzBatchFromMesh( MeshArena& arena, const BuzzMesh& mesh ) {
+    return std::make_unique< IndexedBuzzBatch >( arena, mesh.vertices, mesh.triangles );
 }
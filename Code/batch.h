@@ -9,6 +9,7 @@
 #include <QVector2D>
 #include <QOpenGLFunctions_3_3_Core>
 #include <memory>
+#include "mesh_arena.h"
 #include "model.h"
 
 typedef QVector3D Color3D;
@@ -54,48 +55,95 @@ struct BuzzVertex3 {
 /**
  * @brief The Triangle struct is a triangle, where each component
  *   represents the index of the vertex in the vertex array.
+ *
+ * Note that on the GPU the indices are stored with the narrowest type
+ *   that can address all vertices of the batch.
  */
 struct Triangle {
-    uint16_t v1;
-    uint16_t v2;
-    uint16_t v3;
+    uint32_t v1;
+    uint32_t v2;
+    uint32_t v3;
 
     Triangle( )
         : v1( 0 ), v2( 0 ), v3( 0 ) { }
 
-    Triangle( uint16_t v1, uint16_t v2, uint16_t v3 )
+    Triangle( uint32_t v1, uint32_t v2, uint32_t v3 )
         : v1( v1 ), v2( v2 ), v3( v3 ) { }
 };
 
 class GeneralBatch {
 public:
+    /**
+     * @brief draw Binds the batch and draws it
+     */
     virtual void draw( ) = 0;
+
+    /**
+     * @brief drawBound Draws the batch, which must be bound. This allows a sequence of
+     *   draws of the same batch to bind it only once.
+     */
+    virtual void drawBound( ) = 0;
+
+    /**
+     * @brief bind Binds the VAO of the batch, such that additional (per-instance)
+     *   attributes can be attached to it. The VAO may be shared with other batches.
+     */
+    virtual void bind( ) = 0;
+
+    /**
+     * @brief vertexArray The VAO bound by bind( )
+     */
+    virtual GLuint vertexArray( ) const = 0;
+
+    /**
+     * @brief drawInstanced Draws the batch the given number of times with a single
+     *   draw call. The batch must be bound.
+     * @param numInstances The number of instances to draw
+     */
+    virtual void drawInstanced( int numInstances ) = 0;
+
+    /**
+     * @brief triangleCount The number of triangles drawn by draw( )
+     */
+    virtual int triangleCount( ) const = 0;
 };
 
 /**
- * @brief The Batch class is a OpenGL model that is uploaded to the GPU. It contains the VBO
- *   and VAO. Upon destruction any allocated resources are destroyed (also on the GPU).
- *   It uses the Vertex3 structure as defined above and would therefore only work properly
- *   with shaders having the same attribute layout.
+ * @brief The Batch class is a OpenGL model that is uploaded to the GPU. Its vertices and
+ *   indices are stored in a MeshArena, together with the other batches of the same vertex
+ *   format, such that all of these share a single VAO. Upon destruction its range of the
+ *   arena is freed.
+ *
+ * The index buffer uses 8-, 16- or 32-bit indices, whichever is the narrowest type that
+ *   can address all vertices.
  *
  * Note that this class can only be called after OpenGL is initialised
  */
 template< typename T >
 class Batch : public GeneralBatch {
 public:
-    Batch( QOpenGLFunctions_3_3_Core *pGl, QVector< T > vertices, QVector< Triangle > triangles );
+    /**
+     * @brief Batch Uploads the mesh
+     * @param arena The arena of the vertex format of the sub-class, which has to outlive
+     *   the batch
+     */
+    Batch( MeshArena& arena, QVector< T > vertices, QVector< Triangle > triangles );
     virtual ~Batch( );
     void draw( );
+    void drawBound( );
+    void bind( );
+    GLuint vertexArray( ) const { return arena.vertexArray( ); }
+    void drawInstanced( int numInstances );
+    int triangleCount( ) const { return numTriangles; }
 protected:
-    virtual void setupMemoryLayout( ) = 0;
-
     QOpenGLFunctions_3_3_Core *pGl;
 
-    GLuint vao;
-    GLuint verticesVbo;
-    GLuint indicesVbo;
+    MeshArena& arena;
+    MeshArena::Handle mesh;
 
     int numTriangles;
+    // GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLenum indexType;
 };
 
 /**
@@ -106,12 +154,17 @@ protected:
  */
 class DefaultBatch : public Batch< Vertex3 > {
 public:
-    DefaultBatch( QOpenGLFunctions_3_3_Core *pGl, QVector< Vertex3 > vertices, QVector< Triangle > triangles );
+    DefaultBatch( MeshArena& arena, QVector< Vertex3 > vertices, QVector< Triangle > triangles );
 
     ~DefaultBatch( ) { }
-protected:
-    void setupMemoryLayout( );
+
+    /**
+     * @brief createArena Creates an arena for batches of this class
+     */
+    static std::unique_ptr< MeshArena > createArena( QOpenGLFunctions_3_3_Core *pGl );
 private:
+    static void setupMemoryLayout( QOpenGLFunctions_3_3_Core *pGl );
+
     const static unsigned int II_POSITION = 0;
     const static unsigned int II_NORMAL = 1;
     const static unsigned int II_TEXCOORD = 2;
@@ -130,34 +183,99 @@ private:
  */
 class BuzzBatch : public Batch< BuzzVertex3 > {
 public:
-    BuzzBatch( QOpenGLFunctions_3_3_Core *pGl, QVector< BuzzVertex3 > vertices, QVector< Triangle > triangles );
+    BuzzBatch( MeshArena& arena, QVector< BuzzVertex3 > vertices, QVector< Triangle > triangles );
     ~BuzzBatch( ) { }
-protected:
-    void setupMemoryLayout( );
+
+    /**
+     * @brief createArena Creates an arena for batches of this class
+     */
+    static std::unique_ptr< MeshArena > createArena( QOpenGLFunctions_3_3_Core *pGl );
 private:
+    static void setupMemoryLayout( QOpenGLFunctions_3_3_Core *pGl );
+
     const static unsigned int II_POSITION = 0;
     const static unsigned int II_POSITION2 = 1;
     const static unsigned int II_POSITION3 = 2;
 };
 
+/**
+ * @brief The IndexedBuzzBatch class is the indexed alternative of the BuzzBatch. It is tailored
+ *   to be used with the indexed buzz shaders.
+ *
+ * Every position of the mesh is stored only once, and shared by all triangles it is part of.
+ *   The face normal is obtained in the geometry shader instead, which has all (deformed) positions
+ *   of the triangle available. This takes far less memory than the BuzzBatch, and lets the
+ *   post-transform vertex cache avoid repeated vertex shader invocations.
+ */
+class IndexedBuzzBatch : public Batch< QVector3D > {
+public:
+    IndexedBuzzBatch( MeshArena& arena, QVector< QVector3D > vertices, QVector< Triangle > triangles );
+    ~IndexedBuzzBatch( ) { }
+
+    /**
+     * @brief createArena Creates an arena for batches of this class
+     */
+    static std::unique_ptr< MeshArena > createArena( QOpenGLFunctions_3_3_Core *pGl );
+private:
+    static void setupMemoryLayout( QOpenGLFunctions_3_3_Core *pGl );
+
+    const static unsigned int II_POSITION = 0;
+};
+
+/**
+ * @brief The BuzzMesh struct is an indexed triangle mesh of positions only, which is
+ *   all the buzz batches need
+ */
+struct BuzzMesh {
+    QVector< QVector3D > vertices;
+    QVector< Triangle > triangles;
+};
+
 /**
  * @brief batchFromModel Uploads the model loaded from an Obj file to the GPU.
  *   a smart pointer to the representing Batch class is returned.
  *
- * @param pGl A pointer to the OpenGL 3.3 core functions
+ * @param arena The arena to upload to, as created by the createArena( ) of the batch class
  * @param model The model that should be uploaded
  * @return A smart pointer to the representing Batch class
  */
-std::unique_ptr< DefaultBatch > defaultBatchFromModel( QOpenGLFunctions_3_3_Core *pGl, Model model );
+std::unique_ptr< DefaultBatch > defaultBatchFromModel( MeshArena& arena, Model model );
 
 /**
  * @brief buzzBatchFromModel Uploads the model loaded from the Obj file as a buzz batch to the GPU.
  *   a smart pointer to the representing BuzzBatch class is returned.
  *
- * @param pGl A pointer to the OpenGL 3.3 core functions
+ * @param arena The arena to upload to, as created by the createArena( ) of the batch class
  * @param model The model that should be uploaded
  * @return A smart pointer to the representing BuzzBatch class
  */
-std::unique_ptr< BuzzBatch > buzzBatchFromModel( QOpenGLFunctions_3_3_Core *pGl, Model model );
+std::unique_ptr< BuzzBatch > buzzBatchFromModel( MeshArena& arena, Model model );
+
+/**
+ * @brief indexedBuzzBatchFromModel Uploads the model loaded from the Obj file as an indexed buzz
+ *   batch to the GPU. Vertices are welded on their position only, as the normals and texture
+ *   coordinates are not used by the buzz shaders.
+ *
+ * @param arena The arena to upload to, as created by the createArena( ) of the batch class
+ * @param model The model that should be uploaded
+ * @return A smart pointer to the representing IndexedBuzzBatch class
+ */
+std::unique_ptr< IndexedBuzzBatch > indexedBuzzBatchFromModel( MeshArena& arena, Model model );
+
+/**
+ * @brief buzzMeshFromModel Returns the triangles of the model, with its vertices welded
+ *   on their position only
+ */
+BuzzMesh buzzMeshFromModel( Model model );
+
+/**
+ * @brief buzzBatchFromMesh Uploads the mesh as a buzz batch to the GPU
+ */
+std::unique_ptr< BuzzBatch > buzzBatchFromMesh( MeshArena& arena, const BuzzMesh& mesh );
+
+/**
+ * @brief indexedBuzzBatchFromMesh Uploads the mesh as an indexed buzz batch to the GPU
+ */
+std::unique_ptr< IndexedBuzzBatch > indexedBuzzBatchFromMesh( MeshArena& arena, const BuzzMesh& mesh );
 
 #endif // BATCH_H
@@ -0,0 +1,264 @@
+#include "buzz_reference.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Documentation can be found in the buzz_reference.h file
+
+// The shader is implemented once as a template over the scalar type. It is instantiated
+// for a float, and for a vector of 4 floats (with SSE). As both instantiations perform the
+// exact same IEEE operations in the same order, their results are identical. This includes
+// powS( ), of which the scalar version computes a lane of the vector one (see simd.h).
+
+namespace {
+
+// The uniforms, with all values that do not depend on the vertex computed upfront
+struct PreparedUniforms {
+    float modelMat[ 16 ]; // column-major
+    float normalMat[ 9 ]; // column-major
+    float projViewMat[ 16 ]; // column-major, u_projectionMat * u_viewMat
+    float lightPositions[ BuzzShaderUniforms::NUM_LIGHTS ][ 3 ];
+    float diffuseColors[ BuzzShaderUniforms::NUM_LIGHTS ][ 3 ]; // u_lights[i].color * u_kd
+    float specularColors[ BuzzShaderUniforms::NUM_LIGHTS ][ 3 ]; // u_lights[i].color * u_ks
+    float ambientColor[ 3 ]; // The ambient color summed over all lights
+    float color[ 3 ];
+    float spike;
+    float p;
+
+    PreparedUniforms( const BuzzShaderUniforms& u ) {
+        QMatrix4x4 projView = u.projectionMat * u.viewMat;
+        std::copy( u.modelMat.constData( ), u.modelMat.constData( ) + 16, modelMat );
+        std::copy( u.normalMat.constData( ), u.normalMat.constData( ) + 9, normalMat );
+        std::copy( projView.constData( ), projView.constData( ) + 16, projViewMat );
+
+        for ( int c = 0; c < 3; c++ ) {
+            ambientColor[ c ] = 0;
+            color[ c ] = u.color[ c ];
+        }
+        for ( int i = 0; i < BuzzShaderUniforms::NUM_LIGHTS; i++ ) {
+            for ( int c = 0; c < 3; c++ ) {
+                lightPositions[ i ][ c ] = u.lightPositions[ i ][ c ];
+                ambientColor[ c ] += ( u.lightColors[ i ][ c ] * u.ka ) / 3;
+                diffuseColors[ i ][ c ] = u.lightColors[ i ][ c ] * u.kd;
+                specularColors[ i ][ c ] = u.lightColors[ i ][ c ] * u.ks;
+            }
+        }
+        spike = u.spike;
+        p = u.p;
+    }
+};
+
+// -- GLSL vector operations
+
+template< typename S >
+struct V3 {
+    S x, y, z;
+};
+
+template< typename S >
+inline V3< S > operator+( V3< S > a, V3< S > b ) {
+    return { a.x + b.x, a.y + b.y, a.z + b.z };
+}
+
+template< typename S >
+inline V3< S > operator-( V3< S > a, V3< S > b ) {
+    return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+template< typename S >
+inline V3< S > operator-( V3< S > a ) {
+    return { -a.x, -a.y, -a.z };
+}
+
+template< typename S >
+inline V3< S > operator*( V3< S > a, S s ) {
+    return { a.x * s, a.y * s, a.z * s };
+}
+
+template< typename S >
+inline S dot( V3< S > a, V3< S > b ) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+template< typename S >
+inline V3< S > cross( V3< S > a, V3< S > b ) {
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+template< typename S >
+inline S length( V3< S > a ) {
+    return sqrtS( dot( a, a ) );
+}
+
+template< typename S >
+inline V3< S > normalize( V3< S > a ) {
+    S l = length( a );
+    return { a.x / l, a.y / l, a.z / l };
+}
+
+// Multiplies with a column-major 3x3 matrix
+template< typename S >
+inline V3< S > mul3( const float *m, V3< S > v ) {
+    return { S( m[0] ) * v.x + S( m[3] ) * v.y + S( m[6] ) * v.z,
+             S( m[1] ) * v.x + S( m[4] ) * v.y + S( m[7] ) * v.z,
+             S( m[2] ) * v.x + S( m[5] ) * v.y + S( m[8] ) * v.z };
+}
+
+// Multiplies with a column-major 4x4 matrix, the vector having a w of 1
+template< typename S >
+inline void mul4( const float *m, V3< S > v, S out[ 4 ] ) {
+    for ( int r = 0; r < 4; r++ ) {
+        out[ r ] = S( m[ r ] ) * v.x + S( m[ 4 + r ] ) * v.y + S( m[ 8 + r ] ) * v.z + S( m[ 12 + r ] ) * S( 1.0f );
+    }
+}
+
+// -- The shader
+
+template< typename S >
+inline V3< S > getNormal( V3< S > a, V3< S > b, V3< S > c ) {
+    return normalize( cross( b - a, c - a ) );
+}
+
+template< typename S >
+inline V3< S > spikePosition( V3< S > position, float spike ) {
+    S xtraLen = maxS( S( 0.0f ), length( position ) - S( 1.0f ) );
+    return normalize( position ) * powS( S( 1.0f ) + xtraLen, spike );
+}
+
+template< typename S >
+void buzzShader( const PreparedUniforms& u, const V3< S > in[ 3 ], S outPosition[ 4 ], S outColor[ 3 ] ) {
+    V3< S > modP1 = spikePosition( in[ 0 ], u.spike );
+    V3< S > modP2 = spikePosition( in[ 1 ], u.spike );
+    V3< S > modP3 = spikePosition( in[ 2 ], u.spike );
+
+    S homogeneous[ 4 ];
+    mul4( u.modelMat, modP1, homogeneous );
+    V3< S > vertexPosition = { divideUnlessZero( homogeneous[ 0 ], homogeneous[ 3 ] ),
+                               divideUnlessZero( homogeneous[ 1 ], homogeneous[ 3 ] ),
+                               divideUnlessZero( homogeneous[ 2 ], homogeneous[ 3 ] ) };
+    V3< S > N = normalize( mul3( u.normalMat, getNormal( modP1, modP2, modP3 ) ) );
+
+    V3< S > V = normalize( -vertexPosition ); // Points toward the camera
+    V3< S > diffuseLightColor = { S( 0.0f ), S( 0.0f ), S( 0.0f ) };
+    V3< S > specularLightColor = { S( 0.0f ), S( 0.0f ), S( 0.0f ) };
+    for ( int i = 0; i < BuzzShaderUniforms::NUM_LIGHTS; i++ ) {
+        V3< S > lightPosition = { S( u.lightPositions[ i ][ 0 ] ), S( u.lightPositions[ i ][ 1 ] ), S( u.lightPositions[ i ][ 2 ] ) };
+        V3< S > diffuseColor = { S( u.diffuseColors[ i ][ 0 ] ), S( u.diffuseColors[ i ][ 1 ] ), S( u.diffuseColors[ i ][ 2 ] ) };
+        V3< S > specularColor = { S( u.specularColors[ i ][ 0 ] ), S( u.specularColors[ i ][ 1 ] ), S( u.specularColors[ i ][ 2 ] ) };
+
+        // Normalized vector pointing to the light
+        V3< S > L = normalize( lightPosition - vertexPosition );
+        V3< S > R = N * ( S( 2.0f ) * dot( N, L ) ) - L; // Mirror of L along surface normal
+        diffuseLightColor = diffuseLightColor + diffuseColor * maxS( S( 0.0f ), dot( N, L ) );
+        specularLightColor = specularLightColor + specularColor * powS( maxS( S( 0.0f ), dot( R, V ) ), u.p );
+    }
+
+    outColor[ 0 ] = ( S( u.ambientColor[ 0 ] ) + diffuseLightColor.x ) * S( u.color[ 0 ] ) + specularLightColor.x;
+    outColor[ 1 ] = ( S( u.ambientColor[ 1 ] ) + diffuseLightColor.y ) * S( u.color[ 1 ] ) + specularLightColor.y;
+    outColor[ 2 ] = ( S( u.ambientColor[ 2 ] ) + diffuseLightColor.z ) * S( u.color[ 2 ] ) + specularLightColor.z;
+    mul4( u.projViewMat, vertexPosition, outPosition );
+}
+
+}
+
+BuzzVerticesSoA::BuzzVerticesSoA( const QVector< BuzzVertex3 >& vertices ) {
+    for ( int k = 0; k < 3; k++ ) {
+        for ( int c = 0; c < 3; c++ ) {
+            positions[ k ][ c ].resize( vertices.size( ) );
+        }
+    }
+    for ( int i = 0; i < vertices.size( ); i++ ) {
+        const QVector3D *triangle[ 3 ] = { &vertices[ i ].position, &vertices[ i ].position2, &vertices[ i ].position3 };
+        for ( int k = 0; k < 3; k++ ) {
+            for ( int c = 0; c < 3; c++ ) {
+                positions[ k ][ c ][ i ] = ( *triangle[ k ] )[ c ];
+            }
+        }
+    }
+}
+
+int BuzzVerticesSoA::size( ) const {
+    return int( positions[ 0 ][ 0 ].size( ) );
+}
+
+void BuzzShaderOutputsSoA::resize( int size ) {
+    for ( int c = 0; c < 4; c++ ) {
+        position[ c ].resize( size );
+    }
+    for ( int c = 0; c < 3; c++ ) {
+        color[ c ].resize( size );
+    }
+}
+
+BuzzShaderOutput buzzVertexShader( const BuzzShaderUniforms& uniforms, const BuzzVertex3& vertex ) {
+    PreparedUniforms u( uniforms );
+    V3< float > in[ 3 ] = {
+        { vertex.position.x( ), vertex.position.y( ), vertex.position.z( ) },
+        { vertex.position2.x( ), vertex.position2.y( ), vertex.position2.z( ) },
+        { vertex.position3.x( ), vertex.position3.y( ), vertex.position3.z( ) }
+    };
+    float position[ 4 ], color[ 3 ];
+    buzzShader( u, in, position, color );
+
+    BuzzShaderOutput output;
+    output.position = QVector4D( position[ 0 ], position[ 1 ], position[ 2 ], position[ 3 ] );
+    output.color = Color3D( color[ 0 ], color[ 1 ], color[ 2 ] );
+    return output;
+}
+
+void buzzDeform( const BuzzVertex3& vertex, float spike, QVector3D& position, QVector3D& normal ) {
+    V3< float > modP1 = spikePosition( V3< float > { vertex.position.x( ), vertex.position.y( ), vertex.position.z( ) }, spike );
+    V3< float > modP2 = spikePosition( V3< float > { vertex.position2.x( ), vertex.position2.y( ), vertex.position2.z( ) }, spike );
+    V3< float > modP3 = spikePosition( V3< float > { vertex.position3.x( ), vertex.position3.y( ), vertex.position3.z( ) }, spike );
+    V3< float > N = getNormal( modP1, modP2, modP3 );
+
+    position = QVector3D( modP1.x, modP1.y, modP1.z );
+    normal = QVector3D( N.x, N.y, N.z );
+}
+
+void buzzVertexShaderBatch( const BuzzShaderUniforms& uniforms, const BuzzVerticesSoA& vertices, BuzzShaderOutputsSoA& outputs ) {
+    PreparedUniforms u( uniforms );
+    const int numVertices = vertices.size( );
+    outputs.resize( numVertices );
+
+    int i = 0;
+#if defined( __SSE2__ )
+    for ( ; i + 4 <= numVertices; i += 4 ) {
+        V3< F4 > in[ 3 ];
+        for ( int k = 0; k < 3; k++ ) {
+            in[ k ].x = _mm_loadu_ps( &vertices.positions[ k ][ 0 ][ i ] );
+            in[ k ].y = _mm_loadu_ps( &vertices.positions[ k ][ 1 ][ i ] );
+            in[ k ].z = _mm_loadu_ps( &vertices.positions[ k ][ 2 ][ i ] );
+        }
+
+        F4 position[ 4 ], color[ 3 ];
+        buzzShader( u, in, position, color );
+
+        for ( int c = 0; c < 4; c++ ) {
+            _mm_storeu_ps( &outputs.position[ c ][ i ], position[ c ].v );
+        }
+        for ( int c = 0; c < 3; c++ ) {
+            _mm_storeu_ps( &outputs.color[ c ][ i ], color[ c ].v );
+        }
+    }
+#endif
+
+    // Remaining vertices (or all without SSE)
+    for ( ; i < numVertices; i++ ) {
+        V3< float > in[ 3 ];
+        for ( int k = 0; k < 3; k++ ) {
+            in[ k ] = { vertices.positions[ k ][ 0 ][ i ], vertices.positions[ k ][ 1 ][ i ], vertices.positions[ k ][ 2 ][ i ] };
+        }
+
+        float position[ 4 ], color[ 3 ];
+        buzzShader( u, in, position, color );
+
+        for ( int c = 0; c < 4; c++ ) {
+            outputs.position[ c ][ i ] = position[ c ];
+        }
+        for ( int c = 0; c < 3; c++ ) {
+            outputs.color[ c ][ i ] = color[ c ];
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef BUZZ_REFERENCE_H
+#define BUZZ_REFERENCE_H
+
+#include <vector>
+#include <QMatrix4x4>
+#include <QGenericMatrix>
+#include <QVector3D>
+#include <QVector4D>
+#include "batch.h"
+
+// CPU implementation of the vertex stage of the (unindexed) buzz shader, as found in
+// "shaders/buzz_vertshader.glsl". It follows the operations of the shader exactly, such
+// that it can serve as a reference for the shader, or to process vertices without a GPU.
+// Only the global lights are evaluated; the shader adds the point lights of the LightGrid.
+
+/**
+ * @brief The BuzzShaderUniforms struct contains all uniforms of the buzz vertex shader
+ */
+struct BuzzShaderUniforms {
+    static const int NUM_LIGHTS = 3;
+
+    QVector3D lightPositions[ NUM_LIGHTS ];
+    Color3D lightColors[ NUM_LIGHTS ];
+    float spike;
+
+    QMatrix4x4 projectionMat;
+    QMatrix4x4 viewMat;
+    QMatrix4x4 modelMat;
+    QMatrix3x3 normalMat;
+
+    Color3D color;
+    float ka; // Ambient multiplier
+    float ks; // Specular multiplier
+    float kd; // Diffuse multiplier
+    float p; // Specular exponent (shininess)
+};
+
+/**
+ * @brief The BuzzShaderOutput struct contains the outputs of the buzz vertex shader
+ *   for a single vertex
+ */
+struct BuzzShaderOutput {
+    QVector4D position; // gl_Position, in clip space
+    Color3D color; // vertexColor
+};
+
+/**
+ * @brief The BuzzVerticesSoA struct contains buzz vertices in structure-of-arrays form.
+ *   Component c (x, y or z) of triangle position k (in_position, in_position2 or
+ *   in_position3) of vertex i is found at positions[ k ][ c ][ i ].
+ */
+struct BuzzVerticesSoA {
+    std::vector< float > positions[ 3 ][ 3 ];
+
+    BuzzVerticesSoA( const QVector< BuzzVertex3 >& vertices );
+    int size( ) const;
+};
+
+/**
+ * @brief The BuzzShaderOutputsSoA struct contains the outputs of the buzz vertex shader
+ *   in structure-of-arrays form.
+ */
+struct BuzzShaderOutputsSoA {
+    std::vector< float > position[ 4 ]; // x, y, z, w of gl_Position
+    std::vector< float > color[ 3 ]; // r, g, b of vertexColor
+
+    void resize( int size );
+};
+
+/**
+ * @brief buzzVertexShader Runs the buzz vertex shader for a single vertex
+ *
+ * @param uniforms The uniforms of the shader
+ * @param vertex The vertex attributes
+ * @return The outputs of the shader
+ */
+BuzzShaderOutput buzzVertexShader( const BuzzShaderUniforms& uniforms, const BuzzVertex3& vertex );
+
+/**
+ * @brief buzzDeform Runs the deform shader ("shaders/buzz_deform_vertshader.glsl") for a
+ *   single vertex, which extrudes the triangle of the vertex as the buzz vertex shader does
+ *
+ * @param vertex The vertex attributes
+ * @param spike The spike factor
+ * @param position The extruded position of the vertex, in model space
+ * @param normal The normal of the extruded triangle, in model space
+ */
+void buzzDeform( const BuzzVertex3& vertex, float spike, QVector3D& position, QVector3D& normal );
+
+/**
+ * @brief buzzVertexShaderBatch Runs the buzz vertex shader for all given vertices. Where
+ *   available, 4 vertices are processed at once with SSE. The results are identical to
+ *   those of buzzVertexShader( ).
+ *
+ * @param uniforms The uniforms of the shader
+ * @param vertices The vertex attributes
+ * @param outputs The outputs of the shader, which are resized to the number of vertices
+ */
+void buzzVertexShaderBatch( const BuzzShaderUniforms& uniforms, const BuzzVerticesSoA& vertices, BuzzShaderOutputsSoA& outputs );
+
+#endif // BUZZ_REFERENCE_H
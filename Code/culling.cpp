@@ -0,0 +1,240 @@
+#include "culling.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <limits>
+
+// Documentation can be found in the culling.h file
+
+// -- Frustum --
+
+Frustum::Frustum( const QMatrix4x4& viewProjectionMat ) {
+    // A point p is inside when -w <= x, y, z <= w for its clip coordinates ( x, y, z, w ).
+    // Each of these inequalities is a plane in world space, e.g. dot( row3 + row0, p ) >= 0.
+    QVector4D rows[ 4 ];
+    for ( int i = 0; i < 4; i++ ) {
+        rows[ i ] = viewProjectionMat.row( i );
+    }
+    planes[ 0 ] = rows[ 3 ] + rows[ 0 ]; // Left
+    planes[ 1 ] = rows[ 3 ] - rows[ 0 ]; // Right
+    planes[ 2 ] = rows[ 3 ] + rows[ 1 ]; // Bottom
+    planes[ 3 ] = rows[ 3 ] - rows[ 1 ]; // Top
+    planes[ 4 ] = rows[ 3 ] + rows[ 2 ]; // Near
+    planes[ 5 ] = rows[ 3 ] - rows[ 2 ]; // Far
+
+    // With unit normals the plane equation gives the signed distance
+    for ( QVector4D& plane : planes ) {
+        plane /= plane.toVector3D( ).length( );
+    }
+}
+
+Frustum::Result Frustum::test( const BoundingSphere& sphere ) const {
+    Result result = INSIDE;
+    for ( const QVector4D& plane : planes ) {
+        float distance = QVector3D::dotProduct( plane.toVector3D( ), sphere.center ) + plane.w( );
+        if ( distance < -sphere.radius ) {
+            return OUTSIDE;
+        } else if ( distance < sphere.radius ) {
+            result = INTERSECTS;
+        }
+    }
+    return result;
+}
+
+Frustum::Result Frustum::test( const float min[ 3 ], const float max[ 3 ] ) const {
+    Result result = INSIDE;
+    for ( const QVector4D& plane : planes ) {
+        // The distances of the corners furthest along and against the normal
+        float furthest = plane.w( );
+        float nearest = plane.w( );
+        for ( int i = 0; i < 3; i++ ) {
+            if ( plane[ i ] >= 0 ) {
+                furthest += plane[ i ] * max[ i ];
+                nearest += plane[ i ] * min[ i ];
+            } else {
+                furthest += plane[ i ] * min[ i ];
+                nearest += plane[ i ] * max[ i ];
+            }
+        }
+        if ( furthest < 0 ) {
+            return OUTSIDE;
+        } else if ( nearest < 0 ) {
+            result = INTERSECTS;
+        }
+    }
+    return result;
+}
+
+// -- BoundingVolumeHierarchy --
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy( ) {
+
+}
+
+// An upper bound on the number of nodes of a tree over the given number of items.
+// An inner node is split in halves, so every leaf holds at least ( LEAF_SIZE + 1 ) / 2
+// items. Also, the bound of a node is at least 1 plus the bounds of its children,
+// such that a subtree fits in the nodes reserved for it.
+int BoundingVolumeHierarchy::maxNodes( int numItems ) {
+    if ( numItems <= LEAF_SIZE ) {
+        return numItems > 0 ? 1 : 0;
+    }
+    return 2 * ( numItems / ( ( LEAF_SIZE + 1 ) / 2 ) ) - 1;
+}
+
+// Spreads the lower 10 bits of v, such that there are two zero bits between every bit
+static quint32 spreadBits( quint32 v ) {
+    v = ( v * 0x00010001u ) & 0xFF0000FFu;
+    v = ( v * 0x00000101u ) & 0x0F00F00Fu;
+    v = ( v * 0x00000011u ) & 0xC30C30C3u;
+    v = ( v * 0x00000005u ) & 0x49249249u;
+    return v;
+}
+
+void BoundingVolumeHierarchy::build( const std::vector< BoundingSphere >& spheres ) {
+    sortByMortonCode( spheres );
+
+    items.resize( spheres.size( ) );
+    for ( size_t i = 0; i < spheres.size( ); i++ ) {
+        const int index = int( keys[ i ] & 0xFFFFFFFFu );
+        items[ i ].sphere = spheres[ index ];
+        items[ i ].index = index;
+    }
+
+    nodes.resize( maxNodes( int( items.size( ) ) ) );
+    if ( !items.empty( ) ) {
+        buildNode( 0, 0, int( items.size( ) ) );
+    }
+}
+
+void BoundingVolumeHierarchy::sortByMortonCode( const std::vector< BoundingSphere >& spheres ) {
+    const int numSpheres = int( spheres.size( ) );
+
+    // The centers are quantized to 10 bits per axis within their bounding box
+    float min[ 3 ], max[ 3 ];
+    for ( int i = 0; i < 3; i++ ) {
+        min[ i ] = std::numeric_limits< float >::infinity( );
+        max[ i ] = -std::numeric_limits< float >::infinity( );
+    }
+    for ( const BoundingSphere& sphere : spheres ) {
+        for ( int i = 0; i < 3; i++ ) {
+            min[ i ] = std::min( min[ i ], sphere.center[ i ] );
+            max[ i ] = std::max( max[ i ], sphere.center[ i ] );
+        }
+    }
+    float scale[ 3 ];
+    for ( int i = 0; i < 3; i++ ) {
+        scale[ i ] = ( max[ i ] > min[ i ] ) ? 1023.0f / ( max[ i ] - min[ i ] ) : 0.0f;
+    }
+
+    keys.resize( numSpheres );
+    for ( int j = 0; j < numSpheres; j++ ) {
+        quint32 code = 0;
+        for ( int i = 0; i < 3; i++ ) {
+            float cell = ( spheres[ j ].center[ i ] - min[ i ] ) * scale[ i ];
+            code |= spreadBits( quint32( std::min( std::max( cell, 0.0f ), 1023.0f ) ) ) << ( 2 - i );
+        }
+        keys[ j ] = ( quint64( code ) << 32 ) | quint64( j );
+    }
+
+    // Least significant digit radix sort on the 30 bits of the codes
+    const int RADIX_BITS = 10;
+    const int NUM_BUCKETS = 1 << RADIX_BITS;
+    sortBuffer.resize( numSpheres );
+    std::vector< int > offsets( NUM_BUCKETS );
+    for ( int shift = 32; shift < 32 + 30; shift += RADIX_BITS ) {
+        std::fill( offsets.begin( ), offsets.end( ), 0 );
+        for ( quint64 key : keys ) {
+            offsets[ ( key >> shift ) & ( NUM_BUCKETS - 1 ) ]++;
+        }
+        int sum = 0;
+        for ( int& offset : offsets ) {
+            const int count = offset;
+            offset = sum;
+            sum += count;
+        }
+        for ( quint64 key : keys ) {
+            sortBuffer[ offsets[ ( key >> shift ) & ( NUM_BUCKETS - 1 ) ]++ ] = key;
+        }
+        keys.swap( sortBuffer );
+    }
+}
+
+void BoundingVolumeHierarchy::buildNode( int nodeIndex, int begin, int end ) {
+    Node& node = nodes[ nodeIndex ];
+    node.begin = begin;
+    node.end = end;
+
+    if ( end - begin <= LEAF_SIZE ) {
+        node.right = -1;
+        for ( int i = 0; i < 3; i++ ) {
+            node.min[ i ] = std::numeric_limits< float >::infinity( );
+            node.max[ i ] = -std::numeric_limits< float >::infinity( );
+        }
+        for ( int j = begin; j < end; j++ ) {
+            const BoundingSphere& sphere = items[ j ].sphere;
+            for ( int i = 0; i < 3; i++ ) {
+                node.min[ i ] = std::min( node.min[ i ], sphere.center[ i ] - sphere.radius );
+                node.max[ i ] = std::max( node.max[ i ], sphere.center[ i ] + sphere.radius );
+            }
+        }
+        return;
+    }
+
+    // The items are sorted along the curve, so each half is a compact region
+    const int mid = begin + ( end - begin ) / 2;
+    const int left = nodeIndex + 1;
+    const int right = left + maxNodes( mid - begin );
+    node.right = right;
+
+    if ( end - begin >= PARALLEL_SIZE ) {
+        JobCounter counter;
+        JobSystem::instance( ).submit( [this, left, begin, mid]( ) { buildNode( left, begin, mid ); }, counter );
+        buildNode( right, mid, end );
+        JobSystem::instance( ).wait( counter );
+    } else {
+        buildNode( left, begin, mid );
+        buildNode( right, mid, end );
+    }
+
+    for ( int i = 0; i < 3; i++ ) {
+        node.min[ i ] = std::min( nodes[ left ].min[ i ], nodes[ right ].min[ i ] );
+        node.max[ i ] = std::max( nodes[ left ].max[ i ], nodes[ right ].max[ i ] );
+    }
+}
+
+void BoundingVolumeHierarchy::cull( const Frustum& frustum, std::vector< int >& visible ) const {
+    visible.clear( );
+    if ( nodes.empty( ) ) {
+        return;
+    }
+
+    // The tree is balanced, so its depth is at most about log2( size( ) )
+    int stack[ 64 ];
+    int stackSize = 0;
+    stack[ stackSize++ ] = 0;
+
+    while ( stackSize > 0 ) {
+        const int nodeIndex = stack[ --stackSize ];
+        const Node& node = nodes[ nodeIndex ];
+
+        Frustum::Result result = frustum.test( node.min, node.max );
+        if ( result == Frustum::OUTSIDE ) {
+            continue;
+        } else if ( result == Frustum::INSIDE ) {
+            // So are all spheres in this subtree
+            for ( int i = node.begin; i < node.end; i++ ) {
+                visible.push_back( items[ i ].index );
+            }
+        } else if ( node.right < 0 ) {
+            for ( int i = node.begin; i < node.end; i++ ) {
+                if ( frustum.test( items[ i ].sphere ) != Frustum::OUTSIDE ) {
+                    visible.push_back( items[ i ].index );
+                }
+            }
+        } else {
+            stack[ stackSize++ ] = node.right;
+            stack[ stackSize++ ] = nodeIndex + 1;
+        }
+    }
+}
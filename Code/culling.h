@@ -0,0 +1,106 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QVector4D>
+#include <QtGlobal>
+#include <vector>
+
+/**
+ * @brief The BoundingSphere struct is a sphere in world space that encloses an object
+ */
+struct BoundingSphere {
+    QVector3D center;
+    float radius;
+};
+
+/**
+ * @brief The Frustum class is the view volume of a camera, given by the six planes
+ *   of its clip space
+ */
+class Frustum {
+public:
+    enum Result {
+        OUTSIDE,
+        INTERSECTS,
+        INSIDE
+    };
+
+    /**
+     * @brief Frustum Extracts the planes from the matrix that maps world space to clip
+     *   space, which is the projection matrix multiplied by the view matrix
+     */
+    explicit Frustum( const QMatrix4x4& viewProjectionMat );
+
+    Result test( const BoundingSphere& sphere ) const;
+    Result test( const float min[ 3 ], const float max[ 3 ] ) const;
+private:
+    // The normal of a plane points inward, and has unit length
+    QVector4D planes[ 6 ];
+};
+
+/**
+ * @brief The BoundingVolumeHierarchy class is a binary tree of axis-aligned boxes over
+ *   a set of bounding spheres, with which those inside a frustum are found without
+ *   testing them all.
+ *
+ * The tree is built from scratch every time, in linear time. The spheres are sorted along
+ *   a Morton (Z-order) curve through their centers with a radix sort, such that nearby
+ *   spheres are close in the order. Every node then splits its range of spheres in
+ *   halves, and its box is merged from those of its children. The two halves of large
+ *   nodes are built in parallel on the JobSystem. As the leaves and subtrees hold
+ *   contiguous ranges of spheres, a subtree that is entirely inside the frustum is
+ *   accepted without any further test.
+ */
+class BoundingVolumeHierarchy {
+public:
+    BoundingVolumeHierarchy( );
+
+    /**
+     * @brief build Builds the tree over the given spheres. May be called from within a job.
+     * @param spheres The spheres, which are identified by their index in this vector
+     */
+    void build( const std::vector< BoundingSphere >& spheres );
+
+    int size( ) const { return int( items.size( ) ); }
+
+    /**
+     * @brief cull Finds the spheres that are (partially) inside the frustum
+     * @param frustum The frustum to test against
+     * @param visible Receives the indices of the visible spheres, in no particular order
+     */
+    void cull( const Frustum& frustum, std::vector< int >& visible ) const;
+
+private:
+    struct Item {
+        BoundingSphere sphere;
+        int index;
+    };
+
+    // A node covers the items in [begin, end). The left child of an inner
+    // node directly follows it; the right child is at index 'right'.
+    struct Node {
+        float min[ 3 ];
+        float max[ 3 ];
+        int begin;
+        int end;
+        int right; // -1 for a leaf
+    };
+
+    static const int LEAF_SIZE = 8;
+    static const int PARALLEL_SIZE = 16 * 1024;
+
+    static int maxNodes( int numItems );
+    void sortByMortonCode( const std::vector< BoundingSphere >& spheres );
+    void buildNode( int node, int begin, int end );
+
+    std::vector< Item > items;
+    std::vector< Node > nodes;
+
+    // The Morton code of every sphere in the upper 32 bits, and its index in the lower
+    std::vector< quint64 > keys;
+    std::vector< quint64 > sortBuffer;
+};
+
+#endif // CULLING_H
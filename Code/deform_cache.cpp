@@ -0,0 +1,140 @@
+#include "deform_cache.h"
+
+// Documentation can be found in the deform_cache.h file
+
+/**
+ * @brief The DeformedBatch class is a batch of which the vertices were captured by
+ *   transform feedback. Every three vertices form a triangle, so it has no indices.
+ */
+class DeformCache::DeformedBatch : public GeneralBatch {
+public:
+    // A captured vertex
+    struct Vertex {
+        float position[3];
+        float normal[3];
+    };
+
+    DeformedBatch( QOpenGLFunctions_3_3_Core *pGl )
+        : pGl( pGl ), capacity( 0 ), numTriangles( 0 ) {
+        pGl->glGenBuffers( 1, &vbo );
+        pGl->glGenVertexArrays( 1, &vao );
+
+        pGl->glBindVertexArray( vao );
+        pGl->glBindBuffer( GL_ARRAY_BUFFER, vbo );
+        pGl->glEnableVertexAttribArray( II_POSITION );
+        pGl->glEnableVertexAttribArray( II_NORMAL );
+        pGl->glVertexAttribPointer( II_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof( Vertex ), (void *) 0 );
+        pGl->glVertexAttribPointer( II_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof( Vertex ), (void *) ( 3 * sizeof( float ) ) );
+        pGl->glBindVertexArray( 0 );
+        pGl->glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    }
+
+    ~DeformedBatch( ) {
+        pGl->glDeleteBuffers( 1, &vbo );
+        pGl->glDeleteVertexArrays( 1, &vao );
+    }
+
+    /**
+     * @brief capture Binds the buffer for transform feedback of the given number of
+     *   triangles, growing it if needed
+     */
+    void capture( int triangles ) {
+        if ( triangles > capacity ) {
+            capacity = triangles;
+            // The VAO refers to the buffer object, which stays the same
+            pGl->glBindBuffer( GL_TRANSFORM_FEEDBACK_BUFFER, vbo );
+            pGl->glBufferData( GL_TRANSFORM_FEEDBACK_BUFFER, GLsizeiptr( capacity ) * 3 * sizeof( Vertex ), nullptr, GL_DYNAMIC_COPY );
+        }
+        numTriangles = triangles;
+        pGl->glBindBufferRange( GL_TRANSFORM_FEEDBACK_BUFFER, 0, vbo, 0, GLsizeiptr( numTriangles ) * 3 * sizeof( Vertex ) );
+    }
+
+    void draw( ) {
+        bind( );
+        drawBound( );
+    }
+
+    void drawBound( ) {
+        pGl->glDrawArrays( GL_TRIANGLES, 0, 3 * numTriangles );
+    }
+
+    void bind( ) {
+        pGl->glBindVertexArray( vao );
+    }
+
+    GLuint vertexArray( ) const {
+        return vao;
+    }
+
+    void drawInstanced( int numInstances ) {
+        pGl->glDrawArraysInstanced( GL_TRIANGLES, 0, 3 * numTriangles, numInstances );
+    }
+
+    int triangleCount( ) const {
+        return numTriangles;
+    }
+
+private:
+    const static unsigned int II_POSITION = 0;
+    const static unsigned int II_NORMAL = 1;
+
+    QOpenGLFunctions_3_3_Core *pGl;
+    GLuint vao;
+    GLuint vbo;
+    // In triangles
+    int capacity;
+    int numTriangles;
+};
+
+DeformCache::DeformCache( QOpenGLFunctions_3_3_Core *pGl, ProgramCache& programs, const QString& vertexSource,
+                          const QString& geometrySource )
+    : pGl( pGl ),
+      spikeLocation( -1 ),
+      numUsed( 0 ),
+      numVertices( 0 ) {
+    // Only the captured vertices are of interest, so there is no fragment shader
+    ProgramCache::Sources sources;
+    sources.vertex = vertexSource;
+    sources.geometry = geometrySource;
+    sources.varyings = QStringList( { "tf_position", "tf_normal" } );
+    programs.add( program, sources, [this]( QOpenGLShaderProgram& linked ) {
+        spikeLocation = linked.uniformLocation( "u_deformSpike" );
+    } );
+}
+
+void DeformCache::beginFrame( ) {
+    numUsed = 0;
+    numVertices = 0;
+}
+
+std::shared_ptr< GeneralBatch > DeformCache::deform( GeneralBatch& source, float spike ) {
+    for ( int i = 0; i < numUsed; i++ ) {
+        if ( entries[ i ].pSource == &source && entries[ i ].spike == spike ) {
+            return entries[ i ].pBatch;
+        }
+    }
+
+    if ( numUsed == int( entries.size( ) ) ) {
+        DeformedBatch *pDeformed = new DeformedBatch( pGl );
+        entries.push_back( Entry { nullptr, 0, std::shared_ptr< GeneralBatch >( pDeformed ), pDeformed } );
+    }
+    Entry& entry = entries[ numUsed ];
+    numUsed++;
+    entry.pSource = &source;
+    entry.spike = spike;
+
+    program.bind( );
+    pGl->glUniform1f( spikeLocation, spike );
+
+    entry.pDeformed->capture( source.triangleCount( ) );
+    // Only the captured vertices are of interest
+    pGl->glEnable( GL_RASTERIZER_DISCARD );
+    pGl->glBeginTransformFeedback( GL_TRIANGLES );
+    source.draw( );
+    pGl->glEndTransformFeedback( );
+    pGl->glDisable( GL_RASTERIZER_DISCARD );
+    pGl->glBindBufferBase( GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0 );
+
+    numVertices += 3 * source.triangleCount( );
+    return entry.pBatch;
+}
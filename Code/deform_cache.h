@@ -0,0 +1,89 @@
+#ifndef DEFORM_CACHE_H
+#define DEFORM_CACHE_H
+
+#include "batch.h"
+#include "program_cache.h"
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The DeformCache class deforms a buzz batch once for every distinct spike factor
+ *   in a frame, instead of once for every ball that is drawn with it.
+ *
+ * The deform shaders extrude the vertices of a batch and compute the face normals, of
+ *   which the results are captured in a buffer by transform feedback. As every corner of
+ *   a triangle is captured, indexed batches are captured without indices as well. That
+ *   buffer is then drawn as a batch of positions (location 0) and normals (location 1) by
+ *   all balls with the same level of detail and spike factor, with the cached buzz shaders,
+ *   which merely transform and light the vertices. The cost of the deformation is thus
+ *   proportional to the number of distinct spike factors, rather than to the number of balls.
+ *
+ * The deformed batches are reused in the next frames, so their buffers are only allocated
+ *   as more distinct spike factors are needed.
+ *
+ * Note that this class can only be used after OpenGL is initialised
+ */
+class DeformCache {
+public:
+    /**
+     * @brief DeformCache Starts building the deform program for batches of a single vertex
+     *   format. The cache can be used once the programs are finished.
+     * @param pGl The functions of the context
+     * @param programs Builds the deform program
+     * @param vertexSource The source of the deform vertex shader
+     * @param geometrySource The source of the deform geometry shader, which may be empty
+     */
+    DeformCache( QOpenGLFunctions_3_3_Core *pGl, ProgramCache& programs, const QString& vertexSource,
+                 const QString& geometrySource = QString( ) );
+
+    /**
+     * @brief beginFrame Discards the deformations of the previous frame
+     */
+    void beginFrame( );
+
+    /**
+     * @brief deform Returns the source batch deformed by the spike factor, which is
+     *   computed by the first call with these arguments in the frame. This binds another
+     *   program and VAO, and must not be called while the ring buffer is mapped.
+     * @param source A batch with the vertex format of the deform shaders
+     * @param spike The spike factor
+     * @return The deformed batch, of which the contents are valid until the next beginFrame( ).
+     *   It is returned by value, as later calls may reallocate the entries.
+     */
+    std::shared_ptr< GeneralBatch > deform( GeneralBatch& source, float spike );
+
+    /**
+     * @brief numDeforms The number of deform passes since beginFrame( )
+     */
+    int numDeforms( ) const { return numUsed; }
+
+    /**
+     * @brief numVerticesDeformed The number of vertices processed by the deform passes
+     *   since beginFrame( )
+     */
+    int numVerticesDeformed( ) const { return numVertices; }
+
+private:
+    class DeformedBatch;
+
+    struct Entry {
+        GeneralBatch *pSource;
+        float spike;
+        std::shared_ptr< GeneralBatch > pBatch;
+        DeformedBatch *pDeformed;
+    };
+
+    QOpenGLFunctions_3_3_Core *pGl;
+    QOpenGLShaderProgram program;
+    GLint spikeLocation;
+
+    // The first numUsed entries hold the deformations of this frame
+    std::vector< Entry > entries;
+    int numUsed;
+    int numVertices;
+};
+
+#endif // DEFORM_CACHE_H
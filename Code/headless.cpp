@@ -0,0 +1,137 @@
+#include "headless.h"
+#include "scene.h"
+#include "profiler.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <algorithm>
+#include <vector>
+
+// Documentation can be found in the headless.h file
+
+int runHeadless( const HeadlessOptions& options ) {
+    QOffscreenSurface surface;
+    surface.setFormat( QSurfaceFormat::defaultFormat( ) );
+    surface.create( );
+
+    QOpenGLContext context;
+    context.setFormat( QSurfaceFormat::defaultFormat( ) );
+    if ( !context.create( ) || !context.makeCurrent( &surface ) ) {
+        qDebug( ) << ":: Failed to create an OpenGL context";
+        return 1;
+    }
+
+    QOpenGLFramebufferObjectFormat fboFormat;
+    fboFormat.setAttachment( QOpenGLFramebufferObject::Depth );
+    fboFormat.setInternalTextureFormat( GL_RGBA8 );
+    QOpenGLFramebufferObject fbo( options.width, options.height, fboFormat );
+
+    // Declared after the context, so its resources are released while it still exists
+    BuzzScene scene;
+    QOpenGLFunctions_3_3_Core& gl = scene;
+    scene.initialize( );
+    scene.resize( options.width, options.height );
+    scene.setInstancing( options.instancing );
+
+    qDebug( ) << ":: Using OpenGL" << reinterpret_cast< const char * >( gl.glGetString( GL_VERSION ) )
+              << "on" << reinterpret_cast< const char * >( gl.glGetString( GL_RENDERER ) );
+
+    QDir outputDir( options.output );
+    QFile outputFile;
+    if ( !options.output.isEmpty( ) ) {
+        bool isOpen;
+        if ( options.format == HeadlessOptions::PNG ) {
+            isOpen = outputDir.mkpath( "." );
+        } else if ( options.output == "-" ) {
+            isOpen = outputFile.open( stdout, QIODevice::WriteOnly );
+        } else {
+            outputFile.setFileName( options.output );
+            isOpen = outputFile.open( QIODevice::WriteOnly | QIODevice::Truncate );
+        }
+        if ( !isOpen ) {
+            qDebug( ) << ":: Failed to open" << options.output;
+            return 1;
+        }
+    }
+
+    const int rowBytes = options.width * 4;
+    std::vector< uchar > pixels( rowBytes * options.height );
+    gl.glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+
+#ifdef BUZZ_PROFILING
+    Profiler::instance( ).setEnabled( !options.profileCsv.isEmpty( ) );
+#else
+    if ( !options.profileCsv.isEmpty( ) ) {
+        qDebug( ) << ":: Profiling is not compiled in (BUZZ_PROFILING)";
+    }
+#endif
+
+    QElapsedTimer timer;
+    qint64 exportNs = 0;
+    qint64 numDrawn = 0;
+    timer.start( );
+
+    for ( int frame = 0; frame < options.numFrames; frame++ ) {
+        fbo.bind( );
+        gl.glViewport( 0, 0, options.width, options.height );
+        scene.render( );
+        numDrawn += scene.visibleCount( );
+
+        if ( options.output.isEmpty( ) ) {
+            continue;
+        }
+
+        QElapsedTimer exportTimer;
+        exportTimer.start( );
+
+        // OpenGL returns the rows bottom-up
+        gl.glReadPixels( 0, 0, options.width, options.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data( ) );
+        if ( options.format == HeadlessOptions::PNG ) {
+            QImage image( pixels.data( ), options.width, options.height, rowBytes, QImage::Format_RGBA8888 );
+            QString fileName = QString( "frame_%1.png" ).arg( frame, 5, 10, QChar( '0' ) );
+            if ( !image.mirrored( ).save( outputDir.filePath( fileName ) ) ) {
+                qDebug( ) << ":: Failed to write" << fileName;
+                return 1;
+            }
+        } else {
+            for ( int y = options.height - 1; y >= 0; y-- ) {
+                outputFile.write( reinterpret_cast< const char * >( &pixels[ y * rowBytes ] ), rowBytes );
+            }
+        }
+
+        exportNs += exportTimer.nsecsElapsed( );
+    }
+
+    // Without readbacks the driver may still be busy
+    gl.glFinish( );
+    qint64 totalNs = timer.nsecsElapsed( );
+    outputFile.close( );
+
+    double totalSeconds = totalNs / 1e9;
+    double renderSeconds = ( totalNs - exportNs ) / 1e9;
+    qDebug( ).nospace( ) << ":: Rendered " << options.numFrames << " frames of " << options.width << "x" << options.height
+                         << " in " << totalSeconds << " s (" << ( options.numFrames / totalSeconds ) << " fps)";
+    if ( exportNs > 0 ) {
+        qDebug( ).nospace( ) << ":: Excluding readback and export: " << renderSeconds << " s ("
+                             << ( options.numFrames / renderSeconds ) << " fps)";
+    }
+    // Divides the time of a section by the balls drawn, e.g. for the per object cost
+    qDebug( ).nospace( ) << ":: Drew " << ( double( numDrawn ) / std::max( options.numFrames, 1 ) ) << " balls per frame"
+                         << ( options.instancing ? " (instanced)" : " (one draw call each)" );
+
+#ifdef BUZZ_PROFILING
+    if ( !options.profileCsv.isEmpty( ) ) {
+        Profiler& profiler = Profiler::instance( );
+        profiler.dump( );
+        profiler.writeCsv( options.profileCsv );
+        profiler.setEnabled( false );
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <QString>
+
+/**
+ * @brief The HeadlessOptions struct describes a headless rendering run
+ */
+struct HeadlessOptions {
+    enum Format {
+        PNG, // A numbered PNG image per frame in the output directory
+        RAW // All frames consecutively as top-down RGBA8 rows in the output file
+    };
+
+    int numFrames;
+    int width;
+    int height;
+    Format format;
+    QString output; // Empty if the frames should not be exported. For RAW, "-" means stdout.
+    QString profileCsv; // Empty if the run should not be profiled
+    bool instancing; // Without it, the per object cost of the draw loop can be profiled
+
+    HeadlessOptions( )
+        : numFrames( 600 ), width( 800 ), height( 600 ), format( PNG ), instancing( true ) { }
+};
+
+/**
+ * @brief runHeadless Renders the scene without a window, to a framebuffer object of an
+ *   offscreen surface. The frames are rendered with the same fixed timestep as in the
+ *   MainView, though as fast as possible. The throughput is reported once finished.
+ *
+ * Note that a QGuiApplication should exist
+ *
+ * @param options The frames to render and where to write them to
+ * @return The exit code of the application
+ */
+int runHeadless( const HeadlessOptions& options );
+
+#endif // HEADLESS_H
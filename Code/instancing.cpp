@@ -0,0 +1,109 @@
+#include "instancing.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+// Documentation can be found in the instancing.h file
+
+InstancedRenderer::InstancedRenderer( QOpenGLFunctions_3_3_Core *pGl, RingBuffer& ringBuffer )
+    : pGl( pGl ),
+      ringBuffer( ringBuffer ) {
+
+}
+
+void InstancedRenderer::add( AnimatedBatch& batch, const QMatrix4x4& modelMat, const QMatrix3x3& normalMat, float spike, int level ) {
+    add( batch.levelBatch( level ), *batch.pMaterial, modelMat, normalMat, spike );
+}
+
+void InstancedRenderer::add( const std::shared_ptr< GeneralBatch >& pBatch, const Material& material, const QMatrix4x4& modelMat,
+                             const QMatrix3x3& normalMat, float spike ) {
+    auto it = groups.find( pBatch );
+    if ( it == groups.end( ) ) {
+        it = groups.emplace( pBatch, InstanceGroup( ) ).first;
+    }
+
+    BuzzInstance instance;
+    std::copy( modelMat.constData( ), modelMat.constData( ) + 16, instance.modelMat );
+    std::copy( normalMat.constData( ), normalMat.constData( ) + 9, instance.normalMat );
+    instance.color[ 0 ] = material.color.x( );
+    instance.color[ 1 ] = material.color.y( );
+    instance.color[ 2 ] = material.color.z( );
+    instance.material[ 0 ] = material.ka;
+    instance.material[ 1 ] = material.ks;
+    instance.material[ 2 ] = material.kd;
+    instance.material[ 3 ] = material.p;
+    instance.spike = spike;
+
+    it->second.instances.push_back( instance );
+}
+
+void InstancedRenderer::render( ) {
+    BUZZ_PROFILE_GPU( "instancing.render" );
+
+    // All groups are written before the first draw, as the ring buffer is unmapped once
+    {
+        BUZZ_PROFILE_CPU( "instancing.upload" );
+        for ( auto& entry : groups ) {
+            InstanceGroup& group = entry.second;
+            if ( !group.instances.empty( ) ) {
+                const GLsizeiptr size = sizeof( BuzzInstance ) * group.instances.size( );
+                group.allocation = ringBuffer.allocate( size );
+                std::memcpy( group.allocation.pData, group.instances.data( ), size );
+            }
+        }
+        ringBuffer.unmap( );
+    }
+
+    for ( auto it = groups.begin( ); it != groups.end( ); ) {
+        InstanceGroup& group = it->second;
+        // A group without instances this frame is dropped, which also releases its batch,
+        //   such that batches that are no longer drawn are not visited every frame
+        if ( group.instances.empty( ) ) {
+            it = groups.erase( it );
+            continue;
+        }
+        BUZZ_PROFILE_CPU( "instancing.draw" );
+
+        // The layout is stored in the VAO of the batch, though its offset into the
+        // ring buffer differs every frame. As batches share their VAO, it is set per group.
+        it->first->bind( );
+        pGl->glBindBuffer( GL_ARRAY_BUFFER, group.allocation.buffer );
+        setupInstanceLayout( group.allocation );
+
+        it->first->drawInstanced( int( group.instances.size( ) ) );
+
+        group.instances.clear( );
+        ++it;
+    }
+}
+
+void InstancedRenderer::setupInstanceLayout( const RingBuffer::Allocation& allocation ) {
+    const GLsizei stride = sizeof( BuzzInstance );
+    const char *pBase = reinterpret_cast< const char * >( allocation.offset );
+
+    // A matrix attribute occupies one location per column
+    for ( unsigned int i = 0; i < 4; i++ ) {
+        pGl->glEnableVertexAttribArray( II_MODELMAT + i );
+        pGl->glVertexAttribPointer( II_MODELMAT + i, 4, GL_FLOAT, GL_FALSE, stride, (const void *) ( pBase + offsetof( BuzzInstance, modelMat ) + i * 4 * sizeof( float ) ) );
+        pGl->glVertexAttribDivisor( II_MODELMAT + i, 1 );
+    }
+    for ( unsigned int i = 0; i < 3; i++ ) {
+        pGl->glEnableVertexAttribArray( II_NORMALMAT + i );
+        pGl->glVertexAttribPointer( II_NORMALMAT + i, 3, GL_FLOAT, GL_FALSE, stride, (const void *) ( pBase + offsetof( BuzzInstance, normalMat ) + i * 3 * sizeof( float ) ) );
+        pGl->glVertexAttribDivisor( II_NORMALMAT + i, 1 );
+    }
+
+    pGl->glEnableVertexAttribArray( II_COLOR );
+    pGl->glVertexAttribPointer( II_COLOR, 3, GL_FLOAT, GL_FALSE, stride, (const void *) ( pBase + offsetof( BuzzInstance, color ) ) );
+    pGl->glVertexAttribDivisor( II_COLOR, 1 );
+
+    pGl->glEnableVertexAttribArray( II_MATERIAL );
+    pGl->glVertexAttribPointer( II_MATERIAL, 4, GL_FLOAT, GL_FALSE, stride, (const void *) ( pBase + offsetof( BuzzInstance, material ) ) );
+    pGl->glVertexAttribDivisor( II_MATERIAL, 1 );
+
+    pGl->glEnableVertexAttribArray( II_SPIKE );
+    pGl->glVertexAttribPointer( II_SPIKE, 1, GL_FLOAT, GL_FALSE, stride, (const void *) ( pBase + offsetof( BuzzInstance, spike ) ) );
+    pGl->glVertexAttribDivisor( II_SPIKE, 1 );
+}
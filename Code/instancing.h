@@ -0,0 +1,84 @@
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <QOpenGLFunctions_3_3_Core>
+#include "animation.h"
+#include "batch.h"
+#include "ring_buffer.h"
+
+/**
+ * @brief The BuzzInstance struct contains the per-instance attributes of a single buzz ball,
+ *   as read by the instanced buzz vertex shader. The matrices are stored column-major.
+ */
+struct BuzzInstance {
+    float modelMat[16];
+    float normalMat[9];
+    float color[3];
+    float material[4]; // ka, ks, kd, p
+    float spike;
+};
+
+/**
+ * @brief The InstancedRenderer class draws all AnimatedBatches that share the same
+ *   GeneralBatch with a single instanced draw call. Every frame the batches are added
+ *   with their per-instance attributes, which are then written to the RingBuffer for
+ *   every GeneralBatch upon rendering.
+ *
+ * This class is tailored to the instanced buzz shader. Its per-instance attributes
+ *   follow the attributes of the BuzzBatch.
+ *
+ * Note that this class can only be used after OpenGL is initialised
+ */
+class InstancedRenderer {
+public:
+    InstancedRenderer( QOpenGLFunctions_3_3_Core *pGl, RingBuffer& ringBuffer );
+
+    /**
+     * @brief add Adds the batch to be drawn upon the next render( ) call
+     * @param batch The batch to draw
+     * @param modelMat The model matrix of the batch
+     * @param normalMat The normal matrix belonging to the model matrix
+     * @param spike The spike factor of the buzz ball
+     * @param level The level of detail to draw the batch with
+     */
+    void add( AnimatedBatch& batch, const QMatrix4x4& modelMat, const QMatrix3x3& normalMat, float spike, int level = 0 );
+
+    /**
+     * @brief add Adds a GeneralBatch with the given material to be drawn upon the next
+     *   render( ) call, such as one deformed by a DeformCache
+     */
+    void add( const std::shared_ptr< GeneralBatch >& pBatch, const Material& material, const QMatrix4x4& modelMat,
+              const QMatrix3x3& normalMat, float spike );
+
+    /**
+     * @brief render Draws all batches added since the previous call. Every group of
+     *   batches sharing a GeneralBatch is drawn with a single draw call. The instanced
+     *   buzz shader program should be bound. Unmaps the ring buffer.
+     */
+    void render( );
+private:
+    struct InstanceGroup {
+        std::vector< BuzzInstance > instances;
+        RingBuffer::Allocation allocation;
+    };
+
+    void setupInstanceLayout( const RingBuffer::Allocation& allocation );
+
+    QOpenGLFunctions_3_3_Core *pGl;
+    RingBuffer& ringBuffer;
+
+    // The batch is kept alive by the group, as its VAO refers to the ring buffer. Groups
+    //   that had no instances for a frame are removed by render( ).
+    std::map< std::shared_ptr< GeneralBatch >, InstanceGroup > groups;
+
+    const static unsigned int II_MODELMAT = 3; // Occupies 4 locations
+    const static unsigned int II_NORMALMAT = 7; // Occupies 3 locations
+    const static unsigned int II_COLOR = 10;
+    const static unsigned int II_MATERIAL = 11;
+    const static unsigned int II_SPIKE = 12;
+};
+
+#endif // INSTANCING_H
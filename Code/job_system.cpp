@@ -0,0 +1,222 @@
+#include "job_system.h"
+
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+
+// Documentation can be found in the job_system.h file
+
+// The number of times a waiting thread yields before it sleeps
+static const int WAIT_SPINS = 64;
+// The longest a waiting thread sleeps before it looks for jobs of its counter again, as
+// these may have been submitted meanwhile
+static const std::chrono::microseconds WAIT_SLEEP( 200 );
+
+// The index of the worker running on this thread, or -1 for any other thread
+static thread_local int workerIndex = -1;
+// The counter of the job running on this thread, or null
+static thread_local const JobCounter *pRunningCounter = nullptr;
+
+// The number of workers to start, or 0 for the default
+static int requestedWorkers = 0;
+
+// Whether the job belongs to the counter, directly or through the jobs that submitted it
+static bool isPartOf( const JobCounter *pCounter, const JobCounter *pWaited ) {
+    for ( ; pCounter != nullptr; pCounter = pCounter->pParent ) {
+        if ( pCounter == pWaited ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+JobSystem& JobSystem::instance( ) {
+    static JobSystem jobSystem;
+    return jobSystem;
+}
+
+void JobSystem::setNumWorkers( int numWorkers ) {
+    requestedWorkers = numWorkers;
+}
+
+JobSystem::JobSystem( )
+    : numQueued( 0 ),
+      numBackground( 0 ),
+      quit( false ) {
+    // Background jobs need a worker, even when there is a single core
+    const int numWorkers = std::max( 1, requestedWorkers > 0 ? requestedWorkers : QThread::idealThreadCount( ) - 1 );
+    for ( int i = 0; i < numWorkers + 1; i++ ) {
+        queues.push_back( std::make_unique< JobQueue >( ) );
+    }
+    for ( int i = 0; i < numWorkers; i++ ) {
+        workers.emplace_back( [this, i]( ) { workerLoop( i ); } );
+    }
+}
+
+JobSystem::~JobSystem( ) {
+    {
+        std::lock_guard< std::mutex > lock( sleepMutex );
+        quit = true;
+    }
+    wakeCondition.notify_all( );
+    for ( std::thread& worker : workers ) {
+        worker.join( );
+    }
+}
+
+void JobSystem::submit( std::function< void( ) > job, JobCounter& counter ) {
+    // While the count is 0, no queued job can refer to the counter as a parent
+    if ( counter.count++ == 0 ) {
+        counter.pParent = pRunningCounter;
+    }
+
+    const int index = ( workerIndex >= 0 ) ? workerIndex : int( workers.size( ) );
+    {
+        std::lock_guard< std::mutex > lock( queues[ index ]->mutex );
+        queues[ index ]->jobs.push_back( Job { std::move( job ), &counter } );
+    }
+
+    // Counted under the lock, such that a worker cannot miss it before going to sleep
+    {
+        std::lock_guard< std::mutex > lock( sleepMutex );
+        numQueued++;
+    }
+    wakeCondition.notify_one( );
+}
+
+void JobSystem::submitBackground( std::function< void( ) > job, JobCounter& counter ) {
+    counter.count++;
+
+    {
+        std::lock_guard< std::mutex > lock( backgroundQueue.mutex );
+        backgroundQueue.jobs.push_back( Job { std::move( job ), &counter } );
+    }
+
+    {
+        std::lock_guard< std::mutex > lock( sleepMutex );
+        numBackground++;
+    }
+    wakeCondition.notify_one( );
+}
+
+void JobSystem::wait( JobCounter& counter ) {
+    int numSpins = 0;
+    while ( !counter.isDone( ) ) {
+        if ( runOne( counter ) ) {
+            numSpins = 0;
+            continue;
+        }
+        // The remaining jobs are running on other threads, and typically finish soon
+        if ( numSpins++ < WAIT_SPINS ) {
+            std::this_thread::yield( );
+            continue;
+        }
+        std::unique_lock< std::mutex > lock( sleepMutex );
+        doneCondition.wait_for( lock, WAIT_SLEEP, [&counter]( ) { return counter.isDone( ); } );
+    }
+}
+
+void JobSystem::parallelFor( int count, int grainSize, const std::function< void( int, int ) >& f ) {
+    if ( count <= 0 ) {
+        return;
+    }
+    grainSize = std::max( 1, grainSize );
+
+    JobCounter counter;
+    for ( int begin = grainSize; begin < count; begin += grainSize ) {
+        const int end = std::min( count, begin + grainSize );
+        submit( [&f, begin, end]( ) { f( begin, end ); }, counter );
+    }
+    // The first range runs on this thread right away
+    f( 0, std::min( count, grainSize ) );
+    wait( counter );
+}
+
+void JobSystem::workerLoop( int index ) {
+    workerIndex = index;
+
+    while ( true ) {
+        Job job;
+        if ( popOwn( index, job, nullptr ) || steal( index, job, nullptr ) || popBackground( job ) ) {
+            run( job );
+            continue;
+        }
+
+        std::unique_lock< std::mutex > lock( sleepMutex );
+        wakeCondition.wait( lock, [this]( ) { return quit || numQueued.load( ) > 0 || numBackground.load( ) > 0; } );
+        if ( quit ) {
+            return;
+        }
+    }
+}
+
+// A waiting thread (pWaited not null) only takes the jobs of its counter
+bool JobSystem::popOwn( int index, Job& job, const JobCounter *pWaited ) {
+    JobQueue& queue = *queues[ index ];
+    std::lock_guard< std::mutex > lock( queue.mutex );
+    for ( auto it = queue.jobs.rbegin( ); it != queue.jobs.rend( ); ++it ) {
+        if ( pWaited == nullptr || isPartOf( it->pCounter, pWaited ) ) {
+            job = std::move( *it );
+            queue.jobs.erase( std::next( it ).base( ) );
+            numQueued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JobSystem::steal( int thief, Job& job, const JobCounter *pWaited ) {
+    const int numQueues = int( queues.size( ) );
+    for ( int i = 1; i < numQueues; i++ ) {
+        JobQueue& queue = *queues[ ( thief + i ) % numQueues ];
+        std::lock_guard< std::mutex > lock( queue.mutex );
+        for ( auto it = queue.jobs.begin( ); it != queue.jobs.end( ); ++it ) {
+            if ( pWaited == nullptr || isPartOf( it->pCounter, pWaited ) ) {
+                job = std::move( *it );
+                queue.jobs.erase( it );
+                numQueued--;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool JobSystem::popBackground( Job& job ) {
+    std::lock_guard< std::mutex > lock( backgroundQueue.mutex );
+    if ( backgroundQueue.jobs.empty( ) ) {
+        return false;
+    }
+    job = std::move( backgroundQueue.jobs.front( ) );
+    backgroundQueue.jobs.pop_front( );
+    numBackground--;
+    return true;
+}
+
+bool JobSystem::runOne( const JobCounter& waited ) {
+    const int index = ( workerIndex >= 0 ) ? workerIndex : int( workers.size( ) );
+    Job job;
+    if ( popOwn( index, job, &waited ) || steal( index, job, &waited ) ) {
+        run( job );
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::run( Job& job ) {
+    const JobCounter *pOuterCounter = pRunningCounter;
+    pRunningCounter = job.pCounter;
+    {
+        // Destroyed before the counter is decremented, as the waiting thread may
+        // free anything the job refers to once the counter is done
+        std::function< void( ) > function = std::move( job.function );
+        function( );
+    }
+    pRunningCounter = pOuterCounter;
+
+    // The counter may be gone once it is done, so it is not touched afterwards
+    if ( job.pCounter->count.fetch_sub( 1 ) == 1 ) {
+        std::lock_guard< std::mutex > lock( sleepMutex );
+        doneCondition.notify_all( );
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The JobCounter struct counts the unfinished jobs of a submission. It may only
+ *   be destroyed once JobSystem::wait( ) has returned for it.
+ */
+struct JobCounter {
+    std::atomic< int > count;
+    // The counter of the job that submitted to it, or null if submitted outside a job
+    const JobCounter *pParent;
+
+    JobCounter( ) : count( 0 ), pParent( nullptr ) { }
+    bool isDone( ) const { return count.load( ) == 0; }
+};
+
+/**
+ * @brief The JobSystem class runs small jobs on one worker thread per core. Every worker
+ *   has its own deque of jobs. A worker pushes and pops jobs at the back of its own deque,
+ *   such that nested jobs run while their data is still in the cache. An idle worker steals
+ *   from the front of the other deques, where the oldest (and typically largest) jobs are.
+ *   Jobs submitted from any other thread go to a shared deque, from which all workers steal.
+ *
+ * A thread waiting for a counter runs pending jobs of that counter, and the jobs these
+ *   submitted in turn, until the counter is done. Jobs may thus submit and wait for jobs
+ *   themselves, though a job that submits jobs must wait for them before it returns. Other
+ *   jobs are left to the workers, such that waiting for a short parallelFor( ) never runs,
+ *   for example, the evaluation of the next frame. Once no such job is left, the waiting
+ *   thread yields for a while, and then sleeps until a job finishes. As the calling thread
+ *   contributes to the work, idealThreadCount( ) - 1 workers are started, but at least
+ *   one, unless setNumWorkers( ) says otherwise.
+ *
+ * Background jobs (e.g. decoding files) are only picked up by idle workers, never by a
+ *   waiting thread, such that a long background job cannot delay a frame that waits.
+ *
+ * Note that the Profiler is not thread-safe, so jobs may not contain BUZZ_PROFILE_* scopes.
+ */
+class JobSystem {
+public:
+    static JobSystem& instance( );
+
+    /**
+     * @brief setNumWorkers Sets the number of workers to start, for example to measure the
+     *   scaling with the number of threads. Only has an effect before the first instance( ).
+     */
+    static void setNumWorkers( int numWorkers );
+
+    ~JobSystem( );
+
+    /**
+     * @brief numThreads The number of threads that run jobs, including the waiting thread
+     */
+    int numThreads( ) const { return int( workers.size( ) ) + 1; }
+
+    /**
+     * @brief submit Queues a job, which may run on any thread
+     * @param job The function to run
+     * @param counter Incremented now, and decremented once the job has finished
+     */
+    void submit( std::function< void( ) > job, JobCounter& counter );
+
+    /**
+     * @brief submitBackground Queues a job that runs on a worker once no other jobs are
+     *   pending. Waiting for its counter does not run it, but only blocks until it is done.
+     * @param job The function to run
+     * @param counter Incremented now, and decremented once the job has finished
+     */
+    void submitBackground( std::function< void( ) > job, JobCounter& counter );
+
+    /**
+     * @brief wait Runs pending jobs of the counter until all its jobs have finished
+     */
+    void wait( JobCounter& counter );
+
+    /**
+     * @brief parallelFor Calls f( begin, end ) for consecutive ranges of at most grainSize
+     *   elements, that together cover [0, count). Returns once all ranges are done.
+     * @param count The number of elements
+     * @param grainSize The maximum number of elements per job
+     * @param f A function taking the begin and end index of a range
+     */
+    void parallelFor( int count, int grainSize, const std::function< void( int, int ) >& f );
+
+private:
+    JobSystem( );
+    JobSystem( const JobSystem& ) = delete;
+
+    struct Job {
+        std::function< void( ) > function;
+        JobCounter *pCounter;
+    };
+
+    struct JobQueue {
+        std::mutex mutex;
+        std::deque< Job > jobs;
+    };
+
+    void workerLoop( int index );
+    bool popOwn( int index, Job& job, const JobCounter *pWaited );
+    bool steal( int thief, Job& job, const JobCounter *pWaited );
+    bool popBackground( Job& job );
+    bool runOne( const JobCounter& waited );
+    void run( Job& job );
+
+    // One queue per worker, followed by the shared queue of all other threads
+    std::vector< std::unique_ptr< JobQueue > > queues;
+    JobQueue backgroundQueue;
+    std::vector< std::thread > workers;
+
+    // Sleeping workers are woken when jobs are submitted, and sleeping waiting threads
+    // when a counter is done
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+    std::atomic< int > numQueued;
+    std::atomic< int > numBackground;
+    bool quit;
+};
+
+#endif // JOB_SYSTEM_H
@@ -0,0 +1,261 @@
+#include "light_grid.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Documentation can be found in the light_grid.h file
+
+// The depth of the end of the first slice, such that the slices are not wasted on the
+// few surfaces right in front of the camera
+static const float MIN_SLICE_DEPTH = 0.1f;
+
+// The number of lights binned by a job
+static const int LIGHTS_PER_JOB = 256;
+
+// The tile of an NDC coordinate, as computed by the shaders. The screen has numTiles
+// tiles, which start at 1 due to the guard band.
+static int tileOf( float ndc, int numTiles ) {
+    return std::min( std::max( int( std::floor( ( ndc * 0.5f + 0.5f ) * numTiles ) ) + 1, 0 ), numTiles + 1 );
+}
+
+LightGrid::LightGrid( QOpenGLFunctions_3_3_Core *pGl )
+    : pGl( pGl ),
+      projectionX( 1 ),
+      projectionY( 1 ),
+      depthScale( 1 ),
+      depthBias( 0 ),
+      farPlane( 0 ),
+      clusters( 2 * NUM_CLUSTERS, 0 ),
+      sliceOffsets( SLICES + 1, 0 ),
+      sliceIndices( SLICES ),
+      maxLights( 0 ),
+      attachedBuffer( 0 ),
+      textures { 0, 0, 0 } { }
+
+LightGrid::~LightGrid( ) {
+    if ( textures[ 0 ] != 0 ) {
+        pGl->glDeleteTextures( 3, textures );
+    }
+}
+
+int LightGrid::sliceOf( float depth ) const {
+    const float slice = std::floor( std::log( std::max( depth, 1e-6f ) ) * depthScale + depthBias );
+    return int( std::min( std::max( slice, 0.0f ), float( SLICES - 1 ) ) );
+}
+
+LightGrid::ClusterRange LightGrid::clusterRange( const PointLight& light, const QMatrix4x4& viewMat ) const {
+    ClusterRange range = { 0, GRID_X - 1, 0, GRID_Y - 1, 1, 0 };
+
+    // The camera looks along -z
+    const QVector3D center = viewMat.map( light.position );
+    const float r = light.radius;
+    const float nearDepth = -center.z( ) - r;
+    const float farDepth = -center.z( ) + r;
+    if ( farDepth <= 0 || nearDepth >= farPlane ) {
+        return range;
+    }
+    range.z0 = sliceOf( nearDepth );
+    range.z1 = sliceOf( farDepth );
+
+    // A box that reaches behind the camera may cover any tile
+    if ( nearDepth <= 0 ) {
+        return range;
+    }
+    // The box projects widest on the side that is closest to the camera. As the
+    // projection is symmetric, a coordinate maps to NDC by a scale and division by depth.
+    const auto ndcMin = [nearDepth, farDepth]( float v, float scale ) {
+        return scale * v / ( v < 0 ? nearDepth : farDepth );
+    };
+    const auto ndcMax = [nearDepth, farDepth]( float v, float scale ) {
+        return scale * v / ( v > 0 ? nearDepth : farDepth );
+    };
+    const float x0 = ndcMin( center.x( ) - r, projectionX );
+    const float x1 = ndcMax( center.x( ) + r, projectionX );
+    const float y0 = ndcMin( center.y( ) - r, projectionY );
+    const float y1 = ndcMax( center.y( ) + r, projectionY );
+    // Beyond the guard band, which is a tile of 2 / TILES NDC wide
+    const float guardX = 1 + 2.0f / TILES_X;
+    const float guardY = 1 + 2.0f / TILES_Y;
+    if ( x0 > guardX || x1 < -guardX || y0 > guardY || y1 < -guardY ) {
+        range.z0 = 1;
+        range.z1 = 0;
+        return range;
+    }
+
+    range.x0 = tileOf( x0, TILES_X );
+    range.x1 = tileOf( x1, TILES_X );
+    range.y0 = tileOf( y0, TILES_Y );
+    range.y1 = tileOf( y1, TILES_Y );
+    return range;
+}
+
+int LightGrid::clusterOf( const QVector3D& viewPosition ) const {
+    // As in buzz_common.glsl, where the projection divides by the depth
+    const float depth = -viewPosition.z( );
+    const float w = std::max( std::abs( depth ), 1e-4f );
+    const int x = tileOf( projectionX * viewPosition.x( ) / w, TILES_X );
+    const int y = tileOf( projectionY * viewPosition.y( ) / w, TILES_Y );
+    return ( sliceOf( depth ) * GRID_Y + y ) * GRID_X + x;
+}
+
+std::vector< uint32_t > LightGrid::clusterLights( int cluster ) const {
+    const auto begin = lightIndices.begin( ) + clusters[ 2 * cluster ];
+    return std::vector< uint32_t >( begin, begin + clusters[ 2 * cluster + 1 ] );
+}
+
+void LightGrid::build( const QMatrix4x4& viewMat, const QMatrix4x4& projectionMat, float far ) {
+    projectionX = projectionMat( 0, 0 );
+    projectionY = projectionMat( 1, 1 );
+    farPlane = far;
+    // The slice of a depth is log( depth ) * depthScale + depthBias, where the first slice
+    // ends at MIN_SLICE_DEPTH and the last one at the far plane
+    depthScale = ( SLICES - 1 ) / std::log( far / MIN_SLICE_DEPTH );
+    depthBias = 1 - std::log( MIN_SLICE_DEPTH ) * depthScale;
+
+    JobSystem& jobs = JobSystem::instance( );
+    const int numLights = int( pointLights.size( ) );
+    ranges.resize( numLights );
+    jobs.parallelFor( numLights, LIGHTS_PER_JOB, [&]( int begin, int end ) {
+        for ( int i = begin; i < end; i++ ) {
+            ranges[ i ] = clusterRange( pointLights[ i ], viewMat );
+        }
+    } );
+
+    // Buckets the lights by the slices they overlap, in the order of the lights, such
+    // that every slice only visits its own lights
+    std::fill( sliceOffsets.begin( ), sliceOffsets.end( ), 0 );
+    for ( const ClusterRange& range : ranges ) {
+        for ( int z = range.z0; z <= range.z1; z++ ) {
+            sliceOffsets[ z + 1 ]++;
+        }
+    }
+    for ( int z = 0; z < SLICES; z++ ) {
+        sliceOffsets[ z + 1 ] += sliceOffsets[ z ];
+    }
+    sliceLights.resize( sliceOffsets[ SLICES ] );
+    {
+        std::vector< uint32_t > next( sliceOffsets.begin( ), sliceOffsets.end( ) - 1 );
+        for ( int light = 0; light < numLights; light++ ) {
+            const ClusterRange& range = ranges[ light ];
+            for ( int z = range.z0; z <= range.z1; z++ ) {
+                sliceLights[ next[ z ]++ ] = uint32_t( light );
+            }
+        }
+    }
+
+    // Every slice only writes its own clusters and indices
+    static const int CLUSTERS_PER_SLICE = GRID_X * GRID_Y;
+    std::vector< int > sliceMax( SLICES, 0 );
+    jobs.parallelFor( SLICES, 1, [&]( int begin, int end ) {
+        for ( int z = begin; z < end; z++ ) {
+            uint32_t *pClusters = &clusters[ 2 * z * CLUSTERS_PER_SLICE ];
+            const uint32_t *pLightsBegin = sliceLights.data( ) + sliceOffsets[ z ];
+            const uint32_t *pLightsEnd = sliceLights.data( ) + sliceOffsets[ z + 1 ];
+            uint32_t counts[ CLUSTERS_PER_SLICE ] = { };
+            for ( const uint32_t *pLight = pLightsBegin; pLight != pLightsEnd; ++pLight ) {
+                const ClusterRange& range = ranges[ *pLight ];
+                for ( int y = range.y0; y <= range.y1; y++ ) {
+                    for ( int x = range.x0; x <= range.x1; x++ ) {
+                        counts[ y * GRID_X + x ]++;
+                    }
+                }
+            }
+
+            uint32_t offset = 0;
+            for ( int i = 0; i < CLUSTERS_PER_SLICE; i++ ) {
+                pClusters[ 2 * i ] = offset;
+                pClusters[ 2 * i + 1 ] = counts[ i ];
+                offset += counts[ i ];
+                sliceMax[ z ] = std::max( sliceMax[ z ], int( counts[ i ] ) );
+                // From now on the position to write the next index of the cluster to
+                counts[ i ] = pClusters[ 2 * i ];
+            }
+
+            std::vector< uint32_t >& indices = sliceIndices[ z ];
+            indices.resize( offset );
+            for ( const uint32_t *pLight = pLightsBegin; pLight != pLightsEnd; ++pLight ) {
+                const ClusterRange& range = ranges[ *pLight ];
+                for ( int y = range.y0; y <= range.y1; y++ ) {
+                    for ( int x = range.x0; x <= range.x1; x++ ) {
+                        indices[ counts[ y * GRID_X + x ]++ ] = *pLight;
+                    }
+                }
+            }
+        }
+    } );
+
+    // The offsets of every slice are relative to its own indices
+    lightIndices.clear( );
+    for ( int z = 0; z < SLICES; z++ ) {
+        const uint32_t base = uint32_t( lightIndices.size( ) );
+        for ( int i = 0; i < CLUSTERS_PER_SLICE; i++ ) {
+            clusters[ 2 * ( z * CLUSTERS_PER_SLICE + i ) ] += base;
+        }
+        lightIndices.insert( lightIndices.end( ), sliceIndices[ z ].begin( ), sliceIndices[ z ].end( ) );
+    }
+    maxLights = *std::max_element( sliceMax.begin( ), sliceMax.end( ) );
+}
+
+void LightGrid::upload( RingBuffer& ringBuffer, LightGridBlock& block ) {
+    // The light data, clusters and light indices share an allocation, such that they are
+    // in the same buffer even if the ring buffer grows. Their offsets are multiples of 16
+    // bytes, and thus of the size of their texels.
+    const GLsizeiptr dataSize = GLsizeiptr( 8 * sizeof( float ) * pointLights.size( ) );
+    const GLsizeiptr clustersOffset = dataSize;
+    const GLsizeiptr indicesOffset = clustersOffset + GLsizeiptr( sizeof( uint32_t ) * clusters.size( ) );
+    const GLsizeiptr size = indicesOffset + GLsizeiptr( sizeof( uint32_t ) * lightIndices.size( ) );
+    static_assert( ( sizeof( uint32_t ) * 2 * NUM_CLUSTERS ) % 16 == 0, "The light indices should stay aligned" );
+
+    RingBuffer::Allocation allocation = ringBuffer.allocate( size, 16 );
+    char *pData = static_cast< char * >( allocation.pData );
+
+    // Every light takes two texels: its position and radius, and its color
+    float *pTexels = reinterpret_cast< float * >( pData );
+    for ( const PointLight& light : pointLights ) {
+        pTexels[ 0 ] = light.position.x( );
+        pTexels[ 1 ] = light.position.y( );
+        pTexels[ 2 ] = light.position.z( );
+        pTexels[ 3 ] = light.radius;
+        pTexels[ 4 ] = light.color.x( );
+        pTexels[ 5 ] = light.color.y( );
+        pTexels[ 6 ] = light.color.z( );
+        pTexels[ 7 ] = 0.0f;
+        pTexels += 8;
+    }
+    std::copy( clusters.begin( ), clusters.end( ), reinterpret_cast< uint32_t * >( pData + clustersOffset ) );
+    std::copy( lightIndices.begin( ), lightIndices.end( ), reinterpret_cast< uint32_t * >( pData + indicesOffset ) );
+
+    // The textures cover the whole ring buffer, so they only change along with it (as it
+    // grows). The shaders add the offset of the frame's range to every index.
+    if ( textures[ 0 ] == 0 ) {
+        pGl->glGenTextures( 3, textures );
+    }
+    const GLint units[ 3 ] = { TU_LIGHT_DATA, TU_LIGHT_CLUSTERS, TU_LIGHT_INDICES };
+    const GLenum formats[ 3 ] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+    for ( int i = 0; i < 3; i++ ) {
+        pGl->glActiveTexture( GL_TEXTURE0 + units[ i ] );
+        pGl->glBindTexture( GL_TEXTURE_BUFFER, textures[ i ] );
+        if ( allocation.buffer != attachedBuffer ) {
+            pGl->glTexBuffer( GL_TEXTURE_BUFFER, formats[ i ], allocation.buffer );
+        }
+    }
+    pGl->glActiveTexture( GL_TEXTURE0 );
+    attachedBuffer = allocation.buffer;
+
+    // In texels of the respective formats
+    block.offsets[ 0 ] = uint32_t( allocation.offset / ( 4 * sizeof( float ) ) );
+    block.offsets[ 1 ] = uint32_t( ( allocation.offset + clustersOffset ) / ( 2 * sizeof( uint32_t ) ) );
+    block.offsets[ 2 ] = uint32_t( ( allocation.offset + indicesOffset ) / sizeof( uint32_t ) );
+    block.offsets[ 3 ] = 0;
+
+    // The tiles on the screen, without the guard band
+    block.size[ 0 ] = TILES_X;
+    block.size[ 1 ] = TILES_Y;
+    block.size[ 2 ] = SLICES;
+    block.size[ 3 ] = uint32_t( pointLights.size( ) );
+    block.depthScale = depthScale;
+    block.depthBias = depthBias;
+    block.padding[ 0 ] = 0;
+    block.padding[ 1 ] = 0;
+}
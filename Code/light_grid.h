@@ -0,0 +1,151 @@
+#ifndef LIGHT_GRID_H
+#define LIGHT_GRID_H
+
+#include "ring_buffer.h"
+#include "uniforms.h"
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QVector3D>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief The PointLight struct is a local light, which only affects the surfaces
+ *   within its radius
+ */
+struct PointLight {
+    QVector3D position;
+    QVector3D color;
+    // The light falls off smoothly, to nothing at this distance
+    float radius;
+};
+
+/**
+ * @brief The LightGrid class holds any number of point lights, and finds the lights that
+ *   affect every part of the view volume, such that a shader only loops over those.
+ *
+ * The view volume is split into clusters: TILES_X by TILES_Y tiles on the screen, each
+ *   split into SLICES along the depth. The slices grow exponentially with the depth, such
+ *   that the clusters stay roughly cubical. Every frame, build( ) bins the lights into the
+ *   clusters their bounding box overlaps, on all threads of the JobSystem. First the
+ *   clusters covered by every light are found and the lights are bucketed by the slices
+ *   they overlap, after which every depth slice collects its own lights independently. The shading cost is thus proportional to the number of lights
+ *   near a surface, rather than to the number of lights in the scene.
+ *
+ * The tiles are surrounded by a guard band of one tile on every side. The vertices just
+ *   outside the screen, of triangles that are partly on it, are thus lit by the lights
+ *   near them rather than by those of the nearest tile on the screen. Vertices beyond the
+ *   guard band use its outer tiles, though only triangles larger than a tile can have
+ *   such vertices and still be visible.
+ *
+ * The lights, the range of indices of every cluster, and the light indices are streamed
+ *   through the RingBuffer. Buffer textures over the whole ring buffer are bound to the
+ *   units TU_LIGHT_DATA, TU_LIGHT_CLUSTERS and TU_LIGHT_INDICES, and the shaders read the
+ *   frame's data at the offsets in the 'LightGrid' uniform block, along with the grid
+ *   dimensions. (OpenGL 3.3 lacks glTexBufferRange.) The ring buffer should thus fit in
+ *   GL_MAX_TEXTURE_BUFFER_SIZE texels.
+ *
+ * Note that upload( ) can only be called after OpenGL is initialised. The buffer textures
+ *   are created by its first call, so the lights can be binned without a context.
+ */
+class LightGrid {
+public:
+    static const int TILES_X = 16;
+    static const int TILES_Y = 9;
+    static const int SLICES = 24;
+    // The tiles along x and y including the guard band
+    static const int GRID_X = TILES_X + 2;
+    static const int GRID_Y = TILES_Y + 2;
+    static const int NUM_CLUSTERS = GRID_X * GRID_Y * SLICES;
+
+    LightGrid( QOpenGLFunctions_3_3_Core *pGl );
+    ~LightGrid( );
+
+    /**
+     * @brief lights The lights of the scene, which may be changed between frames
+     */
+    std::vector< PointLight >& lights( ) { return pointLights; }
+    const std::vector< PointLight >& lights( ) const { return pointLights; }
+
+    /**
+     * @brief build Bins the lights into the clusters of the given camera
+     * @param viewMat The view matrix
+     * @param projectionMat A symmetric perspective projection
+     * @param far The depth of the far plane, beyond which lights are ignored
+     */
+    void build( const QMatrix4x4& viewMat, const QMatrix4x4& projectionMat, float far );
+
+    /**
+     * @brief upload Streams the lights and clusters of the last build( ) to the ring buffer,
+     *   and binds the buffer textures that read them
+     * @param ringBuffer The buffer to write this frame's data to
+     * @param block The uniform block to write the grid dimensions and offsets to
+     */
+    void upload( RingBuffer& ringBuffer, LightGridBlock& block );
+
+    /**
+     * @brief numReferences The number of (light, cluster) pairs found by the last build( )
+     */
+    int numReferences( ) const { return int( lightIndices.size( ) ); }
+
+    /**
+     * @brief maxPerCluster The largest number of lights in a single cluster in the last build( )
+     */
+    int maxPerCluster( ) const { return maxLights; }
+
+    /**
+     * @brief clusterOf The cluster the shaders read the lights of a point from, with the
+     *   camera of the last build( )
+     * @param viewPosition The point in view space
+     * @return The index of the cluster, ( z * GRID_Y + y ) * GRID_X + x
+     */
+    int clusterOf( const QVector3D& viewPosition ) const;
+
+    /**
+     * @brief clusterLights The indices of the lights binned into a cluster by the last build( )
+     */
+    std::vector< uint32_t > clusterLights( int cluster ) const;
+
+private:
+    // The clusters overlapped by the bounding box of a light, inclusive, where tile 0 is
+    // in the guard band. Empty if z0 > z1.
+    struct ClusterRange {
+        int x0, x1;
+        int y0, y1;
+        int z0, z1;
+    };
+
+    ClusterRange clusterRange( const PointLight& light, const QMatrix4x4& viewMat ) const;
+    int sliceOf( float depth ) const;
+
+    QOpenGLFunctions_3_3_Core *pGl;
+
+    std::vector< PointLight > pointLights;
+
+    // Set by build( ) from the camera
+    float projectionX;
+    float projectionY;
+    float depthScale;
+    float depthBias;
+    float farPlane;
+
+    std::vector< ClusterRange > ranges;
+    // The lights overlapping every slice, in order, from sliceOffsets[ z ] up to
+    // sliceOffsets[ z + 1 ]
+    std::vector< uint32_t > sliceLights;
+    std::vector< uint32_t > sliceOffsets;
+    // The offset into lightIndices and the number of lights, for every cluster
+    std::vector< uint32_t > clusters;
+    std::vector< uint32_t > lightIndices;
+    // The indices of every slice, before they are concatenated
+    std::vector< std::vector< uint32_t > > sliceIndices;
+    int maxLights;
+
+    // The ring buffer the textures read from
+    GLuint attachedBuffer;
+    // Light data, clusters and light indices. Zero until the first upload( ).
+    GLuint textures[ 3 ];
+};
+
+#endif // LIGHT_GRID_H
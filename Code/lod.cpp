@@ -0,0 +1,307 @@
+#include "lod.h"
+
+#include <QDebug>
+#include <algorithm>
+#include <array>
+#include <queue>
+
+// Documentation can be found in the lod.h file
+
+namespace {
+
+// Vertices further than this from the origin are spike tips
+const float SPIKE_TIP_LENGTH = 1.0001f;
+
+// The radius on screen (in pixels) below which level i + 1 is used instead of level i
+const float LOD_PIXEL_RADII[ ] = { 100.0f, 50.0f, 25.0f };
+const int NUM_LOD_THRESHOLDS = sizeof( LOD_PIXEL_RADII ) / sizeof( LOD_PIXEL_RADII[ 0 ] );
+
+// The relative margin past a threshold before the level changes
+const float LOD_HYSTERESIS = 0.15f;
+
+/**
+ * @brief The Quadric struct is a symmetric 4x4 matrix Q, such that for a point p the error
+ *   ( p, 1 )^T Q ( p, 1 ) is the weighted sum of squared distances of p to a set of planes.
+ *   Only its upper triangle is stored.
+ */
+struct Quadric {
+    double a[ 10 ];
+
+    Quadric( ) {
+        std::fill( a, a + 10, 0.0 );
+    }
+
+    // The plane dot( n, p ) + d = 0, for a unit normal n
+    Quadric( const QVector3D& n, double d, double weight ) {
+        const double nx = n.x( ), ny = n.y( ), nz = n.z( );
+        a[ 0 ] = nx * nx; a[ 1 ] = nx * ny; a[ 2 ] = nx * nz; a[ 3 ] = nx * d;
+        a[ 4 ] = ny * ny; a[ 5 ] = ny * nz; a[ 6 ] = ny * d;
+        a[ 7 ] = nz * nz; a[ 8 ] = nz * d;
+        a[ 9 ] = d * d;
+        for ( double& v : a ) {
+            v *= weight;
+        }
+    }
+
+    void add( const Quadric& other ) {
+        for ( int i = 0; i < 10; i++ ) {
+            a[ i ] += other.a[ i ];
+        }
+    }
+
+    double error( const QVector3D& p ) const {
+        const double x = p.x( ), y = p.y( ), z = p.z( );
+        return a[ 0 ] * x * x + 2 * a[ 1 ] * x * y + 2 * a[ 2 ] * x * z + 2 * a[ 3 ] * x
+             + a[ 4 ] * y * y + 2 * a[ 5 ] * y * z + 2 * a[ 6 ] * y
+             + a[ 7 ] * z * z + 2 * a[ 8 ] * z
+             + a[ 9 ];
+    }
+};
+
+/**
+ * @brief The Simplifier class collapses the edges of a closed triangle mesh, cheapest first
+ */
+class Simplifier {
+public:
+    Simplifier( const BuzzMesh& mesh );
+
+    int numTriangles( ) const { return numLive; }
+
+    /**
+     * @brief simplify Collapses edges until at most the given number of triangles
+     *   remains, or no edge can be collapsed anymore
+     * @return The number of remaining triangles
+     */
+    int simplify( int targetTriangles );
+
+    /**
+     * @brief mesh Returns the remaining triangles, with the unused vertices removed
+     */
+    BuzzMesh mesh( ) const;
+
+private:
+    // Moving vertex 'from' onto vertex 'to'
+    struct Collapse {
+        double cost;
+        int from;
+        int to;
+        int fromVersion;
+        int toVersion;
+
+        // Orders the priority queue from cheap to expensive
+        bool operator<( const Collapse& other ) const { return cost > other.cost; }
+    };
+
+    std::vector< int > neighbours( int vertex ) const;
+    void pushCollapses( int vertex );
+    bool isValid( int from, int to ) const;
+    void collapse( int from, int to );
+
+    std::vector< QVector3D > positions;
+    std::vector< bool > isLocked;
+    std::vector< Quadric > quadrics;
+    // Incremented whenever a collapse changes the cost of the edges of a vertex
+    std::vector< int > versions;
+
+    std::vector< std::array< int, 3 > > triangles;
+    std::vector< bool > isRemoved;
+    std::vector< std::vector< int > > vertexTriangles;
+    int numLive;
+
+    std::priority_queue< Collapse > queue;
+};
+
+Simplifier::Simplifier( const BuzzMesh& mesh )
+    : positions( mesh.vertices.begin( ), mesh.vertices.end( ) ),
+      isLocked( mesh.vertices.size( ) ),
+      quadrics( mesh.vertices.size( ) ),
+      versions( mesh.vertices.size( ), 0 ),
+      triangles( mesh.triangles.size( ) ),
+      isRemoved( mesh.triangles.size( ), false ),
+      vertexTriangles( mesh.vertices.size( ) ),
+      numLive( mesh.triangles.size( ) ) {
+    for ( size_t v = 0; v < positions.size( ); v++ ) {
+        isLocked[ v ] = positions[ v ].length( ) > SPIKE_TIP_LENGTH;
+    }
+
+    for ( int t = 0; t < mesh.triangles.size( ); t++ ) {
+        const Triangle& triangle = mesh.triangles[ t ];
+        triangles[ t ] = { { int( triangle.v1 ), int( triangle.v2 ), int( triangle.v3 ) } };
+
+        // The quadric of the plane of the triangle, weighted by its area
+        const QVector3D& p1 = positions[ triangle.v1 ];
+        QVector3D normal = QVector3D::crossProduct( positions[ triangle.v2 ] - p1, positions[ triangle.v3 ] - p1 );
+        const float area = normal.length( ) / 2;
+        normal.normalize( );
+        Quadric quadric( normal, -QVector3D::dotProduct( normal, p1 ), area );
+
+        for ( int v : triangles[ t ] ) {
+            quadrics[ v ].add( quadric );
+            vertexTriangles[ v ].push_back( t );
+        }
+    }
+
+    for ( size_t v = 0; v < positions.size( ); v++ ) {
+        for ( int w : neighbours( int( v ) ) ) {
+            // Every edge is pushed from both of its sides
+            if ( !isLocked[ v ] ) {
+                Quadric quadric = quadrics[ v ];
+                quadric.add( quadrics[ w ] );
+                queue.push( Collapse { quadric.error( positions[ w ] ), int( v ), w, versions[ v ], versions[ w ] } );
+            }
+        }
+    }
+}
+
+std::vector< int > Simplifier::neighbours( int vertex ) const {
+    std::vector< int > result;
+    for ( int t : vertexTriangles[ vertex ] ) {
+        for ( int v : triangles[ t ] ) {
+            if ( v != vertex && std::find( result.begin( ), result.end( ), v ) == result.end( ) ) {
+                result.push_back( v );
+            }
+        }
+    }
+    return result;
+}
+
+void Simplifier::pushCollapses( int vertex ) {
+    for ( int w : neighbours( vertex ) ) {
+        Quadric quadric = quadrics[ vertex ];
+        quadric.add( quadrics[ w ] );
+        if ( !isLocked[ vertex ] ) {
+            queue.push( Collapse { quadric.error( positions[ w ] ), vertex, w, versions[ vertex ], versions[ w ] } );
+        }
+        if ( !isLocked[ w ] ) {
+            queue.push( Collapse { quadric.error( positions[ vertex ] ), w, vertex, versions[ w ], versions[ vertex ] } );
+        }
+    }
+}
+
+bool Simplifier::isValid( int from, int to ) const {
+    // The link condition: on a closed manifold, the edge is shared by exactly two
+    // triangles, and their opposite corners are the only common neighbours. Otherwise
+    // the collapse would pinch the surface.
+    std::vector< int > fromNeighbours = neighbours( from );
+    std::vector< int > toNeighbours = neighbours( to );
+    int numCommon = 0;
+    for ( int v : fromNeighbours ) {
+        numCommon += std::count( toNeighbours.begin( ), toNeighbours.end( ), v );
+    }
+    if ( numCommon != 2 || numLive <= 4 ) {
+        return false;
+    }
+
+    // None of the remaining triangles may flip or degenerate
+    for ( int t : vertexTriangles[ from ] ) {
+        const std::array< int, 3 >& triangle = triangles[ t ];
+        if ( std::find( triangle.begin( ), triangle.end( ), to ) != triangle.end( ) ) {
+            continue; // Removed by the collapse
+        }
+        QVector3D before[ 3 ], after[ 3 ];
+        for ( int i = 0; i < 3; i++ ) {
+            before[ i ] = positions[ triangle[ i ] ];
+            after[ i ] = ( triangle[ i ] == from ) ? positions[ to ] : before[ i ];
+        }
+        QVector3D normalBefore = QVector3D::crossProduct( before[ 1 ] - before[ 0 ], before[ 2 ] - before[ 0 ] );
+        QVector3D normalAfter = QVector3D::crossProduct( after[ 1 ] - after[ 0 ], after[ 2 ] - after[ 0 ] );
+        // Allows at most about 78 degrees of rotation
+        if ( QVector3D::dotProduct( normalBefore, normalAfter ) <= 0.2f * normalBefore.length( ) * normalAfter.length( ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Simplifier::collapse( int from, int to ) {
+    for ( int t : vertexTriangles[ from ] ) {
+        std::array< int, 3 >& triangle = triangles[ t ];
+        if ( std::find( triangle.begin( ), triangle.end( ), to ) != triangle.end( ) ) {
+            isRemoved[ t ] = true;
+            numLive--;
+            for ( int v : triangle ) {
+                if ( v != from ) {
+                    std::vector< int >& list = vertexTriangles[ v ];
+                    list.erase( std::find( list.begin( ), list.end( ), t ) );
+                }
+            }
+        } else {
+            std::replace( triangle.begin( ), triangle.end( ), from, to );
+            vertexTriangles[ to ].push_back( t );
+        }
+    }
+    vertexTriangles[ from ].clear( );
+    quadrics[ to ].add( quadrics[ from ] );
+
+    // The costs of the edges of 'to' changed, as did the validity of the
+    // edges of its neighbours, which may have been discarded before
+    versions[ from ]++;
+    versions[ to ]++;
+    pushCollapses( to );
+    for ( int v : neighbours( to ) ) {
+        pushCollapses( v );
+    }
+}
+
+int Simplifier::simplify( int targetTriangles ) {
+    while ( numLive > targetTriangles && !queue.empty( ) ) {
+        Collapse c = queue.top( );
+        queue.pop( );
+        if ( c.fromVersion != versions[ c.from ] || c.toVersion != versions[ c.to ] ) {
+            continue; // Superseded by a later entry
+        }
+        if ( isValid( c.from, c.to ) ) {
+            collapse( c.from, c.to );
+        }
+    }
+    return numLive;
+}
+
+BuzzMesh Simplifier::mesh( ) const {
+    BuzzMesh result;
+    std::vector< int > remap( positions.size( ), -1 );
+    for ( size_t v = 0; v < positions.size( ); v++ ) {
+        if ( !vertexTriangles[ v ].empty( ) ) {
+            remap[ v ] = result.vertices.size( );
+            result.vertices.append( positions[ v ] );
+        }
+    }
+    for ( size_t t = 0; t < triangles.size( ); t++ ) {
+        if ( !isRemoved[ t ] ) {
+            result.triangles.append( Triangle( remap[ triangles[ t ][ 0 ] ], remap[ triangles[ t ][ 1 ] ], remap[ triangles[ t ][ 2 ] ] ) );
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+std::vector< BuzzMesh > buzzLevelsOfDetail( const BuzzMesh& mesh, int numLevels, float ratio ) {
+    std::vector< BuzzMesh > levels;
+    levels.push_back( mesh );
+
+    Simplifier simplifier( mesh );
+    for ( int level = 1; level < numLevels; level++ ) {
+        const int before = simplifier.numTriangles( );
+        const int after = simplifier.simplify( int( before * ratio ) );
+        // A level that is not much coarser than the previous one is not worth drawing
+        if ( after > before * ( 1 + ratio ) / 2 ) {
+            break;
+        }
+        levels.push_back( simplifier.mesh( ) );
+        qDebug( ) << ":: Level of detail" << level << "has" << after << "triangles";
+    }
+    return levels;
+}
+
+int selectLevelOfDetail( float pixelRadius, int currentLevel, int numLevels ) {
+    const int maxLevel = std::min( numLevels - 1, NUM_LOD_THRESHOLDS );
+    int level = std::min( std::max( currentLevel, 0 ), maxLevel );
+    while ( level < maxLevel && pixelRadius < LOD_PIXEL_RADII[ level ] * ( 1 - LOD_HYSTERESIS ) ) {
+        level++;
+    }
+    while ( level > 0 && pixelRadius > LOD_PIXEL_RADII[ level - 1 ] * ( 1 + LOD_HYSTERESIS ) ) {
+        level--;
+    }
+    return level;
+}
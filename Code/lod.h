@@ -0,0 +1,36 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <vector>
+#include "batch.h"
+
+/**
+ * @brief buzzLevelsOfDetail Simplifies the buzz ball mesh into successively coarser levels,
+ *   by collapsing edges in the order of their quadric error (Garland and Heckbert).
+ *
+ * A vertex is always collapsed onto one of its neighbours, such that no new positions are
+ *   introduced. This matters for the buzz shader, which extrudes every vertex that lies
+ *   outside the unit sphere into a spike: a new vertex outside the unit sphere would grow
+ *   a spike of its own. For the same reason the spike tips (the vertices outside the unit
+ *   sphere) are never moved, so every level keeps all spikes at their exact positions.
+ *
+ * @param mesh The full-detail mesh, which is level 0
+ * @param numLevels The maximum number of levels, including level 0
+ * @param ratio The fraction of the triangles of a level that is kept in the next level
+ * @return The levels from fine to coarse. Fewer levels are returned once the mesh cannot
+ *   be simplified any further without moving a spike tip.
+ */
+std::vector< BuzzMesh > buzzLevelsOfDetail( const BuzzMesh& mesh, int numLevels, float ratio = 0.5f );
+
+/**
+ * @brief selectLevelOfDetail Picks the level of detail of an object from its size on screen.
+ *   An object switches level only once its size is a margin past the threshold, such that
+ *   it does not flicker between two levels when its size hovers around the threshold.
+ * @param pixelRadius The radius of the bounding sphere of the object on screen, in pixels
+ * @param currentLevel The level the object was drawn with last
+ * @param numLevels The number of levels available
+ * @return The level to draw the object with
+ */
+int selectLevelOfDetail( float pixelRadius, int currentLevel, int numLevels );
+
+#endif // LOD_H
@@ -1,10 +1,41 @@
 #include "mainwindow.h"
+#include "headless.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
 #include <QSurfaceFormat>
+#include <cstring>
+#include <memory>
+
+// The application type has to be chosen before the command line can be parsed
+static bool hasArgument(int argc, char *argv[], const char *argument)
+{
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], argument) == 0)
+            return true;
+    }
+    return false;
+}
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    // The headless mode needs no widgets, so it also runs without a display
+    // server when started with '-platform offscreen' (or under xvfb-run)
+    bool headless = hasArgument(argc, argv, "--headless");
+    std::unique_ptr<QGuiApplication> a(headless ? new QGuiApplication(argc, argv)
+                                                : new QApplication(argc, argv));
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption headlessOption("headless", "Render to an offscreen surface instead of a window.");
+    QCommandLineOption framesOption("frames", "Number of frames to render headless.", "n", "600");
+    QCommandLineOption sizeOption("size", "Size of the headless frames.", "WxH", "800x600");
+    QCommandLineOption formatOption("format", "Format of the exported frames: png or raw.", "format", "png");
+    QCommandLineOption outputOption("output", "Directory (png) or file (raw, '-' for stdout) to export the headless frames to.", "path");
+    QCommandLineOption profileOption("profile", "Profile the headless frames, and write the statistics to a CSV file.", "csv");
+    QCommandLineOption noInstancingOption("no-instancing", "Draw every ball with its own draw call, as after the 'I' key.");
+    parser.addOptions({headlessOption, framesOption, sizeOption, formatOption, outputOption, profileOption, noInstancingOption});
+    parser.process(*a);
 
     // Request OpenGL 3.3 Core
     QSurfaceFormat glFormat;
@@ -17,8 +48,35 @@ int main(int argc, char *argv[])
 
     QSurfaceFormat::setDefaultFormat(glFormat);
 
+    if (headless) {
+        HeadlessOptions options;
+        QStringList size = parser.value(sizeOption).split('x');
+        options.numFrames = parser.value(framesOption).toInt();
+        options.width = size.value(0).toInt();
+        options.height = size.value(1).toInt();
+        options.output = parser.value(outputOption);
+        options.profileCsv = parser.value(profileOption);
+        options.instancing = !parser.isSet(noInstancingOption);
+
+        if (options.numFrames < 0 || options.width <= 0 || options.height <= 0) {
+            qDebug() << ":: Invalid number of frames or size";
+            return 1;
+        }
+
+        const QString formatName = parser.value(formatOption);
+        if (formatName == "png") {
+            options.format = HeadlessOptions::PNG;
+        } else if (formatName == "raw") {
+            options.format = HeadlessOptions::RAW;
+        } else {
+            qDebug() << ":: Unknown format" << formatName << "- expected png or raw";
+            return 1;
+        }
+        return runHeadless(options);
+    }
+
     MainWindow w;
     w.show();
 
-    return a.exec();
+    return a->exec();
 }
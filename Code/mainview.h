@@ -1,8 +1,7 @@
 #ifndef MAINVIEW_H
 #define MAINVIEW_H
 
-#include "model.h"
-#include "animation.h"
+#include "scene.h"
 
 #include <QKeyEvent>
 #include <QMouseEvent>
@@ -12,7 +11,6 @@
 #include <QOpenGLShaderProgram>
 #include <QTimer>
 #include <QVector3D>
-#include <memory>
 
 class MainView : public QOpenGLWidget, public QOpenGLFunctions_3_3_Core {
     Q_OBJECT
@@ -20,7 +18,8 @@ class MainView : public QOpenGLWidget, public QOpenGLFunctions_3_3_Core {
     QOpenGLDebugLogger *debugLogger;
     QTimer timer; // timer used for animation
 
-    QOpenGLShaderProgram buzzShaderProgram;
+    // The scene, of which instancing ('I' key) and indexed batches ('B' key) can be toggled
+    BuzzScene scene;
 
 public:
     MainView(QWidget *parent = 0);
@@ -46,24 +45,7 @@ private slots:
     void onMessageLogged( QOpenGLDebugMessage Message );
 
 private:
-    void createShaderPrograms();
-    void createShaderProgram( QOpenGLShaderProgram& program, const QString& name );
-
-    void setupAnimationBatches( );
-
-    void bindLight( QOpenGLShaderProgram& program );
-    void loadTexture( QString file, GLuint texPtr );
-
     bool isLightLocked;
-
-    QMatrix4x4 projectionMat;
-    Transform3f viewTransform;
-
-    float time;
-
-    // The main batch is kept separately, because it has a different 'u_spike' value.
-    std::unique_ptr< AnimatedBatch > mainBatch;
-    std::vector< std::unique_ptr< AnimatedBatch > > batches;
 };
 
 #endif // MAINVIEW_H
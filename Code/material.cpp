@@ -1,4 +1,6 @@
 #include "material.h"
+#include "profiler.h"
+#include "texture_loader.h"
 
 Material::Material( QOpenGLFunctions_3_3_Core *pGl )
     // By OpenGL spec no valid texture can have ID 0 (as it equals GL_FALSE)
@@ -9,6 +11,9 @@ Material::Material( QOpenGLFunctions_3_3_Core *pGl )
     , ks( 0 )
     , kd( 0 )
     , p( 0 )
+    , isLit( true )
+    , uniformBuffer( 0 )
+    , uniformOffset( 0 )
     , pGl( pGl ) {
 
 }
@@ -30,33 +35,85 @@ Material::~Material( ) {
     pGl->glDeleteTextures( numToDelete, textures );
 }
 
-void Material::applyTo( QOpenGLShaderProgram& shaderProgram ) {
-    // Note that not all uniforms actually exist in all shaders
-    // however, for now pretend they do. Let OpenGL figure out
-    // which ones exist, as this performance hit is neglectable
-    // for this application.
+void Material::applyTo( ) {
+    BUZZ_PROFILE_CPU( "material.apply" );
 
-    shaderProgram.setUniformValue( "u_color", color );
-    shaderProgram.setUniformValue( "u_ka", ka );
-    shaderProgram.setUniformValue( "u_ks", ks );
-    shaderProgram.setUniformValue( "u_kd", kd );
-    shaderProgram.setUniformValue( "u_p", p );
+    // The parameters are already in the uniform buffer, so no uniform
+    // needs to be looked up or set here
+    if ( uniformBuffer != 0 ) {
+        pGl->glBindBufferRange( GL_UNIFORM_BUFFER, UB_MATERIAL, uniformBuffer, uniformOffset, sizeof( MaterialBlock ) );
+    }
 
     if ( diffuseTexture != 0 ) {
         pGl->glActiveTexture( GL_TEXTURE0 );
         pGl->glBindTexture( GL_TEXTURE_2D, diffuseTexture );
-        shaderProgram.setUniformValue( "u_diffuseTex", 0 );
     }
 
     if ( normalTexture != 0 ) {
         pGl->glActiveTexture( GL_TEXTURE1 );
         pGl->glBindTexture( GL_TEXTURE_2D, normalTexture );
-        shaderProgram.setUniformValue( "u_normalTex", 1 );
     }
 
     if ( specularTexture != 0 ) {
         pGl->glActiveTexture( GL_TEXTURE2 );
         pGl->glBindTexture( GL_TEXTURE_2D, specularTexture );
-        shaderProgram.setUniformValue( "u_specularTex", 2 );
     }
 }
+
+void Material::loadTexture( const std::shared_ptr< Material >& pMaterial, TextureSlot slot,
+                            const QString& file, TextureLoader& loader ) {
+    QOpenGLFunctions_3_3_Core *pGl = pMaterial->pGl;
+    std::weak_ptr< Material > pWeakMaterial = pMaterial;
+
+    loader.load( file, [pGl, pWeakMaterial, slot]( GLuint texture ) {
+        std::shared_ptr< Material > pMaterial = pWeakMaterial.lock( );
+        if ( !pMaterial ) {
+            pGl->glDeleteTextures( 1, &texture );
+            return;
+        }
+
+        GLuint& target = ( slot == DIFFUSE ) ? pMaterial->diffuseTexture
+                       : ( slot == NORMAL ) ? pMaterial->normalTexture
+                       : pMaterial->specularTexture;
+        if ( target != 0 ) {
+            pGl->glDeleteTextures( 1, &target );
+        }
+        target = texture;
+    } );
+}
+
+MaterialBuffer::MaterialBuffer( QOpenGLFunctions_3_3_Core *pGl )
+    : pGl( pGl ) {
+    pGl->glGenBuffers( 1, &ubo );
+}
+
+MaterialBuffer::~MaterialBuffer( ) {
+    pGl->glDeleteBuffers( 1, &ubo );
+}
+
+void MaterialBuffer::upload( const std::vector< std::shared_ptr< Material > >& materials ) {
+    // Every bound range has to start at a multiple of the alignment
+    GLint alignment;
+    pGl->glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment );
+    const GLintptr stride = ( ( sizeof( MaterialBlock ) + alignment - 1 ) / alignment ) * alignment;
+
+    std::vector< char > data( stride * materials.size( ), 0 );
+    for ( size_t i = 0; i < materials.size( ); i++ ) {
+        Material& material = *materials[ i ];
+        MaterialBlock& block = *reinterpret_cast< MaterialBlock * >( &data[ i * stride ] );
+        block.color[ 0 ] = material.color.x( );
+        block.color[ 1 ] = material.color.y( );
+        block.color[ 2 ] = material.color.z( );
+        block.ka = material.ka;
+        block.ks = material.ks;
+        block.kd = material.kd;
+        block.p = material.p;
+
+        material.uniformBuffer = ubo;
+        material.uniformOffset = i * stride;
+    }
+
+    pGl->glBindBuffer( GL_UNIFORM_BUFFER, ubo );
+    pGl->glBufferData( GL_UNIFORM_BUFFER, data.size( ), data.data( ), GL_STATIC_DRAW );
+    pGl->glBindBuffer( GL_UNIFORM_BUFFER, 0 );
+}
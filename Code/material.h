@@ -3,14 +3,29 @@
 
 #include <QOpenGLFunctions_3_3_Core>
 #include <QOpenGLShaderProgram>
+#include <memory>
+#include <vector>
+#include "uniforms.h"
 
 typedef QVector3D Color3D;
 
+class TextureLoader;
+
 /**
  * @brief The Material struct is a material that can be applied to a shader
  *   prior to rendering a mesh.
+ *
+ * Its parameters are read from the 'Material' uniform block. They are stored in
+ *   a MaterialBuffer, which has to be uploaded again after they are changed.
+ *   The textures are bound to units 0 (diffuse), 1 (normal) and 2 (specular).
  */
 struct Material {
+    enum TextureSlot {
+        DIFFUSE,
+        NORMAL,
+        SPECULAR
+    };
+
     GLuint diffuseTexture;
     GLuint normalTexture;
     GLuint specularTexture;
@@ -22,11 +37,58 @@ struct Material {
     float kd; // Diffuse multiplier
     float p; // Specular exponent (shininess)
 
+    // Unlit materials are drawn in their color, by a shader variant without lighting
+    bool isLit;
+
+    // The range of the uniform buffer with the parameters, set by MaterialBuffer::upload( )
+    GLuint uniformBuffer;
+    GLintptr uniformOffset;
+
     QOpenGLFunctions_3_3_Core *pGl;
 
     Material( QOpenGLFunctions_3_3_Core *pGl );
     ~Material( );
-    void applyTo( QOpenGLShaderProgram& shaderProgram );
+
+    /**
+     * @brief applyTo Binds the parameters and textures of the material for the next draw
+     */
+    void applyTo( );
+
+    /**
+     * @brief loadTexture Loads an image, or a block compressed KTX file made by the
+     *   texture_compressor tool, into a texture slot of the material. The texture is set
+     *   once it is uploaded, which happens at the start of one of the next frames, so the
+     *   material is drawn without it until then. It is discarded if the material no
+     *   longer exists by that time.
+     * @param pMaterial The material to set the texture of
+     * @param slot The slot to set, of which any previous texture is deleted
+     * @param file The path of the file
+     * @param loader The loader to load the file with
+     */
+    static void loadTexture( const std::shared_ptr< Material >& pMaterial, TextureSlot slot,
+                             const QString& file, TextureLoader& loader );
+};
+
+/**
+ * @brief The MaterialBuffer class is a uniform buffer that holds the parameters of
+ *   multiple materials, such that a material is bound by binding its range of the buffer.
+ *
+ * Note that this class can only be used after OpenGL is initialised
+ */
+class MaterialBuffer {
+public:
+    MaterialBuffer( QOpenGLFunctions_3_3_Core *pGl );
+    ~MaterialBuffer( );
+
+    /**
+     * @brief upload Replaces the contents of the buffer with the parameters of the
+     *   given materials, and assigns every material its range within it
+     * @param materials The materials to store
+     */
+    void upload( const std::vector< std::shared_ptr< Material > >& materials );
+private:
+    QOpenGLFunctions_3_3_Core *pGl;
+    GLuint ubo;
 };
 
 #endif // MATERIAL_H
@@ -0,0 +1,163 @@
+#include "mesh_arena.h"
+
+#include <QDebug>
+#include <algorithm>
+
+// Documentation can be found in the mesh_arena.h file
+
+// The capacities of the first buffers, in vertices and bytes
+static const GLsizeiptr MIN_VERTEX_CAPACITY = 4096;
+static const GLsizeiptr MIN_INDEX_CAPACITY = 16384;
+
+static GLsizeiptr alignIndexBytes( GLsizeiptr size ) {
+    return ( size + 3 ) & ~GLsizeiptr( 3 );
+}
+
+MeshArena::MeshArena( QOpenGLFunctions_3_3_Core *pGl, GLsizei vertexSize, LayoutFunction setupLayout )
+    : pGl( pGl ),
+      vertexBytes( vertexSize ),
+      setupLayout( setupLayout ),
+      vertexBuffer( 0 ),
+      indexBuffer( 0 ) {
+    pGl->glGenVertexArrays( 1, &vao );
+}
+
+MeshArena::~MeshArena( ) {
+    if ( numMeshes( ) > 0 ) {
+        qDebug( ) << ":: Mesh arena destructed while" << numMeshes( ) << "meshes are still allocated";
+    }
+    const GLuint buffers[ 2 ] = { vertexBuffer, indexBuffer };
+    pGl->glDeleteBuffers( 2, buffers );
+    pGl->glDeleteVertexArrays( 1, &vao );
+}
+
+MeshArena::Handle MeshArena::allocate( const void *pVertices, int numVertices, const void *pIndices, GLsizeiptr indexBytes ) {
+    Entry entry;
+    entry.numVertices = numVertices;
+    entry.indexBytes = alignIndexBytes( indexBytes );
+
+    GLintptr firstVertex = vertexRanges.allocate( entry.numVertices );
+    GLintptr indexOffset = indexRanges.allocate( entry.indexBytes );
+    if ( firstVertex < 0 || indexOffset < 0 ) {
+        // Whatever did fit is released again, as all ranges move upon relocation
+        if ( firstVertex >= 0 ) {
+            vertexRanges.free( firstVertex, entry.numVertices );
+        }
+        if ( indexOffset >= 0 ) {
+            indexRanges.free( indexOffset, entry.indexBytes );
+        }
+
+        GLsizeiptr usedVertices = 0;
+        GLsizeiptr usedIndexBytes = 0;
+        for ( size_t i = 0; i < entries.size( ); i++ ) {
+            usedVertices += entries[ i ].numVertices;
+            usedIndexBytes += entries[ i ].indexBytes;
+        }
+        GLsizeiptr vertexCapacity = std::max( vertexRanges.capacity, MIN_VERTEX_CAPACITY );
+        while ( vertexCapacity < usedVertices + entry.numVertices ) {
+            vertexCapacity *= 2;
+        }
+        GLsizeiptr indexCapacity = std::max( indexRanges.capacity, MIN_INDEX_CAPACITY );
+        while ( indexCapacity < usedIndexBytes + entry.indexBytes ) {
+            indexCapacity *= 2;
+        }
+        relocate( vertexCapacity, indexCapacity );
+
+        firstVertex = vertexRanges.allocate( entry.numVertices );
+        indexOffset = indexRanges.allocate( entry.indexBytes );
+    }
+    entry.mesh.baseVertex = GLint( firstVertex );
+    entry.mesh.indexOffset = indexOffset;
+
+    pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, vertexBuffer );
+    pGl->glBufferSubData( GL_COPY_WRITE_BUFFER, firstVertex * vertexBytes, GLsizeiptr( numVertices ) * vertexBytes, pVertices );
+    pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, indexBuffer );
+    pGl->glBufferSubData( GL_COPY_WRITE_BUFFER, indexOffset, indexBytes, pIndices );
+    pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+    Handle handle;
+    if ( !freeHandles.empty( ) ) {
+        handle = freeHandles.back( );
+        freeHandles.pop_back( );
+        entries[ handle ] = entry;
+    } else {
+        handle = Handle( entries.size( ) );
+        entries.push_back( entry );
+    }
+    return handle;
+}
+
+void MeshArena::free( Handle handle ) {
+    Entry& entry = entries[ handle ];
+    vertexRanges.free( entry.mesh.baseVertex, entry.numVertices );
+    indexRanges.free( entry.mesh.indexOffset, entry.indexBytes );
+
+    // Such that relocation skips it
+    entry.numVertices = 0;
+    entry.indexBytes = 0;
+    freeHandles.push_back( handle );
+}
+
+void MeshArena::compact( ) {
+    if ( vertexBuffer != 0 ) {
+        relocate( vertexRanges.capacity, indexRanges.capacity );
+    }
+}
+
+void MeshArena::relocate( GLsizeiptr vertexCapacity, GLsizeiptr indexCapacity ) {
+    GLuint buffers[ 2 ];
+    pGl->glGenBuffers( 2, buffers );
+    pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, buffers[ 0 ] );
+    pGl->glBufferData( GL_COPY_WRITE_BUFFER, vertexCapacity * vertexBytes, nullptr, GL_STATIC_DRAW );
+    pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, buffers[ 1 ] );
+    pGl->glBufferData( GL_COPY_WRITE_BUFFER, indexCapacity, nullptr, GL_STATIC_DRAW );
+
+    // The meshes are copied back to back in the order of their handles, which keeps
+    // the meshes allocated together (such as levels of detail) close together
+    GLsizeiptr usedVertices = 0;
+    GLsizeiptr usedIndexBytes = 0;
+    for ( Entry& entry : entries ) {
+        if ( entry.numVertices == 0 && entry.indexBytes == 0 ) {
+            continue;
+        }
+        pGl->glBindBuffer( GL_COPY_READ_BUFFER, vertexBuffer );
+        pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, buffers[ 0 ] );
+        pGl->glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, entry.mesh.baseVertex * vertexBytes,
+                                  usedVertices * vertexBytes, entry.numVertices * vertexBytes );
+        pGl->glBindBuffer( GL_COPY_READ_BUFFER, indexBuffer );
+        pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, buffers[ 1 ] );
+        pGl->glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, entry.mesh.indexOffset,
+                                  usedIndexBytes, entry.indexBytes );
+
+        entry.mesh.baseVertex = GLint( usedVertices );
+        entry.mesh.indexOffset = usedIndexBytes;
+        usedVertices += entry.numVertices;
+        usedIndexBytes += entry.indexBytes;
+    }
+    pGl->glBindBuffer( GL_COPY_READ_BUFFER, 0 );
+    pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+    // Deleting a buffer with 0 is silently ignored
+    const GLuint oldBuffers[ 2 ] = { vertexBuffer, indexBuffer };
+    pGl->glDeleteBuffers( 2, oldBuffers );
+    vertexBuffer = buffers[ 0 ];
+    indexBuffer = buffers[ 1 ];
+    vertexRanges.reset( usedVertices, vertexCapacity );
+    indexRanges.reset( usedIndexBytes, indexCapacity );
+
+    // The attributes refer to the buffer that was bound when they were described. The
+    // instance attributes attached by others are set again before every instanced draw.
+    pGl->glBindVertexArray( vao );
+    pGl->glBindBuffer( GL_ARRAY_BUFFER, vertexBuffer );
+    setupLayout( pGl );
+    pGl->glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer );
+    pGl->glBindVertexArray( 0 );
+    pGl->glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+    qDebug( ) << ":: Mesh arena holds" << numMeshes( ) << "meshes in" << vertexCapacity << "vertices and"
+              << indexCapacity << "index bytes";
+}
+
+void MeshArena::bind( ) {
+    pGl->glBindVertexArray( vao );
+}
@@ -0,0 +1,119 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include "range_allocator.h"
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <vector>
+
+/**
+ * @brief The MeshArena class stores the vertices and indices of many meshes of the same
+ *   vertex format in a single vertex buffer and a single index buffer, which are described
+ *   by a single VAO. All meshes are therefore drawn with the same bound VAO, where a mesh is
+ *   selected by its index offset and base vertex (see glDrawElementsBaseVertex).
+ *
+ * The ranges of the meshes are sub-allocated first-fit by a RangeAllocator, in which freed
+ *   ranges are merged with their free neighbours. Once a mesh no longer fits, the buffers
+ *   are replaced by larger ones, into which the meshes are copied back to back on the GPU.
+ *   This also removes the holes left by freed meshes, which compact( ) does on demand.
+ *   As meshes may thus move, their current range is looked up through their handle.
+ *
+ * Note that this class can only be used after OpenGL is initialised
+ */
+class MeshArena {
+public:
+    /**
+     * @brief LayoutFunction Describes the vertex attributes of the format, for the bound
+     *   VAO and vertex buffer
+     */
+    typedef void ( *LayoutFunction )( QOpenGLFunctions_3_3_Core *pGl );
+
+    typedef int Handle;
+
+    /**
+     * @brief The Mesh struct is where a mesh currently resides within the buffers
+     */
+    struct Mesh {
+        // Added to every index of the mesh
+        GLint baseVertex;
+        // In bytes, a multiple of 4 such that any index type is aligned
+        GLintptr indexOffset;
+    };
+
+    /**
+     * @brief MeshArena Creates the VAO of the format. The buffers are created once the
+     *   first mesh is allocated.
+     * @param pGl The functions of the context
+     * @param vertexSize The number of bytes of a vertex
+     * @param setupLayout Describes the attributes of a vertex
+     */
+    MeshArena( QOpenGLFunctions_3_3_Core *pGl, GLsizei vertexSize, LayoutFunction setupLayout );
+    ~MeshArena( );
+
+    /**
+     * @brief allocate Uploads a mesh into the arena
+     * @param pVertices The vertices, of the size given upon construction
+     * @param numVertices The number of vertices
+     * @param pIndices The indices, relative to the first vertex of the mesh
+     * @param indexBytes The size of the indices, in bytes
+     * @return The handle by which the mesh is drawn, and freed
+     */
+    Handle allocate( const void *pVertices, int numVertices, const void *pIndices, GLsizeiptr indexBytes );
+
+    /**
+     * @brief free Releases the ranges of the mesh, after which its handle is invalid
+     */
+    void free( Handle handle );
+
+    /**
+     * @brief compact Moves all meshes to the start of the buffers, removing the holes
+     *   between them
+     */
+    void compact( );
+
+    /**
+     * @brief bind Binds the VAO, which holds the buffers and layout of all meshes
+     */
+    void bind( );
+
+    const Mesh& mesh( Handle handle ) const { return entries[ handle ].mesh; }
+
+    GLuint vertexArray( ) const { return vao; }
+    GLsizei vertexSize( ) const { return vertexBytes; }
+    QOpenGLFunctions_3_3_Core *functions( ) const { return pGl; }
+
+    /**
+     * @brief numMeshes The number of meshes currently allocated
+     */
+    int numMeshes( ) const { return int( entries.size( ) - freeHandles.size( ) ); }
+
+private:
+    struct Entry {
+        Mesh mesh;
+        // In vertices
+        GLsizeiptr numVertices;
+        // In bytes, rounded up to a multiple of 4
+        GLsizeiptr indexBytes;
+    };
+
+    // Replaces the buffers with ones of the given capacities, and packs the meshes into them
+    void relocate( GLsizeiptr vertexCapacity, GLsizeiptr indexCapacity );
+
+    QOpenGLFunctions_3_3_Core *pGl;
+    GLsizei vertexBytes;
+    LayoutFunction setupLayout;
+
+    GLuint vao;
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+
+    // In vertices and bytes respectively
+    RangeAllocator vertexRanges;
+    RangeAllocator indexRanges;
+
+    // By handle. The handles of freed meshes are reused.
+    std::vector< Entry > entries;
+    std::vector< Handle > freeHandles;
+};
+
+#endif // MESH_ARENA_H
@@ -1,73 +1,122 @@
 #include "model.h"
+#include "objparser.h"
+#include "parallel.h"
 
+#include <QByteArray>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
-#include <QTextStream>
-
-// A Private Vertex class for vertex comparison
+#include <QHash>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// Key used for welding vertices in Model::alignData(). Every component of
+// the (position, normal, texcoord) triple is either the bit pattern of the
+// float (exact welding), or the index of the epsilon-sized cell it falls in
+// (quantized welding).
 // DO NOT include "vertex.h" or something similar in this file
-struct Vertex {
-    QVector3D coord;
-    QVector3D normal;
-    QVector2D texCoord;
-
-    Vertex() : coord(), normal(), texCoord(){}
-    Vertex(QVector3D coords, QVector3D normal, QVector3D texc): coord(coords), normal(normal), texCoord(texc){}
-
-    bool operator==(const Vertex &other) const {
-        if (other.coord != coord)
-                return false;
-        if (other.normal != normal)
-            return false;
-        if (other.texCoord != texCoord)
-            return false;
-        return true;
+struct WeldKey {
+    qint64 c[8];
+
+    bool operator==(const WeldKey &other) const {
+        return std::equal(c, c + 8, other.c);
     }
 };
 
-Model::Model(QString filename) {
+inline uint qHash(const WeldKey &key, uint seed = 0) {
+    return qHashBits(key.c, sizeof(key.c), seed);
+}
+
+static qint64 weldComponent(float f, float epsilon) {
+    if (epsilon > 0) {
+        return static_cast<qint64>(std::floor(f / epsilon + 0.5f));
+    }
+    // Adding 0 folds -0 into +0, as these compare equal as floats
+    float folded = f + 0.0f;
+    quint32 bits;
+    std::memcpy(&bits, &folded, sizeof(bits));
+    return bits;
+}
+
+static WeldKey weldKey(QVector3D v, QVector3D n, QVector2D t, float epsilon) {
+    WeldKey k;
+    k.c[0] = weldComponent(v.x(), epsilon);
+    k.c[1] = weldComponent(v.y(), epsilon);
+    k.c[2] = weldComponent(v.z(), epsilon);
+    k.c[3] = weldComponent(n.x(), epsilon);
+    k.c[4] = weldComponent(n.y(), epsilon);
+    k.c[5] = weldComponent(n.z(), epsilon);
+    k.c[6] = weldComponent(t.x(), epsilon);
+    k.c[7] = weldComponent(t.y(), epsilon);
+    return k;
+}
+
+Model::Model(QString filename, float weldEpsilon, int numThreads) {
+    this->weldEpsilon = weldEpsilon;
+    loaderThreads = numThreads > 0 ? numThreads : std::max(1, QThread::idealThreadCount());
     hNorms = false;
     hTexs = false;
 
     qDebug() << ":: Loading model:" << filename;
     QFile file(filename);
     if(file.open(QIODevice::ReadOnly)) {
-        QTextStream in(&file);
-
-        QString line;
-        QStringList tokens;
-
-        while(!in.atEnd()) {
-            line = in.readLine();
-            if (line.startsWith("#")) continue; // skip comments
-
-            tokens = line.split(" ", QString::SkipEmptyParts);
-
-            // Switch depending on first element
-            if (tokens[0] == "v") {
-                parseVertex(tokens);
-            }
+        // Map the file into memory, such that it can be tokenized in place.
+        // Compressed resources cannot be mapped, so then read it in one go.
+        qint64 size = file.size();
+        QByteArray contents;
+        const char *data = reinterpret_cast<const char*>(file.map(0, size));
+        if (!data) {
+            contents = file.readAll();
+            data = contents.constData();
+            size = contents.size();
+        }
 
-            if (tokens[0] == "vn" ) {
-                parseNormal(tokens);
-            }
+        // The mesh cache contains the aligned data of an earlier parse of
+        // the exact same contents
+        qint64 modified = sourceModified(file);
+        QByteArray sourceHash;
+        QString cacheFile = cachePath(filename);
+        if (readCache(cacheFile, data, size, modified, sourceHash)) {
+            qDebug() << ":: Loaded model from mesh cache:" << cacheFile;
+            return;
+        }
+        if (sourceHash.isEmpty()) {
+            sourceHash = hashSource(data, size);
+        }
 
-            if (tokens[0] == "vt" ) {
-                parseTexture(tokens);
-            }
+        QElapsedTimer loadTimer;
+        loadTimer.start();
 
-            if (tokens[0] == "f" ) {
-                parseFace(tokens);
-            }
-        }
+        ObjChunk chunk;
+        parseObjParallel(data, data + size, chunk, loaderThreads);
+        qint64 parseTime = loadTimer.restart();
 
+        // Also unmaps the file
         file.close();
 
+        vertices_indexed = chunk.positions;
+        norm = chunk.normals;
+        tex = chunk.texCoords;
+        indices = chunk.indices;
+        normal_indices = chunk.normalIndices;
+        texcoord_indices = chunk.texCoordIndices;
+        hNorms = !norm.isEmpty();
+        hTexs = !tex.isEmpty();
+
         // create an array version of the data
         unpackIndexes();
 
         // Allign all vertex indices with the right normal/texturecoord indices
         alignData();
+
+        qDebug() << ":: Parsed in" << parseTime << "ms, aligned in" << loadTimer.elapsed()
+                 << "ms with" << loaderThreads << "threads";
+
+        writeCache(cacheFile, sourceHash, size, modified);
     }
 }
 
@@ -234,98 +283,134 @@ int Model::getNumTriangles() {
     return vertices.size()/3;
 }
 
-void Model::parseVertex(QStringList tokens) {
-    float x,y,z;
-    x = tokens[1].toFloat();
-    y = tokens[2].toFloat();
-    z = tokens[3].toFloat();
-    vertices_indexed.append(QVector3D(x,y,z));
-}
-
-void Model::parseNormal(QStringList tokens) {
-    hNorms = true;
-    float x,y,z;
-    x = tokens[1].toFloat();
-    y = tokens[2].toFloat();
-    z = tokens[3].toFloat();
-    norm.append(QVector3D(x,y,z));
-}
-
-void Model::parseTexture(QStringList tokens) {
-    hTexs = true;
-    float u,v;
-    u = tokens[1].toFloat();
-    v = tokens[2].toFloat();
-    tex.append(QVector2D(u,v));
-}
-
-void Model::parseFace(QStringList tokens) {
-    QStringList elements;
-
-    for( int i = 1; i != tokens.size(); ++i ) {
-        elements = tokens[i].split("/");
-        // -1 since .obj count from 1
-        indices.append(elements[0].toInt()-1);
-
-        if ( elements.size() > 1 && ! elements[1].isEmpty() ) {
-            texcoord_indices.append(elements[1].toInt()-1);
-        }
-
-        if (elements.size() > 2 && ! elements[2].isEmpty() ) {
-            normal_indices.append(elements[2].toInt()-1);
-        }
-    }
-}
-
-
 /**
  * @brief Model::alignData
  *
  * Make sure that the indices from the vertices align with those
  * of the normals and the texture coordinates, create extra vertices
  * if vertex has multiple normals or texturecoords
+ *
+ * Identical vertices are welded through a hash map, so this runs in
+ * linear time. When weldEpsilon is positive, vertices whose components
+ * fall in the same epsilon-sized cell are welded as well. Large models
+ * are welded on loaderThreads threads.
  */
 void Model::alignData() {
+    const int numCorners = indices.size();
+
+    // Only const access is used below, as the vectors may be shared with
+    // other vectors and must not detach from within the threads
+    const QVector3D *positionData = vertices_indexed.constData();
+    const QVector3D *normalData = norm.constData();
+    const QVector2D *texCoordData = tex.constData();
+    const unsigned *indexData = indices.constData();
+    const unsigned *normalIndexData = normal_indices.constData();
+    const unsigned *texCoordIndexData = texcoord_indices.constData();
+
+    auto cornerAttributes = [&](int i, QVector3D &v, QVector3D &n, QVector2D &t) {
+        v = positionData[indexData[i]];
+        n = hNorms ? normalData[normalIndexData[i]] : QVector3D(0,0,0);
+        t = hTexs ? texCoordData[texCoordIndexData[i]] : QVector2D(0,0);
+    };
+
+    // The corners are split into consecutive ranges, which are welded
+    // independently on separate threads. Small models are not worth the
+    // thread startup.
+    struct WeldRange {
+        int begin;
+        int end;
+        // The first corner of every vertex unique within the range, in order of appearance
+        QVector<int> firstCorners;
+        // Maps the vertex index within the range to the final vertex index
+        QVector<unsigned> remap;
+    };
+    const int numRanges = std::max(1, std::min(loaderThreads, numCorners / 65536));
+    std::vector<WeldRange> ranges(numRanges);
+    for (int r = 0; r != numRanges; ++r) {
+        ranges[r].begin = int(qint64(numCorners) * r / numRanges);
+        ranges[r].end = int(qint64(numCorners) * (r + 1) / numRanges);
+    }
+
+    QVector<unsigned> ind(numCorners);
+    unsigned *indData = ind.data();
+
+    parallelRun(numRanges, [&](int r) {
+        WeldRange &range = ranges[r];
+        QHash<WeldKey, unsigned> welded;
+        welded.reserve((range.end - range.begin) / 2);
+
+        for (int i = range.begin; i != range.end; ++i) {
+            QVector3D v, n;
+            QVector2D t;
+            cornerAttributes(i, v, n, t);
+
+            WeldKey k = weldKey(v, n, t, weldEpsilon);
+            QHash<WeldKey, unsigned>::const_iterator it = welded.constFind(k);
+            if (it != welded.constEnd()) {
+                // Vertex already exists, use that index
+                indData[i] = it.value();
+            } else {
+                // Create a new vertex
+                unsigned localIndex = range.firstCorners.size();
+                welded.insert(k, localIndex);
+                range.firstCorners.append(i);
+                indData[i] = localIndex;
+            }
+        }
+    });
+
+    // Merge the ranges in order. A vertex gets its final index from its first
+    // appearance, so the result is identical to welding all corners at once.
     QVector<QVector3D> verts = QVector<QVector3D>();
     verts.reserve(vertices_indexed.size());
     QVector<QVector3D> norms = QVector<QVector3D>();
     norms.reserve(vertices_indexed.size());
     QVector<QVector2D> texcs = QVector<QVector2D>();
     texcs.reserve(vertices_indexed.size());
-    QVector<Vertex> vs = QVector<Vertex>();
-
-    QVector<unsigned> ind = QVector<unsigned>();
-    ind.reserve(indices.size());
+    QHash<WeldKey, unsigned> welded;
 
     unsigned currentIndex = 0;
 
-    for (int i = 0; i != indices.size(); ++i) {
-        QVector3D v = vertices_indexed[indices[i]];
-
-        QVector3D n = QVector2D(0,0);
-        if ( hNorms ) {
-            n = norm[normal_indices[i]];
-        }
-
-        QVector2D t = QVector2D(0,0);
-        if ( hTexs ) {
-            t = tex[texcoord_indices[i]];
-        }
+    for (WeldRange &range : ranges) {
+        range.remap.resize(range.firstCorners.size());
+
+        for (int j = 0; j != range.firstCorners.size(); ++j) {
+            QVector3D v, n;
+            QVector2D t;
+            cornerAttributes(range.firstCorners[j], v, n, t);
+
+            // With a single range all vertices are unique already
+            if (numRanges > 1) {
+                WeldKey k = weldKey(v, n, t, weldEpsilon);
+                QHash<WeldKey, unsigned>::const_iterator it = welded.constFind(k);
+                if (it != welded.constEnd()) {
+                    range.remap[j] = it.value();
+                    continue;
+                }
+                welded.insert(k, currentIndex);
+            }
 
-        Vertex k = Vertex(v,n,t);
-        if (vs.contains(k)) {
-            // Vertex already exists, use that index
-            ind.append(vs.indexOf(k));
-        } else {
-            // Create a new vertex
             verts.append(v);
             norms.append(n);
             texcs.append(t);
-            vs.append(k);
-            ind.append(currentIndex);
+            range.remap[j] = currentIndex;
             ++currentIndex;
         }
     }
+
+    if (numRanges > 1) {
+        parallelRun(numRanges, [&](int r) {
+            const WeldRange &range = ranges[r];
+            const unsigned *remap = range.remap.constData();
+            for (int i = range.begin; i != range.end; ++i) {
+                indData[i] = remap[indData[i]];
+            }
+        });
+    }
+
+    qDebug() << ":: Welded" << numCorners << "corners into" << currentIndex
+             << "vertices," << (unsigned(numCorners) - currentIndex) << "merged";
+
     // Remove old data
     vertices_indexed.clear();
     normals_indexed.clear();
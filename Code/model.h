@@ -1,8 +1,9 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <QByteArray>
+#include <QFile>
 #include <QString>
-#include <QStringList>
 #include <QVector>
 #include <QVector2D>
 #include <QVector3D>
@@ -13,13 +14,25 @@
  * Loads all data from a Wavefront .obj file
  * IMPORTANT! Current only supports TRIANGLE meshes!
  *
+ * The parsed data is stored in a binary mesh cache, from which later
+ * loads of the same file contents are served without parsing.
+ *
  * Support for other meshes can be implemented by students
  *
  */
 class Model
 {
 public:
-    Model(QString filename);
+    /**
+     * @brief Model Loads the given .obj file
+     * @param filename The file to load
+     * @param weldEpsilon Vertices whose position, normal and texture
+     *   coordinate components fall in the same grid cell of this size are
+     *   merged into one. For 0 only exactly identical vertices are merged.
+     * @param numThreads The number of threads used for parsing and welding,
+     *   or 0 for one per core. The result does not depend on it.
+     */
+    Model(QString filename, float weldEpsilon = 0, int numThreads = 0);
 
     // Used for glDrawArrays()
     QVector<QVector3D>& getVertices();
@@ -48,16 +61,19 @@ public:
 
 private:
 
-    // OBJ parsing
-    void parseVertex(QStringList tokens);
-    void parseNormal(QStringList tokens);
-    void parseTexture(QStringList tokens);
-    void parseFace(QStringList tokens);
-
     // Alignment of data
     void alignData();
     void unpackIndexes();
 
+    // Binary mesh cache (see model_cache.cpp)
+    static QByteArray hashSource(const char *data, qint64 size);
+    static qint64 sourceModified(const QFile &source);
+    static QString cachePath(const QString &filename);
+    bool readCache(const QString &path, const char *source, qint64 sourceSize, qint64 modified,
+                   QByteArray &sourceHash);
+    void writeCache(const QString &path, const QByteArray &sourceHash, qint64 sourceSize,
+                    qint64 modified) const;
+
     // Intermediate storage of values
     QVector<QVector3D> vertices_indexed;
     QVector<QVector3D> normals_indexed;
@@ -76,6 +92,9 @@ private:
 
     bool hNorms;
     bool hTexs;
+
+    float weldEpsilon;
+    int loaderThreads;
 };
 
 #endif // MODEL_H
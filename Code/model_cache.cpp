@@ -0,0 +1,235 @@
+#include "model.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstring>
+
+// Binary mesh cache of a parsed Model
+//
+// Layout (native endianness, as the cache never leaves the machine):
+//   MeshCacheHeader
+//   float positions[ numVertices ][ 3 ]
+//   float normals[ numVertices ][ 3 ]
+//   float texCoords[ numVertices ][ 2 ]
+//   quint32 indices[ numIndices ]
+//
+// The cache is only valid for the exact source contents it was created
+// from, which is checked through the SHA-1 digest and size of the source.
+// As hashing means reading the whole source, the digest is only computed
+// when the size or modification time of the source differ from the ones
+// stored in the cache.
+
+static const char MESH_CACHE_MAGIC[4] = { 'B', 'Z', 'M', 'C' };
+static const quint32 MESH_CACHE_VERSION = 3;
+
+// The length of a SHA-1 digest
+static const int SOURCE_HASH_SIZE = 20;
+
+static const quint32 MESH_CACHE_HAS_NORMALS = 1;
+static const quint32 MESH_CACHE_HAS_TEXCOORDS = 2;
+
+struct MeshCacheHeader {
+    char magic[4];
+    quint32 version;
+    qint64 sourceSize;
+    qint64 sourceModified; // In ms since the epoch, or 0 if unknown
+    char sourceHash[ SOURCE_HASH_SIZE ];
+    float weldEpsilon;
+    quint32 flags;
+    quint32 numVertices;
+    quint32 numIndices;
+};
+
+static qint64 meshCacheSize( quint32 numVertices, quint32 numIndices ) {
+    return sizeof( MeshCacheHeader )
+         + qint64( numVertices ) * ( 2 * sizeof( QVector3D ) + sizeof( QVector2D ) )
+         + qint64( numIndices ) * sizeof( quint32 );
+}
+
+// The cache is written by copying the vectors directly
+static_assert( sizeof( QVector3D ) == 3 * sizeof( float ), "QVector3D must be tightly packed" );
+static_assert( sizeof( QVector2D ) == 2 * sizeof( float ), "QVector2D must be tightly packed" );
+static_assert( sizeof( unsigned ) == sizeof( quint32 ), "Indices must be 32-bit" );
+
+/**
+ * @brief Model::hashSource Computes the SHA-1 digest of the given data, followed by its size
+ */
+QByteArray Model::hashSource( const char *data, qint64 size ) {
+    // addData( ) takes an int length, so sources of 2 GB or more are hashed in chunks
+    const qint64 CHUNK_SIZE = qint64( 1 ) << 30;
+
+    QCryptographicHash hash( QCryptographicHash::Sha1 );
+    for ( qint64 offset = 0; offset < size; offset += CHUNK_SIZE ) {
+        hash.addData( data + offset, int( std::min( CHUNK_SIZE, size - offset ) ) );
+    }
+    hash.addData( reinterpret_cast< const char * >( &size ), sizeof( size ) );
+    return hash.result( );
+}
+
+/**
+ * @brief Model::cachePath Returns the location of the mesh cache for the given file.
+ *   The hash of the full path avoids clashes between equally named files.
+ */
+QString Model::cachePath( const QString& filename ) {
+    QByteArray path = QFileInfo( filename ).absoluteFilePath( ).toUtf8( );
+    QByteArray pathHash = hashSource( path.constData( ), path.size( ) ).toHex( ).left( 16 );
+
+    return QStandardPaths::writableLocation( QStandardPaths::CacheLocation )
+         + "/meshes/" + QFileInfo( filename ).completeBaseName( )
+         + "-" + QString::fromLatin1( pathHash ) + ".bzmesh";
+}
+
+/**
+ * @brief Model::sourceModified Returns the modification time of the given file in ms
+ *   since the epoch, or 0 if it is not known
+ */
+qint64 Model::sourceModified( const QFile& source ) {
+    QDateTime modified = QFileInfo( source ).lastModified( );
+    return modified.isValid( ) ? modified.toMSecsSinceEpoch( ) : 0;
+}
+
+/**
+ * @brief Model::readCache Loads the aligned data from the mesh cache, if it
+ *   is valid for the given source contents. The source is only hashed if its size
+ *   or modification time differ from the ones in the cache, in which case the
+ *   digest is returned through sourceHash.
+ *
+ * @return True if the model was loaded from the cache
+ */
+bool Model::readCache( const QString& path, const char *source, qint64 sourceSize, qint64 modified,
+                       QByteArray& sourceHash ) {
+    QFile file( path );
+    if ( !file.open( QIODevice::ReadOnly ) || file.size( ) < qint64( sizeof( MeshCacheHeader ) ) ) {
+        return false;
+    }
+
+    const uchar *data = file.map( 0, file.size( ) );
+    if ( !data ) {
+        return false;
+    }
+
+    MeshCacheHeader header;
+    std::memcpy( &header, data, sizeof( header ) );
+
+    if ( std::memcmp( header.magic, MESH_CACHE_MAGIC, sizeof( header.magic ) ) != 0
+            || header.version != MESH_CACHE_VERSION
+            || header.sourceSize != sourceSize
+            || std::memcmp( &header.weldEpsilon, &weldEpsilon, sizeof( float ) ) != 0
+            || file.size( ) != meshCacheSize( header.numVertices, header.numIndices ) ) {
+        qDebug( ) << ":: Mesh cache is outdated:" << path;
+        return false;
+    }
+
+    // A source that was touched, copied or checked out again may still have the same contents
+    const bool touched = modified == 0 || header.sourceModified != modified;
+    if ( touched ) {
+        sourceHash = hashSource( source, sourceSize );
+        if ( std::memcmp( header.sourceHash, sourceHash.constData( ), SOURCE_HASH_SIZE ) != 0 ) {
+            qDebug( ) << ":: Mesh cache is outdated:" << path;
+            return false;
+        }
+    }
+
+    const uchar *p = data + sizeof( header );
+    vertices_indexed.resize( header.numVertices );
+    std::memcpy( vertices_indexed.data( ), p, header.numVertices * sizeof( QVector3D ) );
+    p += header.numVertices * sizeof( QVector3D );
+
+    normals_indexed.resize( header.numVertices );
+    std::memcpy( normals_indexed.data( ), p, header.numVertices * sizeof( QVector3D ) );
+    p += header.numVertices * sizeof( QVector3D );
+
+    textureCoords_indexed.resize( header.numVertices );
+    std::memcpy( textureCoords_indexed.data( ), p, header.numVertices * sizeof( QVector2D ) );
+    p += header.numVertices * sizeof( QVector2D );
+
+    indices.resize( header.numIndices );
+    std::memcpy( indices.data( ), p, header.numIndices * sizeof( quint32 ) );
+
+    // A damaged cache may still have the right size
+    for ( unsigned index : indices ) {
+        if ( index >= header.numVertices ) {
+            qDebug( ) << ":: Mesh cache is corrupt:" << path;
+            vertices_indexed.clear( );
+            normals_indexed.clear( );
+            textureCoords_indexed.clear( );
+            indices.clear( );
+            return false;
+        }
+    }
+
+    hNorms = ( header.flags & MESH_CACHE_HAS_NORMALS ) != 0;
+    hTexs = ( header.flags & MESH_CACHE_HAS_TEXCOORDS ) != 0;
+
+    // Stores the new modification time, such that the next load need not hash again
+    if ( touched && modified != 0 ) {
+        file.unmap( const_cast< uchar * >( data ) );
+        file.close( );
+        header.sourceModified = modified;
+        if ( file.open( QIODevice::ReadWrite ) ) {
+            file.write( reinterpret_cast< const char * >( &header ), sizeof( header ) );
+        }
+    }
+
+    // The unindexed arrays follow directly from the aligned data. (Note that
+    // they contain the welded values, which differ only with a weldEpsilon)
+    vertices.resize( indices.size( ) );
+    normals.resize( hNorms ? indices.size( ) : 0 );
+    textureCoords.resize( hTexs ? indices.size( ) : 0 );
+    for ( int i = 0; i != indices.size( ); ++i ) {
+        vertices[ i ] = vertices_indexed[ indices[ i ] ];
+        if ( hNorms ) {
+            normals[ i ] = normals_indexed[ indices[ i ] ];
+        }
+        if ( hTexs ) {
+            textureCoords[ i ] = textureCoords_indexed[ indices[ i ] ];
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Model::writeCache Writes the aligned data to the mesh cache, such that
+ *   subsequent loads of the same source contents can skip parsing.
+ */
+void Model::writeCache( const QString& path, const QByteArray& sourceHash, qint64 sourceSize,
+                        qint64 modified ) const {
+    // Also clears the padding, which is written as well
+    MeshCacheHeader header;
+    std::memset( &header, 0, sizeof( header ) );
+    std::memcpy( header.magic, MESH_CACHE_MAGIC, sizeof( header.magic ) );
+    header.version = MESH_CACHE_VERSION;
+    header.sourceSize = sourceSize;
+    header.sourceModified = modified;
+    std::memcpy( header.sourceHash, sourceHash.constData( ), SOURCE_HASH_SIZE );
+    header.weldEpsilon = weldEpsilon;
+    header.flags = ( hNorms ? MESH_CACHE_HAS_NORMALS : 0 ) | ( hTexs ? MESH_CACHE_HAS_TEXCOORDS : 0 );
+    header.numVertices = vertices_indexed.size( );
+    header.numIndices = indices.size( );
+
+    QDir( ).mkpath( QFileInfo( path ).absolutePath( ) );
+
+    // Only replaces an existing cache once it is completely written
+    QSaveFile file( path );
+    if ( !file.open( QIODevice::WriteOnly ) ) {
+        qDebug( ) << ":: Failed to write mesh cache:" << path;
+        return;
+    }
+    file.write( reinterpret_cast< const char * >( &header ), sizeof( header ) );
+    file.write( reinterpret_cast< const char * >( vertices_indexed.constData( ) ), header.numVertices * sizeof( QVector3D ) );
+    file.write( reinterpret_cast< const char * >( normals_indexed.constData( ) ), header.numVertices * sizeof( QVector3D ) );
+    file.write( reinterpret_cast< const char * >( textureCoords_indexed.constData( ) ), header.numVertices * sizeof( QVector2D ) );
+    file.write( reinterpret_cast< const char * >( indices.constData( ) ), header.numIndices * sizeof( quint32 ) );
+    if ( !file.commit( ) ) {
+        qDebug( ) << ":: Failed to write mesh cache:" << path;
+    }
+}
@@ -0,0 +1,309 @@
+#include "objparser.h"
+#include "parallel.h"
+
+#include <QByteArray>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// Documentation can be found in the objparser.h file
+
+// Powers of 10 that are exactly representable as a double
+static const double exactPowersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool isDigit( char c ) {
+    return (unsigned char) ( c - '0' ) < 10;
+}
+
+static inline bool isSpace( char c ) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Slow path for numbers with too many digits or a too large exponent. Note that
+// QByteArray::toDouble( ) does not depend on the locale, unlike strtod( ).
+static float parseObjFloatSlow( const char *begin, const char *end ) {
+    bool ok;
+    double value = QByteArray( begin, int( end - begin ) ).toDouble( &ok );
+    // As QString::toFloat( ), which fails on finite values beyond the range of a float
+    if ( !ok || ( std::fabs( value ) > std::numeric_limits< float >::max( ) && !std::isinf( value ) ) ) {
+        return 0.0f;
+    }
+    return float( value );
+}
+
+float parseObjFloat( const char *begin, const char *end ) {
+    const char *p = begin;
+    bool negative = false;
+    if ( p != end && ( *p == '-' || *p == '+' ) ) {
+        negative = ( *p == '-' );
+        p++;
+    }
+
+    // All significant digits are collected into the mantissa, such that
+    // value = mantissa * 10^exponent
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int numDigits = 0;
+    int numSignificant = 0;
+
+    for ( ; p != end && isDigit( *p ); p++, numDigits++ ) {
+        if ( numSignificant < 19 ) {
+            mantissa = mantissa * 10 + ( *p - '0' );
+            numSignificant += ( mantissa != 0 );
+        } else {
+            exponent++;
+            numSignificant++;
+        }
+    }
+    if ( p != end && *p == '.' ) {
+        for ( p++; p != end && isDigit( *p ); p++, numDigits++ ) {
+            if ( numSignificant < 19 ) {
+                mantissa = mantissa * 10 + ( *p - '0' );
+                numSignificant += ( mantissa != 0 );
+                exponent--;
+            } else {
+                numSignificant++;
+            }
+        }
+    }
+    if ( numDigits == 0 ) {
+        // Possibly "inf" or "nan"
+        return parseObjFloatSlow( begin, end );
+    }
+    if ( p != end && ( *p == 'e' || *p == 'E' ) ) {
+        p++;
+        bool negativeExp = false;
+        if ( p != end && ( *p == '-' || *p == '+' ) ) {
+            negativeExp = ( *p == '-' );
+            p++;
+        }
+        if ( p == end || !isDigit( *p ) ) {
+            return 0.0f;
+        }
+        int e = 0;
+        for ( ; p != end && isDigit( *p ); p++ ) {
+            if ( e < 100000 ) {
+                e = e * 10 + ( *p - '0' );
+            }
+        }
+        exponent += negativeExp ? -e : e;
+    }
+    if ( p != end ) {
+        // Trailing garbage; not a number
+        return 0.0f;
+    }
+
+    // Both the mantissa and the power of 10 are exact doubles, so a single
+    // multiplication or division gives the correctly rounded result. This
+    // is the same double QString::toDouble( ) produces, which in turn is
+    // what QString::toFloat( ) narrows to a float.
+    // The largest value of the fast path, 2^53 * 10^22, is well within the range of a float
+    if ( numSignificant > 19 || mantissa > ( uint64_t( 1 ) << 53 ) || exponent < -22 || exponent > 22 ) {
+        // Only "inf" itself is infinite; digits that overflow a double are out of range as well
+        const float value = parseObjFloatSlow( begin, end );
+        return std::isinf( value ) ? 0.0f : value;
+    }
+    double value = double( mantissa );
+    if ( exponent < 0 ) {
+        value /= exactPowersOf10[ -exponent ];
+    } else {
+        value *= exactPowersOf10[ exponent ];
+    }
+    return float( negative ? -value : value );
+}
+
+// Equivalent of QString::toInt( ), which returns 0 for invalid tokens
+static int parseObjInt( const char *begin, const char *end ) {
+    const char *p = begin;
+    bool negative = false;
+    if ( p != end && ( *p == '-' || *p == '+' ) ) {
+        negative = ( *p == '-' );
+        p++;
+    }
+    if ( p == end ) {
+        return 0;
+    }
+    int64_t value = 0;
+    for ( ; p != end; p++ ) {
+        if ( !isDigit( *p ) ) {
+            return 0;
+        }
+        value = value * 10 + ( *p - '0' );
+        if ( value > INT32_MAX ) {
+            return 0;
+        }
+    }
+    return int( negative ? -value : value );
+}
+
+/**
+ * @brief The LineTokenizer struct splits a single line into whitespace separated tokens
+ */
+struct LineTokenizer {
+    const char *p;
+    const char *end;
+
+    bool next( const char *& tokenBegin, const char *& tokenEnd ) {
+        while ( p != end && isSpace( *p ) ) {
+            p++;
+        }
+        if ( p == end ) {
+            return false;
+        }
+        tokenBegin = p;
+        while ( p != end && !isSpace( *p ) ) {
+            p++;
+        }
+        tokenEnd = p;
+        return true;
+    }
+
+    // Returns the next token as a float, or 0 if there is none
+    float nextFloat( ) {
+        const char *tokenBegin, *tokenEnd;
+        if ( !next( tokenBegin, tokenEnd ) ) {
+            return 0.0f;
+        }
+        return parseObjFloat( tokenBegin, tokenEnd );
+    }
+};
+
+static void parseFaceCorner( const char *begin, const char *end, ObjChunk& out ) {
+    // A corner is "v", "v/vt", "v//vn" or "v/vt/vn"
+    const char *slash1 = static_cast< const char * >( memchr( begin, '/', end - begin ) );
+    if ( !slash1 ) {
+        slash1 = end;
+    }
+    // -1 since .obj counts from 1
+    out.indices.append( parseObjInt( begin, slash1 ) - 1 );
+    if ( slash1 == end ) {
+        return;
+    }
+
+    const char *texBegin = slash1 + 1;
+    const char *slash2 = static_cast< const char * >( memchr( texBegin, '/', end - texBegin ) );
+    if ( !slash2 ) {
+        slash2 = end;
+    }
+    if ( slash2 != texBegin ) {
+        out.texCoordIndices.append( parseObjInt( texBegin, slash2 ) - 1 );
+    }
+    if ( slash2 == end ) {
+        return;
+    }
+
+    const char *normBegin = slash2 + 1;
+    const char *slash3 = static_cast< const char * >( memchr( normBegin, '/', end - normBegin ) );
+    if ( !slash3 ) {
+        slash3 = end;
+    }
+    if ( slash3 != normBegin ) {
+        out.normalIndices.append( parseObjInt( normBegin, slash3 ) - 1 );
+    }
+}
+
+static void parseLine( const char *begin, const char *end, ObjChunk& out ) {
+    if ( begin == end || *begin == '#' ) {
+        return; // skip empty lines and comments
+    }
+
+    LineTokenizer tokens = { begin, end };
+    const char *keyBegin, *keyEnd;
+    if ( !tokens.next( keyBegin, keyEnd ) ) {
+        return;
+    }
+    size_t keyLength = keyEnd - keyBegin;
+
+    if ( keyLength == 1 && keyBegin[ 0 ] == 'v' ) {
+        float x = tokens.nextFloat( );
+        float y = tokens.nextFloat( );
+        float z = tokens.nextFloat( );
+        out.positions.append( QVector3D( x, y, z ) );
+    } else if ( keyLength == 2 && keyBegin[ 0 ] == 'v' && keyBegin[ 1 ] == 'n' ) {
+        float x = tokens.nextFloat( );
+        float y = tokens.nextFloat( );
+        float z = tokens.nextFloat( );
+        out.normals.append( QVector3D( x, y, z ) );
+    } else if ( keyLength == 2 && keyBegin[ 0 ] == 'v' && keyBegin[ 1 ] == 't' ) {
+        float u = tokens.nextFloat( );
+        float v = tokens.nextFloat( );
+        out.texCoords.append( QVector2D( u, v ) );
+    } else if ( keyLength == 1 && keyBegin[ 0 ] == 'f' ) {
+        const char *cornerBegin, *cornerEnd;
+        while ( tokens.next( cornerBegin, cornerEnd ) ) {
+            parseFaceCorner( cornerBegin, cornerEnd, out );
+        }
+    }
+}
+
+void parseObj( const char *begin, const char *end, ObjChunk& out ) {
+    const char *p = begin;
+    while ( p != end ) {
+        const char *lineEnd = static_cast< const char * >( memchr( p, '\n', end - p ) );
+        if ( !lineEnd ) {
+            lineEnd = end;
+        }
+        parseLine( p, lineEnd, out );
+        p = ( lineEnd == end ) ? end : lineEnd + 1;
+    }
+}
+
+void parseObjParallel( const char *begin, const char *end, ObjChunk& out, int numThreads ) {
+    // Small files are not worth the thread startup
+    const std::ptrdiff_t minBytesPerThread = 256 * 1024;
+    numThreads = std::max( 1, std::min< int >( numThreads, int( ( end - begin ) / minBytesPerThread ) ) );
+    if ( numThreads == 1 ) {
+        parseObj( begin, end, out );
+        return;
+    }
+
+    // Split at line boundaries, such that every line is parsed by exactly one thread
+    std::vector< const char * > bounds( numThreads + 1 );
+    bounds[ 0 ] = begin;
+    bounds[ numThreads ] = end;
+    for ( int i = 1; i < numThreads; i++ ) {
+        const char *p = std::max( begin + ( end - begin ) * i / numThreads, bounds[ i - 1 ] );
+        const char *lineEnd = static_cast< const char * >( memchr( p, '\n', end - p ) );
+        bounds[ i ] = lineEnd ? lineEnd + 1 : end;
+    }
+
+    std::vector< ObjChunk > chunks( numThreads );
+    parallelRun( numThreads, [&]( int i ) {
+        parseObj( bounds[ i ], bounds[ i + 1 ], chunks[ i ] );
+    } );
+
+    // Concatenate in file order. Face indices in .obj files refer to the
+    // position in the whole file, so they need no adjustment per chunk.
+    int numPositions = out.positions.size( ), numNormals = out.normals.size( ), numTexCoords = out.texCoords.size( );
+    int numIndices = out.indices.size( ), numTexCoordIndices = out.texCoordIndices.size( ), numNormalIndices = out.normalIndices.size( );
+    for ( const ObjChunk& c : chunks ) {
+        numPositions += c.positions.size( );
+        numNormals += c.normals.size( );
+        numTexCoords += c.texCoords.size( );
+        numIndices += c.indices.size( );
+        numTexCoordIndices += c.texCoordIndices.size( );
+        numNormalIndices += c.normalIndices.size( );
+    }
+    out.positions.reserve( numPositions );
+    out.normals.reserve( numNormals );
+    out.texCoords.reserve( numTexCoords );
+    out.indices.reserve( numIndices );
+    out.texCoordIndices.reserve( numTexCoordIndices );
+    out.normalIndices.reserve( numNormalIndices );
+
+    for ( const ObjChunk& c : chunks ) {
+        out.positions += c.positions;
+        out.normals += c.normals;
+        out.texCoords += c.texCoords;
+        out.indices += c.indices;
+        out.texCoordIndices += c.texCoordIndices;
+        out.normalIndices += c.normalIndices;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <QVector>
+#include <QVector2D>
+#include <QVector3D>
+
+/**
+ * @brief The ObjChunk struct contains the raw records of (a part of) a Wavefront .obj file.
+ *   All indices are converted to be 0-based, but are not yet aligned.
+ */
+struct ObjChunk {
+    QVector< QVector3D > positions;
+    QVector< QVector3D > normals;
+    QVector< QVector2D > texCoords;
+
+    // One entry per face corner. The texture coordinate and normal indices are
+    // only present for corners that specify them.
+    QVector< unsigned > indices;
+    QVector< unsigned > texCoordIndices;
+    QVector< unsigned > normalIndices;
+};
+
+/**
+ * @brief parseObj Parses the 'v', 'vn', 'vt' and 'f' records in the given range
+ *   of .obj file contents. The range is tokenized in place, so no intermediate
+ *   strings are created. Any other records are ignored.
+ *
+ * @param begin The start of the file contents
+ * @param end One past the end of the file contents
+ * @param out The chunk to which the parsed records are appended
+ */
+void parseObj( const char *begin, const char *end, ObjChunk& out );
+
+/**
+ * @brief parseObjParallel Parses the given .obj file contents like parseObj( ), but splits
+ *   it at line boundaries and parses the parts on separate threads. The result is
+ *   identical to that of parseObj( ).
+ *
+ * @param begin The start of the file contents
+ * @param end One past the end of the file contents
+ * @param out The chunk to which the parsed records are appended
+ * @param numThreads The maximum number of threads to use
+ */
+void parseObjParallel( const char *begin, const char *end, ObjChunk& out, int numThreads );
+
+/**
+ * @brief parseObjFloat Parses a floating point number from the given token.
+ *   The result is the same as that of QString::toFloat( ), including a value
+ *   of 0 for tokens that are not a number, or that are beyond the range of a float.
+ *
+ * @param begin The start of the token
+ * @param end One past the end of the token
+ * @return The parsed number
+ */
+float parseObjFloat( const char *begin, const char *end );
+
+#endif // OBJPARSER_H
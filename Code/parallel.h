@@ -0,0 +1,30 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+
+/**
+ * @brief parallelRun Runs the given function for every task index in [0, numTasks),
+ *   each on its own thread. Task 0 runs on the calling thread. Returns once all
+ *   tasks have finished.
+ *
+ * @param numTasks The number of tasks
+ * @param f A function taking the task index
+ */
+template< typename F >
+void parallelRun( int numTasks, const F& f ) {
+    std::vector< std::thread > threads;
+    threads.reserve( numTasks );
+    for ( int i = 1; i < numTasks; i++ ) {
+        threads.emplace_back( [&f, i]( ) { f( i ); } );
+    }
+    if ( numTasks > 0 ) {
+        f( 0 );
+    }
+    for ( std::thread& t : threads ) {
+        t.join( );
+    }
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,246 @@
+#include "profiler.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+
+// Documentation can be found in the profiler.h file
+
+Profiler& Profiler::instance( ) {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler( )
+    : pGl( nullptr ), enabled( false ), inFrame( false ), frame( 0 ), firstFrame( 1 ), numDropped( 0 ),
+      history( HISTORY_SIZE ) {
+    clock.start( );
+    for ( PendingFrame& p : pending ) {
+        p.frame = -1;
+        p.numQueries = 0;
+    }
+    for ( FrameRecord& r : history ) {
+        r.frame = -1;
+        r.hasGpu = false;
+    }
+}
+
+void Profiler::initialize( QOpenGLFunctions_3_3_Core *pGl ) {
+    this->pGl = pGl;
+}
+
+void Profiler::release( ) {
+    if ( !pGl ) {
+        return;
+    }
+    // The profiler outlives the context, so the queries are deleted while it still exists
+    for ( PendingFrame& p : pending ) {
+        if ( !p.queries.empty( ) ) {
+            pGl->glDeleteQueries( GLsizei( p.queries.size( ) ), p.queries.data( ) );
+        }
+        p.queries.clear( );
+        p.numQueries = 0;
+        p.samples.clear( );
+        p.frame = -1;
+    }
+    pGl = nullptr;
+}
+
+void Profiler::setEnabled( bool enabled ) {
+    this->enabled = enabled;
+    inFrame = false;
+    if ( enabled ) {
+        // Anything recorded before is discarded
+        firstFrame = frame + 1;
+        numDropped = 0;
+    }
+}
+
+int Profiler::sectionId( const char *name ) {
+    QString sectionName = QString::fromLatin1( name );
+    for ( size_t i = 0; i < sectionNames.size( ); i++ ) {
+        if ( sectionNames[ i ] == sectionName ) {
+            return int( i );
+        }
+    }
+    sectionNames.push_back( sectionName );
+    return int( sectionNames.size( ) - 1 );
+}
+
+void Profiler::beginFrame( ) {
+    if ( !enabled ) {
+        return;
+    }
+    frame++;
+    inFrame = true;
+
+    // The slot still contains the frame of QUERY_LATENCY frames ago
+    PendingFrame& p = pending[ frame % QUERY_LATENCY ];
+    readBack( p );
+    p.frame = frame;
+    p.numQueries = 0;
+    p.samples.clear( );
+
+    FrameRecord& r = history[ frame % HISTORY_SIZE ];
+    r.frame = frame;
+    r.hasGpu = false;
+    r.cpuNs.assign( sectionNames.size( ), 0 );
+    r.gpuNs.assign( sectionNames.size( ), 0 );
+    r.calls.assign( sectionNames.size( ), 0 );
+}
+
+void Profiler::cpuEnd( int section, qint64 beginNs ) {
+    if ( !inFrame ) {
+        return;
+    }
+    FrameRecord& r = history[ frame % HISTORY_SIZE ];
+    if ( section >= int( r.cpuNs.size( ) ) ) {
+        // Sections are registered upon their first use
+        r.cpuNs.resize( sectionNames.size( ), 0 );
+        r.gpuNs.resize( sectionNames.size( ), 0 );
+        r.calls.resize( sectionNames.size( ), 0 );
+    }
+    r.cpuNs[ section ] += clock.nsecsElapsed( ) - beginNs;
+    r.calls[ section ]++;
+}
+
+int Profiler::gpuBegin( ) {
+    if ( !inFrame || !pGl ) {
+        return -1;
+    }
+    PendingFrame& p = pending[ frame % QUERY_LATENCY ];
+    if ( p.numQueries == int( p.queries.size( ) ) ) {
+        GLuint query;
+        pGl->glGenQueries( 1, &query );
+        p.queries.push_back( query );
+    }
+    pGl->glQueryCounter( p.queries[ p.numQueries ], GL_TIMESTAMP );
+    return p.numQueries++;
+}
+
+void Profiler::gpuEnd( int section, int beginQuery ) {
+    int endQuery = gpuBegin( );
+    if ( endQuery < 0 ) {
+        return;
+    }
+    pending[ frame % QUERY_LATENCY ].samples.push_back( { section, beginQuery, endQuery } );
+}
+
+void Profiler::readBack( PendingFrame& p ) {
+    FrameRecord *r = record( p.frame );
+    if ( !r || p.frame < firstFrame || p.samples.empty( ) ) {
+        return;
+    }
+
+    // Timestamps complete in order, so if the last one is available all are
+    GLint available = 0;
+    pGl->glGetQueryObjectiv( p.queries[ p.numQueries - 1 ], GL_QUERY_RESULT_AVAILABLE, &available );
+    if ( !available ) {
+        numDropped++;
+        return;
+    }
+
+    r->gpuNs.resize( sectionNames.size( ), 0 );
+    for ( const GpuSample& s : p.samples ) {
+        GLuint64 begin, end;
+        pGl->glGetQueryObjectui64v( p.queries[ s.beginQuery ], GL_QUERY_RESULT, &begin );
+        pGl->glGetQueryObjectui64v( p.queries[ s.endQuery ], GL_QUERY_RESULT, &end );
+        r->gpuNs[ s.section ] += qint64( end - begin );
+    }
+    r->hasGpu = true;
+}
+
+Profiler::FrameRecord *Profiler::record( qint64 frame ) {
+    if ( frame < 0 ) {
+        return nullptr;
+    }
+    FrameRecord& r = history[ frame % HISTORY_SIZE ];
+    return r.frame == frame ? &r : nullptr;
+}
+
+// Nearest-rank percentiles p50, p90, p99 and the maximum of the given samples
+static void percentiles( std::vector< qint64 >& samples, qint64 out[ 4 ] ) {
+    if ( samples.empty( ) ) {
+        std::fill( out, out + 4, 0 );
+        return;
+    }
+    std::sort( samples.begin( ), samples.end( ) );
+    const double ps[ 3 ] = { 0.5, 0.9, 0.99 };
+    for ( int i = 0; i < 3; i++ ) {
+        size_t rank = size_t( std::ceil( ps[ i ] * samples.size( ) ) );
+        out[ i ] = samples[ std::max< size_t >( rank, 1 ) - 1 ];
+    }
+    out[ 3 ] = samples.back( );
+}
+
+std::vector< Profiler::SectionStats > Profiler::stats( ) {
+    std::vector< SectionStats > result;
+    for ( size_t s = 0; s < sectionNames.size( ); s++ ) {
+        std::vector< qint64 > cpuSamples, gpuSamples;
+        qint64 numCalls = 0, numFrames = 0;
+        for ( qint64 f = std::max( firstFrame, frame - HISTORY_SIZE + 1 ); f <= frame; f++ ) {
+            FrameRecord *r = record( f );
+            if ( !r ) {
+                continue;
+            }
+            numFrames++;
+            if ( s >= r->calls.size( ) || r->calls[ s ] == 0 ) {
+                continue;
+            }
+            numCalls += r->calls[ s ];
+            cpuSamples.push_back( r->cpuNs[ s ] );
+            if ( r->hasGpu && r->gpuNs[ s ] > 0 ) {
+                gpuSamples.push_back( r->gpuNs[ s ] );
+            }
+        }
+
+        SectionStats stats;
+        stats.name = sectionNames[ s ];
+        stats.calls = numFrames > 0 ? double( numCalls ) / numFrames : 0;
+        percentiles( cpuSamples, stats.cpu );
+        percentiles( gpuSamples, stats.gpu );
+        result.push_back( stats );
+    }
+    return result;
+}
+
+void Profiler::dump( ) {
+    qint64 numFrames = std::min< qint64 >( frame - firstFrame + 1, HISTORY_SIZE );
+    qDebug( ) << ":: Profile of the last" << numFrames << "frames (ms per frame; p50 / p90 / p99 / max)";
+    for ( const SectionStats& s : stats( ) ) {
+        qDebug( ).noquote( ) << QString( "   %1 %2 calls  cpu %3 / %4 / %5 / %6  gpu %7 / %8 / %9 / %10" )
+                                .arg( s.name, -16 ).arg( s.calls, 6, 'f', 1 )
+                                .arg( s.cpu[ 0 ] / 1e6, 0, 'f', 3 ).arg( s.cpu[ 1 ] / 1e6, 0, 'f', 3 )
+                                .arg( s.cpu[ 2 ] / 1e6, 0, 'f', 3 ).arg( s.cpu[ 3 ] / 1e6, 0, 'f', 3 )
+                                .arg( s.gpu[ 0 ] / 1e6, 0, 'f', 3 ).arg( s.gpu[ 1 ] / 1e6, 0, 'f', 3 )
+                                .arg( s.gpu[ 2 ] / 1e6, 0, 'f', 3 ).arg( s.gpu[ 3 ] / 1e6, 0, 'f', 3 );
+    }
+    if ( numDropped > 0 ) {
+        qDebug( ) << ":: GPU timings of" << numDropped << "frames were not available in time";
+    }
+}
+
+bool Profiler::writeCsv( const QString& path ) {
+    QFile file( path );
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text ) ) {
+        qDebug( ) << ":: Failed to write profile to" << path;
+        return false;
+    }
+
+    QTextStream out( &file );
+    out << "section,calls_per_frame,cpu_p50_ms,cpu_p90_ms,cpu_p99_ms,cpu_max_ms,gpu_p50_ms,gpu_p90_ms,gpu_p99_ms,gpu_max_ms\n";
+    for ( const SectionStats& s : stats( ) ) {
+        out << s.name << "," << s.calls;
+        for ( int i = 0; i < 4; i++ ) {
+            out << "," << s.cpu[ i ] / 1e6;
+        }
+        for ( int i = 0; i < 4; i++ ) {
+            out << "," << s.gpu[ i ] / 1e6;
+        }
+        out << "\n";
+    }
+    qDebug( ) << ":: Profile written to" << path;
+    return true;
+}
@@ -0,0 +1,190 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QElapsedTimer>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QString>
+#include <vector>
+
+/**
+ * @brief The Profiler class measures the CPU and GPU time spent in named sections of
+ *   every frame. Sections are marked with the BUZZ_PROFILE_* macros below, which compile
+ *   to nothing unless BUZZ_PROFILING is defined.
+ *
+ * GPU time is measured with GL_TIMESTAMP queries at the start and end of a section, as
+ *   (unlike GL_TIME_ELAPSED queries) these may be nested. The queries of a frame are read
+ *   back QUERY_LATENCY frames later, such that the CPU never waits for the GPU. Should
+ *   their results not be available by then, the GPU samples of that frame are dropped.
+ *
+ * The time of a section is summed over all its invocations within a frame. Statistics
+ *   are kept for the last HISTORY_SIZE frames.
+ *
+ * Sections around single draw calls only measure CPU time, as a pair of timestamps per
+ *   draw would double the commands of the draw, and the GPU overlaps consecutive draws
+ *   anyway. Such a section costs two clock reads per draw while recording, and a test
+ *   of the enabled flag otherwise.
+ */
+class Profiler {
+public:
+    static Profiler& instance( );
+
+    /**
+     * @brief initialize Enables GPU timing in the given context. Without it only CPU
+     *   time is measured.
+     * @param pGl The functions of the context in which all sections are rendered
+     */
+    void initialize( QOpenGLFunctions_3_3_Core *pGl );
+
+    /**
+     * @brief release Deletes the queries, after which only CPU time is measured. The
+     *   context passed to initialize( ) must be current.
+     */
+    void release( );
+
+    bool isEnabled( ) const { return enabled; }
+
+    /**
+     * @brief setEnabled Starts or stops recording. Starting discards all earlier recordings.
+     */
+    void setEnabled( bool enabled );
+
+    /**
+     * @brief sectionId Returns the identifier of the section with the given name,
+     *   registering it if it does not exist yet
+     */
+    int sectionId( const char *name );
+
+    /**
+     * @brief beginFrame Starts a new frame. The previous frame ends here.
+     */
+    void beginFrame( );
+
+    /**
+     * @brief dump Prints the percentiles of the time per frame of every section
+     */
+    void dump( );
+
+    /**
+     * @brief writeCsv Writes the percentiles of the time per frame of every section
+     *   to a CSV file, with one row per section
+     * @param path The file to write to
+     * @return True if the file was written
+     */
+    bool writeCsv( const QString& path );
+
+    // Used by ProfileScope
+    qint64 cpuBegin( ) const { return clock.nsecsElapsed( ); }
+    void cpuEnd( int section, qint64 beginNs );
+    int gpuBegin( );
+    void gpuEnd( int section, int beginQuery );
+
+private:
+    Profiler( );
+    Profiler( const Profiler& ) = delete;
+
+    static const int QUERY_LATENCY = 4;
+    static const int HISTORY_SIZE = 1024;
+
+    struct GpuSample {
+        int section;
+        int beginQuery;
+        int endQuery;
+    };
+
+    // The timestamp queries of a single frame that are not yet read back
+    struct PendingFrame {
+        qint64 frame;
+        std::vector< GLuint > queries; // Grown as needed, and reused
+        int numQueries;
+        std::vector< GpuSample > samples;
+    };
+
+    struct FrameRecord {
+        qint64 frame;
+        bool hasGpu; // Whether the GPU samples were read back
+        std::vector< qint64 > cpuNs; // Per section
+        std::vector< qint64 > gpuNs; // Per section
+        std::vector< int > calls; // Per section
+    };
+
+    struct SectionStats {
+        QString name;
+        double calls; // Mean per frame
+        qint64 cpu[ 4 ]; // p50, p90, p99, max
+        qint64 gpu[ 4 ];
+    };
+
+    void readBack( PendingFrame& pending );
+    FrameRecord *record( qint64 frame );
+    std::vector< SectionStats > stats( );
+
+    QOpenGLFunctions_3_3_Core *pGl;
+    bool enabled;
+    bool inFrame;
+    QElapsedTimer clock;
+
+    std::vector< QString > sectionNames;
+
+    qint64 frame; // The current frame
+    qint64 firstFrame; // The first frame since recording was enabled
+    int numDropped; // Frames of which the GPU samples were not available in time
+    PendingFrame pending[ QUERY_LATENCY ];
+    std::vector< FrameRecord > history;
+};
+
+/**
+ * @brief The ProfileScope class measures the time from its construction to its
+ *   destruction as part of a profiler section
+ */
+class ProfileScope {
+public:
+    ProfileScope( int section, bool gpu )
+            : section( section ), active( Profiler::instance( ).isEnabled( ) ) {
+        if ( active ) {
+            Profiler& profiler = Profiler::instance( );
+            beginNs = profiler.cpuBegin( );
+            beginQuery = gpu ? profiler.gpuBegin( ) : -1;
+        }
+    }
+
+    ~ProfileScope( ) {
+        if ( active ) {
+            Profiler& profiler = Profiler::instance( );
+            if ( beginQuery >= 0 ) {
+                profiler.gpuEnd( section, beginQuery );
+            }
+            profiler.cpuEnd( section, beginNs );
+        }
+    }
+
+private:
+    int section;
+    bool active;
+    qint64 beginNs;
+    int beginQuery;
+};
+
+#ifdef BUZZ_PROFILING
+
+#define BUZZ_PROFILE_CONCAT_( a, b ) a##b
+#define BUZZ_PROFILE_CONCAT( a, b ) BUZZ_PROFILE_CONCAT_( a, b )
+#define BUZZ_PROFILE_SCOPE( name, gpu ) \
+    static const int BUZZ_PROFILE_CONCAT( profileSection, __LINE__ ) = Profiler::instance( ).sectionId( name ); \
+    ProfileScope BUZZ_PROFILE_CONCAT( profileScope, __LINE__ )( BUZZ_PROFILE_CONCAT( profileSection, __LINE__ ), gpu )
+
+// Measures the CPU time until the end of the enclosing scope
+#define BUZZ_PROFILE_CPU( name ) BUZZ_PROFILE_SCOPE( name, false )
+// Measures the CPU and GPU time until the end of the enclosing scope
+#define BUZZ_PROFILE_GPU( name ) BUZZ_PROFILE_SCOPE( name, true )
+// Starts a new frame, which is measured as a whole until the end of the enclosing scope
+#define BUZZ_PROFILE_FRAME( ) Profiler::instance( ).beginFrame( ); BUZZ_PROFILE_GPU( "frame" )
+
+#else
+
+#define BUZZ_PROFILE_CPU( name )
+#define BUZZ_PROFILE_GPU( name )
+#define BUZZ_PROFILE_FRAME( )
+
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,248 @@
+#include "program_cache.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QOpenGLContext>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cstring>
+
+// Documentation can be found in the program_cache.h file
+
+// From GL_ARB_get_program_binary and GL_KHR_parallel_shader_compile, which are not in 3.3
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+ProgramCache::ProgramCache( QOpenGLFunctions_3_3_Core *pGl, const QString& directory )
+    : pGl( pGl ),
+      directory( directory ),
+      pGetProgramBinary( nullptr ),
+      pProgramBinary( nullptr ),
+      pProgramParameteri( nullptr ),
+      loaded( 0 ),
+      compiled( 0 ) {
+    if ( this->directory.isEmpty( ) ) {
+        this->directory = QStandardPaths::writableLocation( QStandardPaths::CacheLocation ) + "/shaders";
+    }
+    driver = QByteArray( reinterpret_cast< const char * >( pGl->glGetString( GL_VENDOR ) ) ) + '\n'
+             + reinterpret_cast< const char * >( pGl->glGetString( GL_RENDERER ) ) + '\n'
+             + reinterpret_cast< const char * >( pGl->glGetString( GL_VERSION ) );
+
+    QOpenGLContext *pContext = QOpenGLContext::currentContext( );
+    if ( pContext->hasExtension( "GL_KHR_parallel_shader_compile" ) ) {
+        // Lets the driver use as many threads as it sees fit
+        MaxShaderCompilerThreads pMaxThreads = reinterpret_cast< MaxShaderCompilerThreads >(
+            pContext->getProcAddress( "glMaxShaderCompilerThreadsKHR" ) );
+        if ( pMaxThreads != nullptr ) {
+            pMaxThreads( 0xFFFFFFFF );
+        }
+    }
+
+    if ( pContext->format( ).version( ) >= qMakePair( 4, 1 ) || pContext->hasExtension( "GL_ARB_get_program_binary" ) ) {
+        // Some drivers support the extension without a single binary format
+        GLint numFormats = 0;
+        pGl->glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats );
+        if ( numFormats > 0 ) {
+            pGetProgramBinary = reinterpret_cast< GetProgramBinary >( pContext->getProcAddress( "glGetProgramBinary" ) );
+            pProgramBinary = reinterpret_cast< ProgramBinary >( pContext->getProcAddress( "glProgramBinary" ) );
+            pProgramParameteri = reinterpret_cast< ProgramParameteri >( pContext->getProcAddress( "glProgramParameteri" ) );
+        }
+        if ( pGetProgramBinary == nullptr || pProgramBinary == nullptr || pProgramParameteri == nullptr ) {
+            pGetProgramBinary = nullptr;
+            pProgramBinary = nullptr;
+            pProgramParameteri = nullptr;
+        }
+    }
+    if ( pProgramBinary == nullptr ) {
+        qDebug( ) << ":: Program binaries are not supported, shaders are compiled from source";
+    }
+}
+
+ProgramCache::~ProgramCache( ) {
+    if ( !pending.empty( ) ) {
+        finish( );
+    }
+}
+
+QByteArray ProgramCache::keyOf( const Sources& sources ) const {
+    QCryptographicHash hash( QCryptographicHash::Sha1 );
+    // The separators keep moving text from one part to another from giving the same key
+    hash.addData( sources.vertex.toUtf8( ) );
+    hash.addData( "\0", 1 );
+    hash.addData( sources.geometry.toUtf8( ) );
+    hash.addData( "\0", 1 );
+    hash.addData( sources.fragment.toUtf8( ) );
+    hash.addData( "\0", 1 );
+    hash.addData( sources.varyings.join( '\n' ).toUtf8( ) );
+    hash.addData( "\0", 1 );
+    hash.addData( driver );
+    return hash.result( ).toHex( );
+}
+
+void ProgramCache::add( QOpenGLShaderProgram& program, const Sources& sources, const Configure& configure ) {
+    if ( !program.create( ) ) {
+        qDebug( ) << ":: Failed to create a shader program";
+        return;
+    }
+
+    Pending entry;
+    entry.pProgram = &program;
+    entry.sources = sources;
+    entry.configure = configure;
+    entry.path = directory + "/" + keyOf( sources ) + ".bin";
+    entry.fromBinary = loadBinary( entry );
+    if ( !entry.fromBinary ) {
+        compile( entry );
+    }
+    pending.push_back( std::move( entry ) );
+}
+
+bool ProgramCache::loadBinary( Pending& entry ) {
+    if ( pProgramBinary == nullptr ) {
+        return false;
+    }
+    QFile file( entry.path );
+    if ( !file.open( QIODevice::ReadOnly ) ) {
+        return false;
+    }
+    // The format of the binary, followed by the binary itself
+    const QByteArray data = file.readAll( );
+    if ( data.size( ) <= int( sizeof( GLenum ) ) ) {
+        return false;
+    }
+    GLenum format;
+    std::memcpy( &format, data.constData( ), sizeof( GLenum ) );
+    pProgramBinary( entry.pProgram->programId( ), format, data.constData( ) + sizeof( GLenum ),
+                    GLsizei( data.size( ) - sizeof( GLenum ) ) );
+    return true;
+}
+
+void ProgramCache::compile( Pending& entry ) {
+    const GLuint program = entry.pProgram->programId( );
+    const std::pair< GLenum, const QString * > stages[] = {
+        { GL_VERTEX_SHADER, &entry.sources.vertex },
+        { GL_GEOMETRY_SHADER, &entry.sources.geometry },
+        { GL_FRAGMENT_SHADER, &entry.sources.fragment }
+    };
+    for ( const auto& stage : stages ) {
+        if ( stage.second->isEmpty( ) ) {
+            continue;
+        }
+        const QByteArray source = stage.second->toUtf8( );
+        const char *pSource = source.constData( );
+        const GLint length = source.size( );
+        const GLuint shader = pGl->glCreateShader( stage.first );
+        pGl->glShaderSource( shader, 1, &pSource, &length );
+        pGl->glCompileShader( shader );
+        pGl->glAttachShader( program, shader );
+        entry.shaders.push_back( shader );
+    }
+
+    if ( !entry.sources.varyings.isEmpty( ) ) {
+        std::vector< QByteArray > names;
+        std::vector< const char * > pNames;
+        for ( const QString& varying : entry.sources.varyings ) {
+            names.push_back( varying.toUtf8( ) );
+        }
+        for ( const QByteArray& name : names ) {
+            pNames.push_back( name.constData( ) );
+        }
+        pGl->glTransformFeedbackVaryings( program, GLsizei( pNames.size( ) ), pNames.data( ), GL_INTERLEAVED_ATTRIBS );
+    }
+    if ( pProgramParameteri != nullptr ) {
+        pProgramParameteri( program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+    }
+    // The status is only asked for by finish( ), such that this does not wait for the compiler
+    pGl->glLinkProgram( program );
+}
+
+QString ProgramCache::infoLog( GLuint object, bool isShader ) const {
+    GLint length = 0;
+    if ( isShader ) {
+        pGl->glGetShaderiv( object, GL_INFO_LOG_LENGTH, &length );
+    } else {
+        pGl->glGetProgramiv( object, GL_INFO_LOG_LENGTH, &length );
+    }
+    QByteArray log( std::max( length, 1 ), '\0' );
+    if ( isShader ) {
+        pGl->glGetShaderInfoLog( object, length, nullptr, log.data( ) );
+    } else {
+        pGl->glGetProgramInfoLog( object, length, nullptr, log.data( ) );
+    }
+    return QString::fromUtf8( log.constData( ) );
+}
+
+void ProgramCache::storeBinary( const Pending& entry ) {
+    const GLuint program = entry.pProgram->programId( );
+    GLint length = 0;
+    pGl->glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH, &length );
+    if ( length <= 0 || !QDir( ).mkpath( directory ) ) {
+        return;
+    }
+
+    QByteArray data( int( sizeof( GLenum ) ) + length, Qt::Uninitialized );
+    GLenum format = 0;
+    pGetProgramBinary( program, length, nullptr, &format, data.data( ) + sizeof( GLenum ) );
+    std::memcpy( data.data( ), &format, sizeof( GLenum ) );
+
+    // Written to a temporary file first, so another instance never reads half a binary
+    QSaveFile file( entry.path );
+    if ( !file.open( QIODevice::WriteOnly ) || file.write( data ) != data.size( ) || !file.commit( ) ) {
+        qDebug( ) << ":: Failed to store program binary" << entry.path;
+    }
+}
+
+bool ProgramCache::finish( ) {
+    bool success = true;
+    for ( Pending& entry : pending ) {
+        const GLuint program = entry.pProgram->programId( );
+        GLint status = GL_FALSE;
+        pGl->glGetProgramiv( program, GL_LINK_STATUS, &status );
+        if ( !status && entry.fromBinary ) {
+            qDebug( ) << ":: Program binary" << entry.path << "was rejected, compiling from source";
+            entry.fromBinary = false;
+            compile( entry );
+            pGl->glGetProgramiv( program, GL_LINK_STATUS, &status );
+        }
+
+        if ( !status ) {
+            qDebug( ) << ":: Failed to link shader program -" << infoLog( program, false );
+            for ( GLuint shader : entry.shaders ) {
+                qDebug( ) << "::  " << infoLog( shader, true );
+            }
+        } else if ( entry.fromBinary ) {
+            loaded++;
+        } else {
+            compiled++;
+            if ( pGetProgramBinary != nullptr ) {
+                storeBinary( entry );
+            }
+        }
+        for ( GLuint shader : entry.shaders ) {
+            pGl->glDetachShader( program, shader );
+            pGl->glDeleteShader( shader );
+        }
+        if ( !status ) {
+            success = false;
+            continue;
+        }
+
+        // Without shaders of its own, this only picks up the link status
+        entry.pProgram->link( );
+        if ( entry.configure ) {
+            entry.configure( *entry.pProgram );
+        }
+    }
+    pending.clear( );
+    return success;
+}
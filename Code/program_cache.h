@@ -0,0 +1,116 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <QByteArray>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include <vector>
+
+/**
+ * @brief The ProgramCache class builds shader programs, which it stores as linked binaries
+ *   on disk, such that later launches skip compiling them.
+ *
+ * All programs are added before any of them is used. add( ) only issues the commands to
+ *   load or compile and link a program, without asking for the result. The driver may thus
+ *   compile all programs concurrently (explicitly so with GL_KHR_parallel_shader_compile),
+ *   while finish( ) waits for them in order.
+ *
+ * A binary is keyed by the sources of the program, its transform feedback varyings and the
+ *   vendor, renderer and version of the driver. A binary the driver rejects (e.g. after an
+ *   update that kept the version string) is compiled from its sources instead, and replaced.
+ *   Without GL_ARB_get_program_binary, every program is compiled from its sources.
+ *
+ * Note that this class can only be used after OpenGL is initialised
+ */
+class ProgramCache {
+public:
+    /**
+     * @brief The Sources struct holds the stages of a program. The geometry and fragment
+     *   sources may be empty.
+     */
+    struct Sources {
+        QString vertex;
+        QString geometry;
+        QString fragment;
+        // The outputs to capture by transform feedback, interleaved
+        QStringList varyings;
+    };
+
+    // Called with a program once it is linked, e.g. to bind its uniform blocks
+    typedef std::function< void( QOpenGLShaderProgram& ) > Configure;
+
+    /**
+     * @brief ProgramCache Prepares to build programs with the current context
+     * @param pGl The functions of the context
+     * @param directory The directory of the binaries, which is created when needed. By
+     *   default, the 'shaders' directory in the cache location of the application.
+     */
+    ProgramCache( QOpenGLFunctions_3_3_Core *pGl, const QString& directory = QString( ) );
+    ~ProgramCache( );
+
+    /**
+     * @brief add Starts building a program from the sources, or from their binary
+     * @param program The program to build, which has no shaders yet. It must not be used
+     *   before finish( ).
+     * @param sources The sources of the program
+     * @param configure Called by finish( ) once the program is linked
+     */
+    void add( QOpenGLShaderProgram& program, const Sources& sources, const Configure& configure = Configure( ) );
+
+    /**
+     * @brief finish Waits for all programs added since the last call, and stores the
+     *   binaries of those compiled from source
+     * @return Whether all programs were linked
+     */
+    bool finish( );
+
+    /**
+     * @brief numLoaded The number of programs loaded from a binary
+     */
+    int numLoaded( ) const { return loaded; }
+
+    /**
+     * @brief numCompiled The number of programs compiled from their sources
+     */
+    int numCompiled( ) const { return compiled; }
+
+private:
+    struct Pending {
+        QOpenGLShaderProgram *pProgram;
+        Sources sources;
+        Configure configure;
+        QString path;
+        bool fromBinary;
+        std::vector< GLuint > shaders;
+    };
+
+    typedef void ( QOPENGLF_APIENTRYP GetProgramBinary )( GLuint, GLsizei, GLsizei *, GLenum *, void * );
+    typedef void ( QOPENGLF_APIENTRYP ProgramBinary )( GLuint, GLenum, const void *, GLsizei );
+    typedef void ( QOPENGLF_APIENTRYP ProgramParameteri )( GLuint, GLenum, GLint );
+    typedef void ( QOPENGLF_APIENTRYP MaxShaderCompilerThreads )( GLuint );
+
+    bool loadBinary( Pending& pending );
+    void compile( Pending& pending );
+    void storeBinary( const Pending& pending );
+    QByteArray keyOf( const Sources& sources ) const;
+    QString infoLog( GLuint object, bool isShader ) const;
+
+    QOpenGLFunctions_3_3_Core *pGl;
+    QString directory;
+    // Identifies the driver the binaries were made by
+    QByteArray driver;
+
+    // Null without binary support
+    GetProgramBinary pGetProgramBinary;
+    ProgramBinary pProgramBinary;
+    ProgramParameteri pProgramParameteri;
+
+    std::vector< Pending > pending;
+    int loaded;
+    int compiled;
+};
+
+#endif // PROGRAM_CACHE_H
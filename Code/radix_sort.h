@@ -0,0 +1,53 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief radixSort Sorts entries by their 64-bit 'key' member, in linear time. The sort is
+ *   stable, so entries with equal keys keep their order.
+ *
+ * @param entries The entries to sort
+ * @param scratch Storage of the same size, which is kept between calls to avoid allocating
+ */
+template< typename Entry >
+void radixSort( std::vector< Entry >& entries, std::vector< Entry >& scratch ) {
+    if ( entries.empty( ) ) {
+        return;
+    }
+
+    // The histograms of all eight bytes are gathered in a single pass
+    static const int NUM_PASSES = 8;
+    std::vector< uint32_t > counts( NUM_PASSES * 256, 0 );
+    for ( const Entry& entry : entries ) {
+        for ( int pass = 0; pass < NUM_PASSES; pass++ ) {
+            counts[ pass * 256 + ( ( entry.key >> ( 8 * pass ) ) & 0xFF ) ]++;
+        }
+    }
+
+    scratch.resize( entries.size( ) );
+    for ( int pass = 0; pass < NUM_PASSES; pass++ ) {
+        uint32_t *pCounts = &counts[ pass * 256 ];
+        const uint64_t firstByte = ( entries[ 0 ].key >> ( 8 * pass ) ) & 0xFF;
+        // A byte that is the same for all keys (such as the program id of a RenderQueue,
+        // typically) would not change the order
+        if ( pCounts[ firstByte ] == entries.size( ) ) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for ( int byte = 0; byte < 256; byte++ ) {
+            const uint32_t count = pCounts[ byte ];
+            pCounts[ byte ] = offset;
+            offset += count;
+        }
+        // Stable, so the order of the previous passes is kept among equal bytes
+        for ( const Entry& entry : entries ) {
+            scratch[ pCounts[ ( entry.key >> ( 8 * pass ) ) & 0xFF ]++ ] = entry;
+        }
+        entries.swap( scratch );
+    }
+}
+
+#endif // RADIX_SORT_H
@@ -0,0 +1,45 @@
+#include "range_allocator.h"
+
+#include <iterator>
+
+// Documentation can be found in the range_allocator.h file
+
+GLintptr RangeAllocator::allocate( GLsizeiptr size ) {
+    for ( auto it = freeRanges.begin( ); it != freeRanges.end( ); ++it ) {
+        if ( it->second < size ) {
+            continue;
+        }
+        const GLintptr offset = it->first;
+        const GLsizeiptr remainder = it->second - size;
+        freeRanges.erase( it );
+        if ( remainder > 0 ) {
+            freeRanges.emplace( offset + size, remainder );
+        }
+        return offset;
+    }
+    return -1;
+}
+
+void RangeAllocator::free( GLintptr offset, GLsizeiptr size ) {
+    auto next = freeRanges.lower_bound( offset );
+    if ( next != freeRanges.end( ) && offset + size == next->first ) {
+        size += next->second;
+        next = freeRanges.erase( next );
+    }
+    if ( next != freeRanges.begin( ) ) {
+        auto previous = std::prev( next );
+        if ( previous->first + previous->second == offset ) {
+            previous->second += size;
+            return;
+        }
+    }
+    freeRanges.emplace( offset, size );
+}
+
+void RangeAllocator::reset( GLsizeiptr used, GLsizeiptr newCapacity ) {
+    freeRanges.clear( );
+    if ( used < newCapacity ) {
+        freeRanges.emplace( used, newCapacity - used );
+    }
+    capacity = newCapacity;
+}
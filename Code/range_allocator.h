@@ -0,0 +1,30 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <qopengl.h>
+#include <map>
+
+/**
+ * @brief The RangeAllocator class hands out ranges of [0, capacity) first-fit, from a free
+ *   list in which freed ranges are merged with their free neighbours. It only does the
+ *   bookkeeping; the storage the ranges refer to is up to the user (see MeshArena).
+ */
+class RangeAllocator {
+public:
+    RangeAllocator( ) : capacity( 0 ) { }
+
+    // Returns -1 if no free range is large enough
+    GLintptr allocate( GLsizeiptr size );
+    void free( GLintptr offset, GLsizeiptr size );
+    // Makes [0, used) allocated and the remainder up to the new capacity free
+    void reset( GLsizeiptr used, GLsizeiptr newCapacity );
+
+    // The free ranges by their offset, of which no two are adjacent
+    const std::map< GLintptr, GLsizeiptr >& ranges( ) const { return freeRanges; }
+
+    GLsizeiptr capacity;
+private:
+    std::map< GLintptr, GLsizeiptr > freeRanges;
+};
+
+#endif // RANGE_ALLOCATOR_H
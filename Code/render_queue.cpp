@@ -0,0 +1,157 @@
+#include "render_queue.h"
+#include "profiler.h"
+#include "radix_sort.h"
+#include "uniforms.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Documentation can be found in the render_queue.h file
+
+// The bits of the sort key, from the most significant ones down
+static const int PROGRAM_BITS = 8;
+static const int VERTEX_ARRAY_BITS = 16;
+static const int MATERIAL_BITS = 16;
+static const int DEPTH_BITS = 24;
+
+static const int MATERIAL_SHIFT = DEPTH_BITS;
+static const int VERTEX_ARRAY_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+static const int PROGRAM_SHIFT = VERTEX_ARRAY_SHIFT + VERTEX_ARRAY_BITS;
+
+static_assert( PROGRAM_SHIFT + PROGRAM_BITS == 64, "The sort key fields should fill 64 bits" );
+
+// The bits of a non-negative float increase along with its value, so its most significant
+// bits are a quantized depth that keeps the relative precision of the float
+static uint64_t quantizeDepth( float depth ) {
+    if ( !( depth > 0.0f ) ) {
+        return 0;
+    }
+    uint32_t bits;
+    std::memcpy( &bits, &depth, sizeof( bits ) );
+    return bits >> ( 32 - DEPTH_BITS );
+}
+
+RenderQueue::RenderQueue( QOpenGLFunctions_3_3_Core *pGl )
+    : pGl( pGl ),
+      currentStats { 0, 0, 0 },
+      lastStats { 0, 0, 0 } {
+    resetState( );
+}
+
+uint64_t RenderQueue::idOf( std::unordered_map< uintptr_t, uint32_t >& ids, uintptr_t object, int bits ) {
+    auto it = ids.emplace( object, uint32_t( ids.size( ) ) ).first;
+    return it->second & ( ( 1u << bits ) - 1 );
+}
+
+void RenderQueue::add( GLuint program, GeneralBatch *pBatch, Material *pMaterial,
+                       const RingBuffer::Allocation& object, float depth ) {
+    SortEntry entry;
+    entry.key = ( idOf( programIds, program, PROGRAM_BITS ) << PROGRAM_SHIFT )
+              | ( idOf( vertexArrayIds, pBatch->vertexArray( ), VERTEX_ARRAY_BITS ) << VERTEX_ARRAY_SHIFT )
+              | ( idOf( materialIds, uintptr_t( pMaterial ), MATERIAL_BITS ) << MATERIAL_SHIFT )
+              | quantizeDepth( depth );
+    entry.packet = uint32_t( packets.size( ) );
+    entries.push_back( entry );
+
+    packets.push_back( Packet { program, pBatch, pMaterial, object } );
+}
+
+void RenderQueue::submit( ) {
+    BUZZ_PROFILE_GPU( "queue.submit" );
+
+    currentStats = Stats { int( packets.size( ) ), 0, 0 };
+    if ( !packets.empty( ) ) {
+        {
+            BUZZ_PROFILE_CPU( "queue.sort" );
+            radixSort( entries, sortScratch );
+        }
+
+        // Whatever was bound before is not known to be still bound
+        resetState( );
+        for ( const SortEntry& entry : entries ) {
+            BUZZ_PROFILE_CPU( "queue.draw" );
+            const Packet& packet = packets[ entry.packet ];
+
+            useProgram( packet.program );
+            bindBatch( packet.pBatch );
+
+            const Material& material = *packet.pMaterial;
+            if ( material.uniformBuffer != 0 ) {
+                bindUniform( boundMaterial, UB_MATERIAL, UniformRange { material.uniformBuffer, material.uniformOffset,
+                                                                        GLsizeiptr( sizeof( MaterialBlock ) ) } );
+            }
+            // As in Material::applyTo( ), a missing texture leaves the unit as it is
+            if ( material.diffuseTexture != 0 ) {
+                bindTexture( 0, material.diffuseTexture );
+            }
+            if ( material.normalTexture != 0 ) {
+                bindTexture( 1, material.normalTexture );
+            }
+            if ( material.specularTexture != 0 ) {
+                bindTexture( 2, material.specularTexture );
+            }
+
+            bindUniform( boundObject, UB_OBJECT, UniformRange { packet.object.buffer, packet.object.offset, packet.object.size } );
+
+            packet.pBatch->drawBound( );
+        }
+    }
+
+    packets.clear( );
+    entries.clear( );
+    lastStats = currentStats;
+}
+
+void RenderQueue::useProgram( GLuint program ) {
+    if ( program == boundProgram ) {
+        currentStats.numStateChangesAvoided++;
+        return;
+    }
+    pGl->glUseProgram( program );
+    boundProgram = program;
+    currentStats.numStateChanges++;
+}
+
+void RenderQueue::bindBatch( GeneralBatch *pBatch ) {
+    // Batches that share their mesh arena share the VAO as well
+    if ( pBatch->vertexArray( ) == boundVertexArray ) {
+        currentStats.numStateChangesAvoided++;
+        return;
+    }
+    pBatch->bind( );
+    boundVertexArray = pBatch->vertexArray( );
+    currentStats.numStateChanges++;
+}
+
+void RenderQueue::bindUniform( UniformRange& bound, GLuint binding, const UniformRange& range ) {
+    if ( range.buffer == bound.buffer && range.offset == bound.offset && range.size == bound.size ) {
+        currentStats.numStateChangesAvoided++;
+        return;
+    }
+    pGl->glBindBufferRange( GL_UNIFORM_BUFFER, binding, range.buffer, range.offset, range.size );
+    bound = range;
+    currentStats.numStateChanges++;
+}
+
+void RenderQueue::bindTexture( int unit, GLuint texture ) {
+    if ( texture == boundTextures[ unit ] ) {
+        currentStats.numStateChangesAvoided++;
+        return;
+    }
+    if ( unit != activeUnit ) {
+        pGl->glActiveTexture( GL_TEXTURE0 + unit );
+        activeUnit = unit;
+    }
+    pGl->glBindTexture( GL_TEXTURE_2D, texture );
+    boundTextures[ unit ] = texture;
+    currentStats.numStateChanges++;
+}
+
+void RenderQueue::resetState( ) {
+    boundProgram = 0;
+    boundVertexArray = 0;
+    boundMaterial = UniformRange { 0, 0, 0 };
+    boundObject = UniformRange { 0, 0, 0 };
+    std::fill( boundTextures, boundTextures + 3, 0 );
+    activeUnit = -1;
+}
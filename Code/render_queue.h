@@ -0,0 +1,115 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "batch.h"
+#include "material.h"
+#include "ring_buffer.h"
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief The RenderQueue class collects the draws of a frame, and submits them in the order
+ *   that changes the least OpenGL state.
+ *
+ * Every draw is recorded as a packet with a 64-bit sort key. From the most to the least
+ *   significant bits it holds the program, the VAO, the material and the depth,
+ *   such that the draws that share the most expensive state end up next to each other, and
+ *   draws of equal state go front to back. The keys are radix sorted (see radix_sort.h), which
+ *   takes linear time.
+ *
+ * Upon submission, the queue tracks the bound program, VAO, uniform buffer ranges and
+ *   textures, and skips every bind of a value that is already bound. The number of binds
+ *   that were made and that were skipped are reported by stats( ).
+ *
+ * Note that this class can only be used after OpenGL is initialised
+ */
+class RenderQueue {
+public:
+    /**
+     * @brief The Stats struct counts the state changes of the last submit( )
+     */
+    struct Stats {
+        int numPackets;
+        // The binds that were made
+        int numStateChanges;
+        // The binds that drawing every packet on its own would have made as well
+        int numStateChangesAvoided;
+    };
+
+    RenderQueue( QOpenGLFunctions_3_3_Core *pGl );
+
+    /**
+     * @brief add Records a draw for the next submit( )
+     * @param program The shader program to draw with
+     * @param pBatch The batch to draw
+     * @param pMaterial The material to draw with
+     * @param object The 'Object' uniform block of the draw, written to the ring buffer
+     * @param depth The distance from the camera, by which draws of equal state are ordered
+     */
+    void add( GLuint program, GeneralBatch *pBatch, Material *pMaterial,
+              const RingBuffer::Allocation& object, float depth );
+
+    /**
+     * @brief submit Sorts and draws the packets added since the last call, after which
+     *   the queue is empty. The ring buffer with the object blocks must be unmapped.
+     */
+    void submit( );
+
+    const Stats& stats( ) const { return lastStats; }
+
+private:
+    struct Packet {
+        GLuint program;
+        GeneralBatch *pBatch;
+        Material *pMaterial;
+        RingBuffer::Allocation object;
+    };
+
+    struct SortEntry {
+        uint64_t key;
+        uint32_t packet;
+    };
+
+    // A dense id for every distinct object (a name or pointer), which wraps around beyond
+    // the given number of bits. That only affects the order, not the correctness.
+    static uint64_t idOf( std::unordered_map< uintptr_t, uint32_t >& ids, uintptr_t object, int bits );
+
+    struct UniformRange {
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    // Every bind is skipped, and counted as avoided, if the value is bound already
+    void useProgram( GLuint program );
+    void bindBatch( GeneralBatch *pBatch );
+    void bindUniform( UniformRange& bound, GLuint binding, const UniformRange& range );
+    void bindTexture( int unit, GLuint texture );
+    void resetState( );
+
+    QOpenGLFunctions_3_3_Core *pGl;
+
+    std::vector< Packet > packets;
+    std::vector< SortEntry > entries;
+    std::vector< SortEntry > sortScratch;
+
+    std::unordered_map< uintptr_t, uint32_t > programIds;
+    std::unordered_map< uintptr_t, uint32_t > vertexArrayIds;
+    std::unordered_map< uintptr_t, uint32_t > materialIds;
+
+    // The state bound by the packets submitted so far. Zero (or -1 for the unit) is unknown.
+    GLuint boundProgram;
+    GLuint boundVertexArray;
+    UniformRange boundMaterial;
+    UniformRange boundObject;
+    GLuint boundTextures[ 3 ];
+    int activeUnit;
+
+    Stats currentStats;
+    Stats lastStats;
+};
+
+#endif // RENDER_QUEUE_H
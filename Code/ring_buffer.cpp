@@ -0,0 +1,171 @@
+#include "ring_buffer.h"
+#include "profiler.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <algorithm>
+
+// Documentation can be found in the ring_buffer.h file
+
+// The largest alignment an allocation may ask for, unless uniform blocks need a larger one
+static const GLsizeiptr MAX_ALIGNMENT = 256;
+
+static GLsizeiptr alignUp( GLsizeiptr value, GLsizeiptr alignment ) {
+    return ( ( value + alignment - 1 ) / alignment ) * alignment;
+}
+
+RingBuffer::RingBuffer( QOpenGLFunctions_3_3_Core *pGl, GLsizeiptr frameCapacity )
+    : pGl( pGl ),
+      buffer( 0 ),
+      regionSize( 0 ),
+      maxAlignment( 0 ),
+      region( 0 ),
+      head( 0 ),
+      pMapped( nullptr ),
+      mapBegin( 0 ),
+      bytesThisFrame( 0 ),
+      lastBytesWritten( 0 ),
+      lastFenceWaitNs( 0 ) {
+    pGl->glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment );
+    // Every region starts at a multiple of the largest alignment, which stays so as the
+    // region size doubles
+    maxAlignment = std::max< GLsizeiptr >( MAX_ALIGNMENT, uniformAlignment );
+    regionSize = alignUp( std::max( frameCapacity, maxAlignment ), maxAlignment );
+    std::fill( fences, fences + NUM_FRAMES, nullptr );
+    createBuffer( );
+}
+
+RingBuffer::~RingBuffer( ) {
+    unmap( );
+    for ( GLsync& fence : fences ) {
+        if ( fence != nullptr ) {
+            pGl->glDeleteSync( fence );
+        }
+    }
+    retiredBuffers.push_back( buffer );
+    pGl->glDeleteBuffers( GLsizei( retiredBuffers.size( ) ), retiredBuffers.data( ) );
+}
+
+void RingBuffer::createBuffer( ) {
+    pGl->glGenBuffers( 1, &buffer );
+    pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, buffer );
+    pGl->glBufferData( GL_COPY_WRITE_BUFFER, regionSize * NUM_FRAMES, nullptr, GL_STREAM_DRAW );
+    pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+}
+
+void RingBuffer::beginFrame( ) {
+    BUZZ_PROFILE_CPU( "ringbuffer.wait" );
+
+    region = ( region + 1 ) % NUM_FRAMES;
+    head = 0;
+    bytesThisFrame = 0;
+    lastFenceWaitNs = 0;
+
+    GLsync& fence = fences[ region ];
+    if ( fence == nullptr ) {
+        return;
+    }
+    // Typically the GPU is done with the region already, which is checked without waiting
+    if ( pGl->glClientWaitSync( fence, 0, 0 ) == GL_TIMEOUT_EXPIRED ) {
+        QElapsedTimer timer;
+        timer.start( );
+        GLenum result;
+        do {
+            // The first wait flushes, such that the fence is sure to be signalled eventually
+            result = pGl->glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000 );
+        } while ( result == GL_TIMEOUT_EXPIRED );
+        lastFenceWaitNs = timer.nsecsElapsed( );
+    }
+    pGl->glDeleteSync( fence );
+    fence = nullptr;
+}
+
+RingBuffer::Allocation RingBuffer::allocate( GLsizeiptr size, GLsizeiptr alignment ) {
+    Q_ASSERT( alignment > 0 && alignment <= maxAlignment );
+    GLsizeiptr offset = alignUp( head, alignment );
+    if ( offset + size > regionSize ) {
+        grow( offset + size );
+        offset = 0;
+    }
+    if ( pMapped == nullptr ) {
+        map( );
+    }
+
+    Allocation allocation;
+    allocation.pData = pMapped + ( offset - mapBegin );
+    allocation.buffer = buffer;
+    allocation.offset = region * regionSize + offset;
+    allocation.size = size;
+
+    head = offset + size;
+    bytesThisFrame += size;
+    return allocation;
+}
+
+void RingBuffer::bindUniform( GLuint binding, const Allocation& allocation ) {
+    pGl->glBindBufferRange( GL_UNIFORM_BUFFER, binding, allocation.buffer, allocation.offset, allocation.size );
+}
+
+void RingBuffer::map( ) {
+    mapBegin = head;
+    pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, buffer );
+    // The region is not in use by the GPU, so the driver need not synchronize. Only the
+    // written part is flushed upon unmapping.
+    pMapped = static_cast< char * >( pGl->glMapBufferRange( GL_COPY_WRITE_BUFFER, region * regionSize + mapBegin, regionSize - mapBegin,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT ) );
+    pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+    if ( pMapped == nullptr ) {
+        qDebug( ) << ":: Failed to map the ring buffer, this frame's dynamic data is lost";
+        scratch.resize( regionSize );
+        pMapped = scratch.data( );
+    }
+}
+
+void RingBuffer::unmap( ) {
+    if ( pMapped == nullptr ) {
+        return;
+    }
+    if ( pMapped != scratch.data( ) ) {
+        pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, buffer );
+        pGl->glFlushMappedBufferRange( GL_COPY_WRITE_BUFFER, 0, head - mapBegin );
+        pGl->glUnmapBuffer( GL_COPY_WRITE_BUFFER );
+        pGl->glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+    }
+    pMapped = nullptr;
+}
+
+void RingBuffer::grow( GLsizeiptr minSize ) {
+    // The allocations of this frame in the old buffer stay valid until it is submitted
+    unmap( );
+    retiredBuffers.push_back( buffer );
+
+    // Nothing of the new buffer is in use by the GPU yet
+    for ( GLsync& fence : fences ) {
+        if ( fence != nullptr ) {
+            pGl->glDeleteSync( fence );
+            fence = nullptr;
+        }
+    }
+
+    while ( regionSize < minSize ) {
+        regionSize *= 2;
+    }
+    createBuffer( );
+    head = 0;
+    qDebug( ) << ":: Ring buffer grown to" << regionSize << "bytes per frame";
+}
+
+void RingBuffer::endFrame( ) {
+    unmap( );
+    fences[ region ] = pGl->glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+
+    // The commands that read from them have been issued, so the driver keeps them alive
+    // for as long as they need
+    if ( !retiredBuffers.empty( ) ) {
+        pGl->glDeleteBuffers( GLsizei( retiredBuffers.size( ) ), retiredBuffers.data( ) );
+        retiredBuffers.clear( );
+    }
+
+    lastBytesWritten = bytesThisFrame;
+}
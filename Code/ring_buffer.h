@@ -0,0 +1,127 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <vector>
+
+/**
+ * @brief The RingBuffer class streams the data that changes every frame (uniform blocks and
+ *   instance attributes) to the GPU, through a single buffer object.
+ *
+ * The buffer is split into NUM_FRAMES regions, one for each of the frames that the GPU may
+ *   lag behind. A frame writes its data linearly into its own region, which is mapped with
+ *   GL_MAP_UNSYNCHRONIZED_BIT, so the driver never waits for the GPU to finish with the
+ *   buffer. Instead, a fence is placed after the last command of every frame. Only when a
+ *   region comes around again does beginFrame( ) wait for its fence, which has typically
+ *   long passed by then.
+ *
+ * As OpenGL 3.3 has no persistent mapping, the region is mapped on the first allocation and
+ *   must be unmapped with unmap( ) before drawing with the written data. Allocating after
+ *   that maps the remainder of the region again. Should a frame need more than a region,
+ *   the buffer grows, which happens once as the amount of data settles.
+ *
+ * Note that this class can only be used after OpenGL is initialised
+ */
+class RingBuffer {
+public:
+    /**
+     * @brief The Allocation struct is a range of the buffer to write the data of a frame to
+     */
+    struct Allocation {
+        // Where to write the data, valid until the next unmap( )
+        void *pData;
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    static const int NUM_FRAMES = 3;
+
+    /**
+     * @brief RingBuffer Creates the buffer
+     * @param pGl The functions of the context
+     * @param frameCapacity The initial number of bytes available to a frame
+     */
+    RingBuffer( QOpenGLFunctions_3_3_Core *pGl, GLsizeiptr frameCapacity );
+    ~RingBuffer( );
+
+    /**
+     * @brief beginFrame Moves on to the region of the next frame, waiting until the GPU
+     *   has finished the frame that last used it
+     */
+    void beginFrame( );
+
+    /**
+     * @brief allocate Reserves a range of the region of the current frame
+     * @param size The number of bytes
+     * @param alignment The alignment of the offset, which may be at most 256 (or the
+     *   uniform buffer offset alignment, if that is larger)
+     */
+    Allocation allocate( GLsizeiptr size, GLsizeiptr alignment = 16 );
+
+    /**
+     * @brief allocateUniform Reserves a range that can be bound to a uniform block
+     */
+    Allocation allocateUniform( GLsizeiptr size ) { return allocate( size, uniformAlignment ); }
+
+    /**
+     * @brief bindUniform Binds an allocation to the given uniform block binding point
+     */
+    void bindUniform( GLuint binding, const Allocation& allocation );
+
+    /**
+     * @brief unmap Makes everything written so far available to OpenGL commands
+     */
+    void unmap( );
+
+    /**
+     * @brief endFrame Marks the end of the commands that read the current frame's data.
+     *   Call after the last draw call of the frame.
+     */
+    void endFrame( );
+
+    GLsizeiptr frameCapacity( ) const { return regionSize; }
+
+    /**
+     * @brief bytesWritten The number of bytes allocated in the last finished frame
+     */
+    GLsizeiptr bytesWritten( ) const { return lastBytesWritten; }
+
+    /**
+     * @brief fenceWaitNs The time (in ns) the last beginFrame( ) waited for the GPU
+     */
+    qint64 fenceWaitNs( ) const { return lastFenceWaitNs; }
+
+private:
+    void createBuffer( );
+    void grow( GLsizeiptr minSize );
+    void map( );
+
+    QOpenGLFunctions_3_3_Core *pGl;
+    GLuint buffer;
+    GLsizeiptr regionSize;
+    GLint uniformAlignment;
+    // The largest alignment of an allocation, of which the region size is a multiple
+    GLsizeiptr maxAlignment;
+
+    // The fence after the last frame that wrote each region, or null
+    GLsync fences[ NUM_FRAMES ];
+    int region;
+    // Relative to the start of the region
+    GLsizeiptr head;
+
+    // The mapped range starts at mapBegin (relative to the region). Null if unmapped.
+    char *pMapped;
+    GLsizeiptr mapBegin;
+    // Written to instead, in the unlikely case that the buffer could not be mapped
+    std::vector< char > scratch;
+
+    // Buffers replaced by a larger one, which are deleted once the frame is submitted
+    std::vector< GLuint > retiredBuffers;
+
+    GLsizeiptr bytesThisFrame;
+    GLsizeiptr lastBytesWritten;
+    qint64 lastFenceWaitNs;
+};
+
+#endif // RING_BUFFER_H
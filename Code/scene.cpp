@@ -0,0 +1,647 @@
+#include "scene.h"
+#include "math.h"
+#include "batch.h"
+#include "model.h"
+#include "material.h"
+#include "culling.h"
+#include "lod.h"
+#include "job_system.h"
+#include "profiler.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+// Documentation can be found in the scene.h file
+
+// The time that passes between frames
+static const float FRAME_TIME = 1000.0f / 60.0f;
+
+// The depths of the near and far plane of the projection
+static const float NEAR_PLANE = 0.001f;
+static const float FAR_PLANE = 100.0f;
+
+// The maximum number of levels of detail of the ball, including the full-detail one
+static const int NUM_BALL_LEVELS = 4;
+
+// The spike exaggeration of the main ball at the given time. The other balls use half of it.
+static float spikeAt( float time ) {
+    float ex1 = sin( 2.0f * M_PI * time / 700.0f );
+    float ex2 = sin( 2.0f * M_PI * time / 1100.0f + 100 );
+    return 3 + 2 * (float) ( abs( ex1 * ex2 ) + ex1 );
+}
+
+// The spike factor of a ball, from that of the main ball. Without the spike animation all
+// balls have a factor of 1, which leaves them as they are.
+static float ballSpike( float spike, int index, bool spiking ) {
+    return ( index == 0 || !spiking ) ? spike : spike / 2;
+}
+
+struct Light {
+    QVector3D position;
+    Color3D color;
+
+    Light( const QVector3D& position, const Color3D& color )
+        : position( position ), color( color ) { }
+};
+
+BuzzScene::BuzzScene( ) : useInstancing( true ), useIndexedBatches( true ), useCulling( true ),
+    useLevelsOfDetail( true ), useDeformCache( true ), useSpikes( true ), viewportHeight( 1 ), time( 0 ), frontFrame( 0 ), ballRadius( 1 ), numVisible( 0 ) { }
+
+BuzzScene::~BuzzScene( ) {
+    // The job refers to the graph and frames
+    JobSystem::instance( ).wait( frameJob );
+
+#ifdef BUZZ_PROFILING
+    Profiler::instance( ).release( );
+#endif
+}
+
+void BuzzScene::initialize( ) {
+    initializeOpenGLFunctions( );
+
+#ifdef BUZZ_PROFILING
+    Profiler::instance( ).initialize( this );
+#endif
+
+    // Enable depth buffer
+    glEnable(GL_DEPTH_TEST);
+
+    // Enable backface culling
+    glEnable(GL_CULL_FACE);
+
+    // Default is GL_LESS
+    glDepthFunc(GL_LEQUAL);
+
+    // Its lights decide which shader variants are prepared
+    lightGrid = std::make_unique< LightGrid >( this );
+    createShaderPrograms();
+
+    time = 0;
+
+    viewTransform.setTranslationZ( -10 );
+
+    setupLights( );
+
+    materialBuffer = std::make_unique< MaterialBuffer >( this );
+    buzzArena = BuzzBatch::createArena( this );
+    indexedBuzzArena = IndexedBuzzBatch::createArena( this );
+    textureLoader = std::make_unique< TextureLoader >( this );
+    setupAnimationBatches( );
+
+    // The main batch gets index 0, followed by the other batches in order
+    animationGraph.clear( );
+    animationGraph.add( mainBatch->animators );
+    for ( std::unique_ptr< AnimatedBatch >& batch : batches ) {
+        animationGraph.add( batch->animators );
+    }
+    ballLevels.assign( animationGraph.size( ), 0 );
+    levelCounts.assign( indexedBallBatches.size( ), 0 );
+
+    frontFrame = 0;
+    evaluateFrameAsync( time + FRAME_TIME );
+
+    // Sized for the instances of 64k balls, and grows when needed
+    ringBuffer = std::make_unique< RingBuffer >( this, 64 * 1024 * sizeof( BuzzInstance ) );
+    instancedRenderer = std::make_unique< InstancedRenderer >( this, *ringBuffer );
+    renderQueue = std::make_unique< RenderQueue >( this );
+}
+
+/**
+ * @brief BuzzScene::setupAnimationBatches set up several buzz balls
+ */
+void BuzzScene::setupAnimationBatches( ) {
+    Model modelBall( ":/models/buzzball.obj" );
+
+    qDebug( ) << modelBall.getNumTriangles( );
+
+    // The spikes extrude vertices radially, so the bounds are spheres around the origin
+    ballRadius = 0;
+    for ( const QVector3D& v : modelBall.getVertices( ) ) {
+        ballRadius = std::max( ballRadius, v.length( ) );
+    }
+
+    Material materialBase( this );
+    materialBase.ka = 0.5f;
+    materialBase.ks = 0.1f;
+    materialBase.kd = 0.9f;
+    materialBase.p = 16.0f;
+
+    // This should be a shared pointer, because in case it has
+    // textures they should only be deallocated upon true destruction
+    // (not applicable for this application - no textures)
+    std::shared_ptr< Material > pMaterialRed = std::make_shared< Material >( materialBase );
+    pMaterialRed->color = QVector3D( 1, 0, 0 );
+
+    std::shared_ptr< Material > pMaterialGreen = std::make_shared< Material >( materialBase );
+    pMaterialGreen->color = QVector3D( 0, 1, 0 );
+
+    std::shared_ptr< Material > pMaterialPurple = std::make_shared< Material >( materialBase );
+    pMaterialPurple->color = QVector3D( 0.5, 0, 0.5 );
+
+    std::shared_ptr< Material > pMaterialYellow = std::make_shared< Material >( materialBase );
+    pMaterialYellow->color = QVector3D( 1, 1, 0 );
+
+    std::shared_ptr< Material > pMaterialBlue = std::make_shared< Material >( materialBase );
+    pMaterialBlue->color = QVector3D( 0, 0, 1 );
+
+    materialBuffer->upload( { pMaterialRed, pMaterialGreen, pMaterialPurple, pMaterialYellow, pMaterialBlue } );
+
+    // Every level of detail is uploaded as both an unindexed and indexed batch
+    ballBatches.clear( );
+    indexedBallBatches.clear( );
+    for ( const BuzzMesh& mesh : buzzLevelsOfDetail( buzzMeshFromModel( modelBall ), NUM_BALL_LEVELS ) ) {
+        ballBatches.push_back( buzzBatchFromMesh( *buzzArena, mesh ) );
+        indexedBallBatches.push_back( indexedBuzzBatchFromMesh( *indexedBuzzArena, mesh ) );
+    }
+    std::shared_ptr< GeneralBatch > pBatchBall = useIndexedBatches ? indexedBallBatches[ 0 ] : ballBatches[ 0 ];
+
+    // Setup main batch
+    std::vector< std::shared_ptr< TransformAnimator > > noAnimation; // empty list
+    noAnimation.push_back( std::make_shared< ConstantAnimator >( Transform3f::Scale( 0.5 ) ) );
+
+    mainBatch = std::make_unique< AnimatedBatch >( pBatchBall, pMaterialRed, noAnimation );
+
+    // Setup several arbitrary orbiting bouncing balls
+    {
+        std::vector< std::shared_ptr< TransformAnimator > > animation;
+        animation.push_back( std::make_shared< ConstantAnimator >( Transform3f::Rotation( QVector3D( 0, 0, 45 ) ) ) );
+        animation.push_back( std::make_shared< RotationAnimator >( RotationAnimator( QVector3D( 0, 0.1, 0 ) ) ) );
+        animation.push_back( std::make_shared< ConstantAnimator >( Transform3f( 0.5, QVector3D( ), QVector3D( 3, 0, 0 ) ) ) );
+        batches.push_back( std::make_unique< AnimatedBatch >( pBatchBall, pMaterialGreen, animation ) );
+    }
+
+    {
+        std::vector< std::shared_ptr< TransformAnimator > > animation;
+        animation.push_back( std::make_shared< ConstantAnimator >( Transform3f::Rotation( QVector3D( 0, 0, 135 ) ) ) );
+        animation.push_back( std::make_shared< RotationAnimator >( RotationAnimator( QVector3D( 0, 0.07, 0.02 ) ) ) );
+        animation.push_back( std::make_shared< ConstantAnimator >( Transform3f( 0.5, QVector3D( ), QVector3D( 6, 0, 0 ) ) ) );
+        batches.push_back( std::make_unique< AnimatedBatch >( pBatchBall, pMaterialPurple, animation ) );
+    }
+
+    {
+        std::vector< std::shared_ptr< TransformAnimator > > animation;
+        animation.push_back( std::make_shared< BounceAnimator >( BounceAnimator( 0, 1, 0.001 ) ) );
+        animation.push_back( std::make_shared< ConstantAnimator >( Transform3f( 0.5, QVector3D( ), QVector3D( -5, 2, 1 ) ) ) );
+        batches.push_back( std::make_unique< AnimatedBatch >( pBatchBall, pMaterialYellow, animation ) );
+    }
+
+    {
+        std::vector< std::shared_ptr< TransformAnimator > > animation;
+        animation.push_back( std::make_shared< BounceAnimator >( BounceAnimator( 0, 1, 0.001 ) ) );
+        animation.push_back( std::make_shared< ConstantAnimator >( Transform3f( 0.5, QVector3D( ), QVector3D( 5, -3, 1 ) ) ) );
+        batches.push_back( std::make_unique< AnimatedBatch >( pBatchBall, pMaterialBlue, animation ) );
+    }
+
+    // Hands the coarser levels to all balls
+    setIndexedBatches( useIndexedBatches );
+}
+
+/**
+ * @brief BuzzScene::setIndexedBatches Switches all balls between the unindexed
+ *   and indexed buzz batch
+ */
+void BuzzScene::setIndexedBatches( bool indexed ) {
+    useIndexedBatches = indexed;
+    const std::vector< std::shared_ptr< GeneralBatch > >& levels = useIndexedBatches ? indexedBallBatches : ballBatches;
+
+    mainBatch->pBatch = levels[ 0 ];
+    mainBatch->lodBatches.assign( levels.begin( ) + 1, levels.end( ) );
+    for ( std::unique_ptr< AnimatedBatch >& batch : batches ) {
+        batch->pBatch = levels[ 0 ];
+        batch->lodBatches.assign( levels.begin( ) + 1, levels.end( ) );
+    }
+}
+
+// Reads a shader from the resources. Any '#include "file"' line is replaced
+// by the contents of that file, which should also be in the shaders directory.
+static QString loadShaderSource( const QString& file ) {
+    QFile shaderFile( ":/shaders/" + file );
+    if ( !shaderFile.open( QIODevice::ReadOnly | QIODevice::Text ) ) {
+        qDebug( ) << ":: Failed to open shader" << file;
+        return QString( );
+    }
+
+    QString source;
+    QTextStream in( &shaderFile );
+    while ( !in.atEnd( ) ) {
+        QString line = in.readLine( );
+        if ( line.startsWith( "#include \"" ) ) {
+            source += loadShaderSource( line.section( '"', 1, 1 ) );
+        } else {
+            source += line + "\n";
+        }
+    }
+    return source;
+}
+
+void BuzzScene::createShaderPrograms( ) {
+    BUZZ_PROFILE_CPU( "shaders.build" );
+
+    shaderPermutations = std::make_unique< ShaderPermutations >( this, loadShaderSource,
+        [this]( QOpenGLShaderProgram& program ) { configureProgram( program ); } );
+
+    // The variants drawn from the first frame on are compiled concurrently, and only
+    // waited for by finish( )
+    ProgramCache& programs = shaderPermutations->programCache( );
+    const ShaderPermutations::Features cached = ShaderPermutations::LIT | ShaderPermutations::POINT_LIGHTS;
+    addShader( BUZZ_SHADER, "buzz", "buzz" );
+    addShader( BUZZ_INSTANCED_SHADER, "buzz_instanced", "buzz" );
+    addShader( BUZZ_INDEXED_SHADER, "buzz_indexed", "buzz", "buzz" );
+    addShader( BUZZ_INDEXED_INSTANCED_SHADER, "buzz_indexed_instanced", "buzz", "buzz" );
+    addShader( BUZZ_CACHED_SHADER, "buzz_cached", "buzz", QString( ), cached );
+    addShader( BUZZ_CACHED_INSTANCED_SHADER, "buzz_cached_instanced", "buzz", QString( ), cached );
+    prepareShaders( );
+
+    // The deform shaders always extrude the spikes
+    const ShaderPermutations::Features deform = ShaderPermutations::SPIKES;
+    deformCache = std::make_unique< DeformCache >(
+        this, programs, ShaderPermutations::specialize( loadShaderSource( "buzz_deform_vertshader.glsl" ), deform ) );
+    indexedDeformCache = std::make_unique< DeformCache >(
+        this, programs, ShaderPermutations::specialize( loadShaderSource( "buzz_deform_indexed_vertshader.glsl" ), deform ),
+        ShaderPermutations::specialize( loadShaderSource( "buzz_deform_geomshader.glsl" ), deform ) );
+
+    shaderPermutations->finish( );
+    qDebug( ) << ":: Shader programs:" << programs.numLoaded( ) << "loaded from the cache,"
+              << programs.numCompiled( ) << "compiled";
+}
+
+/**
+ * @brief BuzzScene::addShader Registers a shader of which the variants can be drawn
+ */
+void BuzzScene::addShader( BuzzShader shader, const QString& vertexName, const QString& fragmentName,
+                           const QString& geometryName, ShaderPermutations::Features features ) {
+    buzzShaders[ shader ] = shaderPermutations->addShader(
+        vertexName + "_vertshader.glsl", fragmentName + "_fragshader.glsl",
+        geometryName.isEmpty( ) ? QString( ) : geometryName + "_geomshader.glsl", features );
+}
+
+/**
+ * @brief BuzzScene::prepareShaders Starts building the variants of all shaders that the lit
+ *   balls are drawn with in the current state, of which the spikes and point lights are
+ *   toggled at run time. Those are then finished before the next frame streams its data.
+ */
+void BuzzScene::prepareShaders( ) {
+    ShaderPermutations::Features features = ShaderPermutations::LIT;
+    if ( !lightGrid->lights( ).empty( ) ) {
+        features |= ShaderPermutations::POINT_LIGHTS;
+    }
+    for ( int shader = 0; shader < NUM_BUZZ_SHADERS; shader++ ) {
+        // Balls with a spike factor of 1 are drawn without the spikes, also while spiking
+        shaderPermutations->prepare( buzzShaders[ shader ], features );
+        if ( useSpikes ) {
+            shaderPermutations->prepare( buzzShaders[ shader ], features | ShaderPermutations::SPIKES );
+        }
+    }
+}
+
+/**
+ * @brief BuzzScene::configureProgram Binds the uniform blocks and samplers of a linked
+ *   program to their binding points and texture units
+ */
+void BuzzScene::configureProgram( QOpenGLShaderProgram& program ) {
+    // Resolve everything that is looked up by name once, instead of every frame
+    const GLuint programId = program.programId( );
+    const std::pair< const char *, GLuint > blocks[] = {
+        { "Lights", UB_LIGHTS }, { "Camera", UB_CAMERA }, { "Material", UB_MATERIAL }, { "Object", UB_OBJECT },
+        { "LightGrid", UB_LIGHT_GRID }
+    };
+    for ( const auto& block : blocks ) {
+        GLuint blockIndex = glGetUniformBlockIndex( programId, block.first );
+        if ( blockIndex != GL_INVALID_INDEX ) {
+            glUniformBlockBinding( programId, blockIndex, block.second );
+        }
+    }
+
+    // The texture units of the materials and the light grid are fixed
+    program.bind( );
+    program.setUniformValue( "u_diffuseTex", 0 );
+    program.setUniformValue( "u_normalTex", 1 );
+    program.setUniformValue( "u_specularTex", 2 );
+    program.setUniformValue( "u_lightData", TU_LIGHT_DATA );
+    program.setUniformValue( "u_lightClusters", TU_LIGHT_CLUSTERS );
+    program.setUniformValue( "u_lightIndices", TU_LIGHT_INDICES );
+    program.release( );
+}
+
+/**
+ * @brief BuzzScene::featuresOf Returns the cheapest shader variant that draws a ball with
+ *   the given spike factor and material. A spike factor of 1 leaves the model as is.
+ */
+ShaderPermutations::Features BuzzScene::featuresOf( float spike, const Material& material ) const {
+    ShaderPermutations::Features features = 0;
+    if ( spike != 1 ) {
+        features |= ShaderPermutations::SPIKES;
+    }
+    if ( material.isLit ) {
+        features |= ShaderPermutations::LIT;
+        if ( !lightGrid->lights( ).empty( ) ) {
+            features |= ShaderPermutations::POINT_LIGHTS;
+        }
+    }
+    return features;
+}
+
+// --- OpenGL drawing
+
+/**
+ * @brief BuzzScene::setupLights Sets up the lights in the scene, which are
+ *   shared by all programs through the 'Lights' uniform block
+ */
+void BuzzScene::setupLights( ) {
+    const Light lights[ NUM_LIGHTS ] = {
+        Light( QVector3D( -5, 0, 3 ), Color3D( 0.3, 0.2, 0.5 ) ),
+        Light( QVector3D( 10, 0, 10 ), Color3D( 0.1, 0.35, 0.1 ) ),
+        Light( QVector3D( -10, 0, -10 ), Color3D( 0.3, 0.25, 0.1 ) )
+    };
+
+    lightsBlock = LightsBlock( );
+    for ( int i = 0; i < NUM_LIGHTS; i++ ) {
+        for ( int c = 0; c < 3; c++ ) {
+            lightsBlock.lights[ i ].position[ c ] = lights[ i ].position[ c ];
+            lightsBlock.lights[ i ].color[ c ] = lights[ i ].color[ c ];
+        }
+    }
+}
+
+/**
+ * @brief BuzzScene::writeSceneUniforms Writes the lights and camera of this frame to the
+ *   ring buffer, and binds them to the 'Lights', 'Camera' and 'LightGrid' uniform blocks,
+ *   which are shared by all programs. The point lights are streamed through it as well.
+ */
+void BuzzScene::writeSceneUniforms( ) {
+    LightGridBlock gridBlock;
+    lightGrid->upload( *ringBuffer, gridBlock );
+
+    RingBuffer::Allocation lights = ringBuffer->allocateUniform( sizeof( LightsBlock ) );
+    std::memcpy( lights.pData, &lightsBlock, sizeof( LightsBlock ) );
+    ringBuffer->bindUniform( UB_LIGHTS, lights );
+
+    RingBuffer::Allocation camera = ringBuffer->allocateUniform( sizeof( CameraBlock ) );
+    CameraBlock& block = *static_cast< CameraBlock * >( camera.pData );
+    QMatrix4x4 viewMat = viewTransform.matrix( );
+    std::copy( projectionMat.constData( ), projectionMat.constData( ) + 16, block.projectionMat );
+    std::copy( viewMat.constData( ), viewMat.constData( ) + 16, block.viewMat );
+    ringBuffer->bindUniform( UB_CAMERA, camera );
+
+    RingBuffer::Allocation grid = ringBuffer->allocateUniform( sizeof( LightGridBlock ) );
+    std::memcpy( grid.pData, &gridBlock, sizeof( LightGridBlock ) );
+    ringBuffer->bindUniform( UB_LIGHT_GRID, grid );
+}
+
+/**
+ * @brief BuzzScene::render
+ *
+ * Draws the scene to the currently bound framebuffer
+ *
+ */
+void BuzzScene::render() {
+    BUZZ_PROFILE_FRAME( );
+
+    time += FRAME_TIME;
+
+    {
+        BUZZ_PROFILE_CPU( "animation.wait" );
+        JobSystem::instance( ).wait( frameJob );
+    }
+    frontFrame = 1 - frontFrame;
+    const FrameData& frame = frames[ frontFrame ];
+    const TransformBuffer& transforms = frame.transforms;
+
+    // The next frame is evaluated while this one is submitted
+    evaluateFrameAsync( time + FRAME_TIME );
+
+    {
+        BUZZ_PROFILE_CPU( "texture.upload" );
+        textureLoader->update( );
+    }
+
+    ringBuffer->beginFrame( );
+
+    {
+        BUZZ_PROFILE_CPU( "culling" );
+        if ( useCulling ) {
+            frame.bvh.cull( Frustum( projectionMat * viewTransform.matrix( ) ), visibleIndices );
+            // Keeps the main ball first, and the batches in memory order
+            std::sort( visibleIndices.begin( ), visibleIndices.end( ) );
+        } else {
+            visibleIndices.resize( frame.bvh.size( ) );
+            for ( int i = 0; i < frame.bvh.size( ); i++ ) {
+                visibleIndices[ i ] = i;
+            }
+        }
+        numVisible = int( visibleIndices.size( ) );
+    }
+
+    {
+        BUZZ_PROFILE_CPU( "lod.select" );
+        selectLevels( frame );
+    }
+
+    {
+        BUZZ_PROFILE_CPU( "lights.bin" );
+        lightGrid->build( viewTransform.matrix( ), projectionMat, FAR_PLANE );
+    }
+
+    // Set the color of the screen to be blue on clear (new frame)
+    glClearColor( abs( sin( 2.0f * M_PI * time * 5 / 100000.0f ) )
+                , abs( sin( 2.0f * M_PI * time * 7 / 100000.0f ) )
+                , abs( sin( 2.0f * M_PI * time * 19 / 100000.0f ) )
+                , 1.0f);
+
+    // Clear the screen before rendering
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // spike exageration
+    float spike = frame.spiking ? spikeAt( time ) : 1;
+
+    // With the deform cache, the balls that share their level of detail and spike factor
+    // are drawn from the same deformed batch. The deform passes bind their own program and
+    // VAO, and run before the ring buffer is mapped.
+    {
+        BUZZ_PROFILE_GPU( "deform" );
+        DeformCache& cache = useIndexedBatches ? *indexedDeformCache : *deformCache;
+        cache.beginFrame( );
+        visibleBatches.resize( visibleIndices.size( ) );
+        for ( size_t i = 0; i < visibleIndices.size( ); i++ ) {
+            const int index = visibleIndices[ i ];
+            const std::shared_ptr< GeneralBatch >& pBatch = batchAt( index ).levelBatch( ballLevels[ index ] );
+            visibleBatches[ i ] = useDeformCache ? cache.deform( *pBatch, ballSpike( spike, index, frame.spiking ) ) : pBatch;
+        }
+    }
+
+    BuzzShader shader;
+    if ( useDeformCache ) {
+        shader = useInstancing ? BUZZ_CACHED_INSTANCED_SHADER : BUZZ_CACHED_SHADER;
+    } else if ( useIndexedBatches ) {
+        shader = useInstancing ? BUZZ_INDEXED_INSTANCED_SHADER : BUZZ_INDEXED_SHADER;
+    } else {
+        shader = useInstancing ? BUZZ_INSTANCED_SHADER : BUZZ_SHADER;
+    }
+
+    // The variant of every ball. Any variant not prepared by prepareShaders( ) is built
+    // here, as the ring buffer is not mapped yet. The features the shader ignores are
+    // masked out, such that balls that only differ in those share a variant (e.g. the
+    // spiked and unspiked balls of the deform cache).
+    // A bit for every variant that has balls to draw
+    uint32_t variants = 0;
+    visibleFeatures.resize( visibleIndices.size( ) );
+    for ( size_t i = 0; i < visibleIndices.size( ); i++ ) {
+        const int index = visibleIndices[ i ];
+        visibleFeatures[ i ] = shaderPermutations->resolve(
+            buzzShaders[ shader ], featuresOf( ballSpike( spike, index, frame.spiking ), *batchAt( index ).pMaterial ) );
+        variants |= 1u << visibleFeatures[ i ];
+    }
+    {
+        BUZZ_PROFILE_CPU( "shaders.finish" );
+        for ( ShaderPermutations::Features variant = 0; ( variants >> variant ) != 0; variant++ ) {
+            if ( variants & ( 1u << variant ) ) {
+                shaderPermutations->prepare( buzzShaders[ shader ], variant );
+            }
+        }
+        shaderPermutations->finish( );
+    }
+
+    // The lights and camera are the same for all programs
+    {
+        BUZZ_PROFILE_GPU( "uniform.buffers" );
+        writeSceneUniforms( );
+    }
+
+    if ( useInstancing ) {
+        // The balls are drawn by one variant at a time, such that all balls that need the
+        // same variant (typically all of them) still share a single draw call
+        uint32_t remaining = variants;
+        for ( ShaderPermutations::Features variant = 0; remaining != 0; variant++ ) {
+            if ( !( remaining & ( 1u << variant ) ) ) {
+                continue;
+            }
+            remaining &= ~( 1u << variant );
+            shaderPermutations->program( buzzShaders[ shader ], variant ).bind( );
+
+            {
+                BUZZ_PROFILE_CPU( "instancing.add" );
+                for ( size_t i = 0; i < visibleIndices.size( ); i++ ) {
+                    if ( visibleFeatures[ i ] != variant ) {
+                        continue;
+                    }
+                    const int index = visibleIndices[ i ];
+                    instancedRenderer->add( visibleBatches[ i ], *batchAt( index ).pMaterial, transforms.modelMats[ index ],
+                                            transforms.normalMats[ index ], ballSpike( spike, index, frame.spiking ) );
+                }
+            }
+            instancedRenderer->render( );
+        }
+    } else {
+        // All parameters are written before the first draw, as the ring buffer is unmapped once.
+        // The queue then draws the balls sorted by their state, and front to back. Every ball
+        // is drawn by the cheapest variant for its spike factor and material.
+        {
+            BUZZ_PROFILE_CPU( "object.write" );
+            const QMatrix4x4 viewMat = viewTransform.matrix( );
+            for ( size_t i = 0; i < visibleIndices.size( ); i++ ) {
+                const int index = visibleIndices[ i ];
+                const float ballSpikeFactor = ballSpike( spike, index, frame.spiking );
+                Material *pMaterial = batchAt( index ).pMaterial.get( );
+                const GLuint program = shaderPermutations->program( buzzShaders[ shader ], visibleFeatures[ i ] ).programId( );
+                RingBuffer::Allocation object = AnimatedBatch::writeObject( *ringBuffer, transforms.modelMats[ index ],
+                                                                            transforms.normalMats[ index ], ballSpikeFactor );
+                // The camera looks along -z
+                const float depth = -viewMat.map( frame.bounds[ index ].center ).z( );
+                renderQueue->add( program, visibleBatches[ i ].get( ), pMaterial, object, depth );
+            }
+            ringBuffer->unmap( );
+        }
+        renderQueue->submit( );
+    }
+
+    ringBuffer->endFrame( );
+}
+
+/**
+ * @brief BuzzScene::batchAt Returns the batch with the given index in the animation
+ *   graph; the main batch has index 0
+ */
+AnimatedBatch& BuzzScene::batchAt( int index ) {
+    return ( index == 0 ) ? *mainBatch : *batches[ index - 1 ];
+}
+
+/**
+ * @brief BuzzScene::evaluateFrameAsync Starts a job that evaluates the transforms and
+ *   bounds of all batches into the back frame
+ */
+void BuzzScene::evaluateFrameAsync( float atTime ) {
+    FrameData *pBack = &frames[ 1 - frontFrame ];
+    // Read by the job, which does not run yet
+    pBack->spiking = useSpikes;
+    JobSystem::instance( ).submit( [this, atTime, pBack]( ) {
+        animationGraph.evaluate( atTime, pBack->transforms );
+        updateBounds( pBack->spiking ? spikeAt( atTime ) : 1, *pBack );
+        pBack->bvh.build( pBack->bounds );
+    }, frameJob );
+}
+
+/**
+ * @brief BuzzScene::updateBounds Computes the bounding sphere of every batch from its
+ *   model matrix. Runs within a job.
+ *
+ * A vertex at distance d from the origin is extruded to distance max( 1, d^spike ), so the
+ *   ball is enclosed by a sphere of radius max( 1, ballRadius^spike ) around its origin.
+ */
+void BuzzScene::updateBounds( float spike, FrameData& frame ) const {
+    const float mainRadius = std::max( 1.0f, std::pow( ballRadius, spike ) );
+    const float radius = std::max( 1.0f, std::pow( ballRadius, ballSpike( spike, 1, frame.spiking ) ) );
+
+    const std::vector< QMatrix4x4 >& modelMats = frame.transforms.modelMats;
+    frame.bounds.resize( modelMats.size( ) );
+    JobSystem::instance( ).parallelFor( int( modelMats.size( ) ), 4096, [&]( int begin, int end ) {
+        for ( int i = begin; i < end; i++ ) {
+            const float *m = modelMats[ i ].constData( );
+            // The largest scale along any axis is the longest column
+            float maxScaleSquared = 0;
+            for ( int c = 0; c < 3; c++ ) {
+                maxScaleSquared = std::max( maxScaleSquared, m[ c * 4 ] * m[ c * 4 ] + m[ c * 4 + 1 ] * m[ c * 4 + 1 ] + m[ c * 4 + 2 ] * m[ c * 4 + 2 ] );
+            }
+            BoundingSphere& sphere = frame.bounds[ i ];
+            sphere.center = QVector3D( m[ 12 ], m[ 13 ], m[ 14 ] );
+            sphere.radius = ( ( i == 0 ) ? mainRadius : radius ) * std::sqrt( maxScaleSquared );
+        }
+    } );
+}
+
+/**
+ * @brief BuzzScene::selectLevels Picks the level of detail of every visible ball from
+ *   the size of its bounding sphere on screen
+ */
+void BuzzScene::selectLevels( const FrameData& frame ) {
+    std::fill( levelCounts.begin( ), levelCounts.end( ), 0 );
+
+    const QMatrix4x4 viewMat = viewTransform.matrix( );
+    // The number of pixels covered by a unit length at unit distance from the camera
+    const float pixelsPerUnit = projectionMat( 1, 1 ) * viewportHeight / 2;
+    const int numLevels = int( levelCounts.size( ) );
+
+    for ( int index : visibleIndices ) {
+        int level = 0;
+        if ( useLevelsOfDetail ) {
+            const BoundingSphere& sphere = frame.bounds[ index ];
+            const float depth = -viewMat.map( sphere.center ).z( );
+            // A ball around the camera is as large as it gets
+            const float pixelRadius = ( depth > 0 ) ? sphere.radius * pixelsPerUnit / depth : std::numeric_limits< float >::max( );
+            level = selectLevelOfDetail( pixelRadius, ballLevels[ index ], numLevels );
+        }
+        ballLevels[ index ] = level;
+        levelCounts[ level ]++;
+    }
+}
+
+void BuzzScene::resize( int width, int height ) {
+    viewportHeight = height;
+    projectionMat.setToIdentity( );
+    projectionMat.perspective( 60, (float) width / (float) height, NEAR_PLANE, FAR_PLANE );
+}
@@ -0,0 +1,265 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "animation.h"
+#include "animation_graph.h"
+#include "culling.h"
+#include "deform_cache.h"
+#include "instancing.h"
+#include "job_system.h"
+#include "light_grid.h"
+#include "program_cache.h"
+#include "render_queue.h"
+#include "ring_buffer.h"
+#include "shader_permutations.h"
+#include "texture_loader.h"
+#include "transform.h"
+#include "uniforms.h"
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The BuzzScene class contains the buzz ball scene, together with everything that
+ *   is needed to render it. It renders to the currently bound framebuffer, such that it
+ *   can be shown in the MainView, as well as rendered headless to an offscreen surface.
+ *
+ * Note that all functions, except for the constructor, require the OpenGL context
+ *   in which the scene was initialised to be current.
+ */
+class BuzzScene : public QOpenGLFunctions_3_3_Core {
+public:
+    BuzzScene( );
+    ~BuzzScene( );
+
+    /**
+     * @brief initialize Sets up the OpenGL state, shaders and batches of the scene
+     */
+    void initialize( );
+
+    /**
+     * @brief resize Updates the projection to the new size of the framebuffer
+     * @param width The width of the framebuffer, in pixels
+     * @param height The height of the framebuffer, in pixels
+     */
+    void resize( int width, int height );
+
+    /**
+     * @brief render Advances the animation by a fixed timestep of one 60 Hz frame,
+     *   and renders the scene at that time
+     */
+    void render( );
+
+    bool isInstancing( ) const { return useInstancing; }
+    void setInstancing( bool instancing ) { useInstancing = instancing; }
+
+    bool isIndexedBatches( ) const { return useIndexedBatches; }
+    /**
+     * @brief setIndexedBatches Switches all balls between the unindexed
+     *   and indexed buzz batch
+     */
+    void setIndexedBatches( bool indexed );
+
+    bool isCulling( ) const { return useCulling; }
+    /**
+     * @brief setCulling Enables or disables frustum culling of the balls
+     */
+    void setCulling( bool culling ) { useCulling = culling; }
+
+    /**
+     * @brief visibleCount The number of balls drawn in the last frame
+     */
+    int visibleCount( ) const { return numVisible; }
+    /**
+     * @brief culledCount The number of balls skipped by frustum culling in the last frame
+     */
+    int culledCount( ) const { return animationGraph.size( ) - numVisible; }
+
+    bool isLevelsOfDetail( ) const { return useLevelsOfDetail; }
+    /**
+     * @brief setLevelsOfDetail Enables or disables drawing distant balls with a coarser mesh
+     */
+    void setLevelsOfDetail( bool levelsOfDetail ) { useLevelsOfDetail = levelsOfDetail; }
+
+    /**
+     * @brief levelOfDetailCounts The number of balls drawn with every level of detail in the last
+     *   frame, from fine to coarse
+     */
+    const std::vector< int >& levelOfDetailCounts( ) const { return levelCounts; }
+
+    bool isSpiking( ) const { return useSpikes; }
+    /**
+     * @brief setSpiking Enables or disables the spike animation. Without it, the balls are
+     *   drawn by the shader variants without the spike extrusion.
+     */
+    void setSpiking( bool spiking ) { useSpikes = spiking; }
+
+    bool isDeformCaching( ) const { return useDeformCache; }
+    /**
+     * @brief setDeformCaching Enables or disables deforming the ball once per distinct
+     *   level of detail and spike factor, instead of once per ball
+     */
+    void setDeformCaching( bool caching ) { useDeformCache = caching; }
+
+    /**
+     * @brief deformations The deform cache of the current batches, which reports how many
+     *   deform passes the last frame took
+     */
+    const DeformCache& deformations( ) const { return useIndexedBatches ? *indexedDeformCache : *deformCache; }
+
+    /**
+     * @brief dynamicData The buffer through which all per-frame data is streamed, which
+     *   reports how much is written and how long the GPU is waited for
+     */
+    const RingBuffer& dynamicData( ) const { return *ringBuffer; }
+
+    /**
+     * @brief textures Loads textures (e.g. of materials) in the background. Those that are
+     *   ready are uploaded at the start of every frame. Only available after initialize( ).
+     */
+    TextureLoader& textures( ) { return *textureLoader; }
+
+    /**
+     * @brief drawStats The number of draws of the last non-instanced frame, and the state
+     *   changes made and avoided by sorting them
+     */
+    const RenderQueue::Stats& drawStats( ) const { return renderQueue->stats( ); }
+
+    /**
+     * @brief prepareShaders Starts building the shader variants needed after the spikes
+     *   or point lights were toggled, such that the next frame only waits for them if they
+     *   are not done by then. The context must be current.
+     */
+    void prepareShaders( );
+
+    /**
+     * @brief shaderVariants The number of shader variants built so far
+     */
+    int shaderVariants( ) const { return shaderPermutations->numPrograms( ); }
+
+    /**
+     * @brief pointLights The point lights of the scene, besides the global lights. They
+     *   are binned into clusters of the view every frame. Only available after initialize( ).
+     */
+    LightGrid& pointLights( ) { return *lightGrid; }
+    const LightGrid& pointLights( ) const { return *lightGrid; }
+
+private:
+    // The shaders the balls can be drawn with, each of which has variants by feature
+    enum BuzzShader {
+        BUZZ_SHADER,
+        BUZZ_INSTANCED_SHADER,
+        BUZZ_INDEXED_SHADER,
+        BUZZ_INDEXED_INSTANCED_SHADER,
+        // Draw the balls deformed by the deform caches
+        BUZZ_CACHED_SHADER,
+        BUZZ_CACHED_INSTANCED_SHADER,
+        NUM_BUZZ_SHADERS
+    };
+
+    void createShaderPrograms( );
+    void addShader( BuzzShader shader, const QString& vertexName, const QString& fragmentName,
+                    const QString& geometryName = QString( ),
+                    ShaderPermutations::Features features = ShaderPermutations::ALL_FEATURES );
+    void configureProgram( QOpenGLShaderProgram& program );
+    ShaderPermutations::Features featuresOf( float spike, const Material& material ) const;
+
+    void setupAnimationBatches( );
+
+    void setupLights( );
+    void writeSceneUniforms( );
+
+    /**
+     * @brief The FrameData struct holds everything computed ahead of rendering a frame
+     */
+    struct FrameData {
+        TransformBuffer transforms;
+        std::vector< BoundingSphere > bounds;
+        BoundingVolumeHierarchy bvh;
+        // Whether the spikes are animated in this frame
+        bool spiking;
+    };
+
+    void evaluateFrameAsync( float atTime );
+    void updateBounds( float spike, FrameData& frame ) const;
+    void selectLevels( const FrameData& frame );
+    AnimatedBatch& batchAt( int index );
+
+    // The variants of every BuzzShader, which are prepared ahead of drawing them
+    std::unique_ptr< ShaderPermutations > shaderPermutations;
+    int buzzShaders[ NUM_BUZZ_SHADERS ];
+
+    // Written to the ring buffer every frame, along with the camera
+    LightsBlock lightsBlock;
+    std::unique_ptr< LightGrid > lightGrid;
+
+    std::unique_ptr< MaterialBuffer > materialBuffer;
+
+    bool useInstancing;
+    bool useIndexedBatches;
+    bool useCulling;
+    bool useLevelsOfDetail;
+    bool useDeformCache;
+    bool useSpikes;
+
+    int viewportHeight;
+
+    QMatrix4x4 projectionMat;
+    Transform3f viewTransform;
+
+    float time;
+
+    // All levels of detail of the ball share the VAO of their arena. The arenas outlive
+    // the batches, which are allocated in them.
+    std::unique_ptr< MeshArena > buzzArena;
+    std::unique_ptr< MeshArena > indexedBuzzArena;
+
+    // The main batch is kept separately, because it has a different 'u_spike' value.
+    std::unique_ptr< AnimatedBatch > mainBatch;
+    std::vector< std::unique_ptr< AnimatedBatch > > batches;
+
+    // The animations of all batches; see initialize( ) for the indices
+    AnimationGraph animationGraph;
+
+    // The frames are double-buffered. The render thread reads the front frame, while
+    // a job of the JobSystem fills the other one for the next frame.
+    FrameData frames[ 2 ];
+    int frontFrame;
+    JobCounter frameJob;
+
+    // The largest distance of a vertex of the ball model to its origin
+    float ballRadius;
+
+    // The indices (in the animation graph) of the batches drawn this frame
+    std::vector< int > visibleIndices;
+    int numVisible;
+
+    // The levels of detail of the ball model, both as unindexed and indexed buzz batch
+    std::vector< std::shared_ptr< GeneralBatch > > ballBatches;
+    std::vector< std::shared_ptr< GeneralBatch > > indexedBallBatches;
+
+    // The level of detail every ball was last drawn with, by index in the animation graph
+    std::vector< int > ballLevels;
+    std::vector< int > levelCounts;
+
+    // For the unindexed and indexed buzz batches respectively
+    std::unique_ptr< DeformCache > deformCache;
+    std::unique_ptr< DeformCache > indexedDeformCache;
+    // The batch every visible ball is drawn with this frame, by position in visibleIndices
+    std::vector< std::shared_ptr< GeneralBatch > > visibleBatches;
+    // The shader variant every visible ball is drawn with this frame, for the instanced path
+    std::vector< ShaderPermutations::Features > visibleFeatures;
+
+    // Outlives the instanced renderer, which refers to it
+    std::unique_ptr< RingBuffer > ringBuffer;
+    // Sorts the draws of the non-instanced path
+    std::unique_ptr< RenderQueue > renderQueue;
+
+    std::unique_ptr< InstancedRenderer > instancedRenderer;
+    std::unique_ptr< TextureLoader > textureLoader;
+};
+
+#endif // SCENE_H
@@ -0,0 +1,87 @@
+#include "shader_permutations.h"
+#include "uniforms.h"
+
+#include <QDebug>
+
+// Documentation can be found in the shader_permutations.h file
+
+ShaderPermutations::ShaderPermutations( QOpenGLFunctions_3_3_Core *pGl, const SourceLoader& loadSource,
+                                        const ProgramCache::Configure& configure )
+    : loadSource( loadSource ),
+      configure( configure ),
+      programs( pGl ),
+      hasPending( false ) { }
+
+QString ShaderPermutations::specialize( const QString& source, Features features ) {
+    QString defines = QString( "#define BUZZ_NUM_LIGHTS %1\n" ).arg( NUM_LIGHTS );
+    if ( features & SPIKES ) {
+        defines += "#define BUZZ_SPIKES\n";
+    }
+    if ( features & LIT ) {
+        defines += "#define BUZZ_LIT\n";
+    }
+    if ( features & POINT_LIGHTS ) {
+        defines += "#define BUZZ_POINT_LIGHTS\n";
+    }
+
+    // The #version line has to come first
+    const int lineEnd = source.indexOf( '\n' );
+    if ( !source.startsWith( "#version" ) || lineEnd < 0 ) {
+        return defines + source;
+    }
+    QString specialized = source;
+    return specialized.insert( lineEnd + 1, defines );
+}
+
+int ShaderPermutations::addShader( const QString& vertexFile, const QString& fragmentFile, const QString& geometryFile,
+                                   Features features ) {
+    Shader shader;
+    shader.vertex = loadSource( vertexFile );
+    shader.fragment = loadSource( fragmentFile );
+    if ( !geometryFile.isEmpty( ) ) {
+        shader.geometry = loadSource( geometryFile );
+    }
+    shader.features = features;
+    shaders.push_back( shader );
+    return int( shaders.size( ) ) - 1;
+}
+
+void ShaderPermutations::prepare( int shader, Features features ) {
+    const Shader& source = shaders[ shader ];
+    features = resolve( shader, features );
+    std::unique_ptr< QOpenGLShaderProgram >& pProgram = variants[ keyOf( shader, features ) ];
+    if ( pProgram ) {
+        return;
+    }
+    pProgram = std::make_unique< QOpenGLShaderProgram >( );
+
+    ProgramCache::Sources sources;
+    sources.vertex = specialize( source.vertex, features );
+    sources.fragment = specialize( source.fragment, features );
+    if ( !source.geometry.isEmpty( ) ) {
+        sources.geometry = specialize( source.geometry, features );
+    }
+    programs.add( *pProgram, sources, configure );
+    hasPending = true;
+}
+
+bool ShaderPermutations::finish( ) {
+    hasPending = false;
+    return programs.finish( );
+}
+
+QOpenGLShaderProgram& ShaderPermutations::program( int shader, Features features ) {
+    features = resolve( shader, features );
+    auto it = variants.find( keyOf( shader, features ) );
+    if ( it == variants.end( ) ) {
+        // Stalls the frame it is first drawn in, though only for as long as a binary takes to
+        // load after the first launch
+        qDebug( ) << ":: Building variant" << features << "of shader" << shader << "that was not prepared";
+        prepare( shader, features );
+        it = variants.find( keyOf( shader, features ) );
+    }
+    if ( hasPending ) {
+        finish( );
+    }
+    return *it->second;
+}
@@ -0,0 +1,138 @@
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include "program_cache.h"
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <QString>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief The ShaderPermutations class builds the variants of shaders that differ in the
+ *   features they support, which are switched by #defines.
+ *
+ * A shader is a combination of stages, registered by addShader( ). Each of its variants
+ *   (permutations) is the shader with a set of Features, of which the BUZZ_ #defines are
+ *   inserted after the #version line of every stage. Code that the variant does not need
+ *   is thus removed entirely by the compiler, rather than skipped at run time.
+ *
+ * Variants are only built once asked for, and are kept by their shader and features.
+ *   Features a shader does not use are ignored, such that they do not lead to duplicates.
+ *   All variants are built through a single ProgramCache, so they are loaded from disk
+ *   after the first launch. Variants should be prepared before they are drawn, such that
+ *   they are compiled concurrently, and finished before the frame starts streaming its
+ *   data; only a variant that was not prepared is built (and waited for) when drawn.
+ *
+ * Note that this class can only be used after OpenGL is initialised
+ */
+class ShaderPermutations {
+public:
+    enum Feature {
+        // Extrudes the spikes by the spike factor. Without it, the model is drawn as is,
+        // which equals a spike factor of 1.
+        SPIKES = 1 << 0,
+        // Lights the surface by the global lights. Without it, the surface is drawn in
+        // the color of its material.
+        LIT = 1 << 1,
+        // Also lights the surface by the point lights of the LightGrid
+        POINT_LIGHTS = 1 << 2
+    };
+    typedef uint32_t Features;
+    static const Features ALL_FEATURES = SPIKES | LIT | POINT_LIGHTS;
+
+    // Returns the source of a shader file, with its includes resolved
+    typedef std::function< QString( const QString& ) > SourceLoader;
+
+    /**
+     * @brief ShaderPermutations Prepares to build the variants of shaders
+     * @param pGl The functions of the context
+     * @param loadSource Loads the files of the stages
+     * @param configure Called for every variant once it is linked
+     */
+    ShaderPermutations( QOpenGLFunctions_3_3_Core *pGl, const SourceLoader& loadSource,
+                        const ProgramCache::Configure& configure );
+
+    /**
+     * @brief addShader Registers a shader, of which the variants can then be built
+     * @param vertexFile The file of the vertex stage
+     * @param fragmentFile The file of the fragment stage
+     * @param geometryFile The file of the geometry stage, which may be empty
+     * @param features The features the shader supports; any others are ignored
+     * @return The shader, to pass to prepare( ) and program( )
+     */
+    int addShader( const QString& vertexFile, const QString& fragmentFile, const QString& geometryFile = QString( ),
+                   Features features = ALL_FEATURES );
+
+    /**
+     * @brief resolve Returns the features of the variant that is built for the given ones,
+     *   without those the shader ignores. Balls of which the features resolve the same are
+     *   drawn by the same variant.
+     */
+    Features resolve( int shader, Features features ) const { return features & shaders[ shader ].features; }
+
+    /**
+     * @brief prepare Starts building a variant, unless it already exists. It cannot be
+     *   drawn before finish( ).
+     */
+    void prepare( int shader, Features features );
+
+    /**
+     * @brief finish Waits for all variants (and other programs of programCache( )) that
+     *   were prepared since the last call. Returns immediately if there are none.
+     * @return Whether all of them were linked
+     */
+    bool finish( );
+
+    /**
+     * @brief program Returns a variant of a shader. A variant that was not prepared is
+     *   built and waited for, as are all others that are not finished yet.
+     */
+    QOpenGLShaderProgram& program( int shader, Features features );
+
+    /**
+     * @brief programCache The cache the variants are built through, which may also be used
+     *   to build other programs along with them
+     */
+    ProgramCache& programCache( ) { return programs; }
+
+    /**
+     * @brief numPrograms The number of variants built so far
+     */
+    int numPrograms( ) const { return int( variants.size( ) ); }
+
+    /**
+     * @brief specialize Inserts the #defines of the features after the #version line of
+     *   a source, along with BUZZ_NUM_LIGHTS
+     */
+    static QString specialize( const QString& source, Features features );
+
+private:
+    struct Shader {
+        QString vertex;
+        QString geometry;
+        QString fragment;
+        Features features;
+    };
+
+    static uint64_t keyOf( int shader, Features features ) {
+        return ( uint64_t( shader ) << 32 ) | features;
+    }
+
+    SourceLoader loadSource;
+    ProgramCache::Configure configure;
+
+    std::vector< Shader > shaders;
+    std::unordered_map< uint64_t, std::unique_ptr< QOpenGLShaderProgram > > variants;
+
+    // Declared after the variants, as it may still finish them when destroyed
+    ProgramCache programs;
+    // Whether variants were prepared since the last finish( )
+    bool hasPending;
+};
+
+#endif // SHADER_PERMUTATIONS_H
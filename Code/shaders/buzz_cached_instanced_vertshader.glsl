@@ -0,0 +1,27 @@
+#version 330 core
+
+// This is the instanced variant of the cached buzz vertex shader. The spike
+// factor of the instances is already applied by the deform shader.
+
+#include "buzz_common.glsl"
+
+// -- Input attributes, as captured from the deform shader
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec3 in_normal;
+
+// -- Instance attributes
+layout (location = 3) in mat4 in_modelMat; // Occupies locations 3-6
+layout (location = 7) in mat3 in_normalMat; // Occupies locations 7-9
+layout (location = 10) in vec3 in_color;
+layout (location = 11) in vec4 in_material; // ka, ks, kd, p
+
+// -- Output of vertex stage
+out vec3 vertexColor;
+
+void main() {
+    vec3 vertexPosition = fromHomogeneous( in_modelMat * vec4( in_position, 1.0 ) );
+    vec3 N = normalize( in_normalMat * in_normal );
+
+    vertexColor = shade( vertexPosition, N, in_color, in_material.x, in_material.y, in_material.z, in_material.w );
+    gl_Position = u_projectionMat * u_viewMat * vec4( vertexPosition, 1.0 );
+}
@@ -0,0 +1,21 @@
+#version 330 core
+
+// This is the buzz shader for balls that were already deformed by the deform
+// shader. It only transforms and lights the vertex.
+
+#include "buzz_common.glsl"
+
+// -- Input attributes, as captured from the deform shader
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec3 in_normal;
+
+// -- Output of vertex stage
+out vec3 vertexColor;
+
+void main() {
+    vec3 vertexPosition = fromHomogeneous( u_modelMat * vec4( in_position, 1.0 ) );
+    vec3 N = normalize( u_normalMat * in_normal );
+
+    vertexColor = shade( vertexPosition, N, u_color, u_ka, u_ks, u_kd, u_p );
+    gl_Position = u_projectionMat * u_viewMat * vec4( vertexPosition, 1.0 );
+}
@@ -0,0 +1,137 @@
+// Functions shared by the buzz vertex shaders. This file is included by
+// the shader loader, so it has no #version line of its own.
+//
+// The features of a variant are switched by the #defines that the
+// ShaderPermutations insert (see shader_permutations.h):
+//   BUZZ_NUM_LIGHTS    The number of global lights
+//   BUZZ_SPIKES        Extrudes the spikes; otherwise the model is drawn as is
+//   BUZZ_LIT           Lights the surface; otherwise it has the material color
+//   BUZZ_POINT_LIGHTS  Also lights the surface by the point lights near it
+
+// Define constants
+#define M_PI 3.141593
+
+struct Light {
+    vec3 position;
+    vec3 color;
+};
+
+// -- Uniform blocks, shared by all programs. Their layout and binding points
+//   are mirrored in uniforms.h
+layout (std140) uniform Lights {
+    Light u_lights[BUZZ_NUM_LIGHTS];
+};
+
+layout (std140) uniform Camera {
+    mat4 u_projectionMat;
+    mat4 u_viewMat;
+};
+
+// Only used by the non-instanced shaders
+layout (std140) uniform Object {
+    mat4 u_modelMat;
+    mat3 u_normalMat;
+    float u_spike;
+};
+
+// Only used by the non-instanced shaders
+layout (std140) uniform Material {
+    vec3 u_color;
+    float u_ka; // ambient multiplier
+    float u_ks; // specular multiplier
+    float u_kd; // diffuse multiplier
+    float u_p; // specular power
+};
+
+// The point lights of the LightGrid, binned into clusters of the view volume.
+//   Every light is two texels: its position and radius, and its color. Every
+//   cluster holds the offset and number of its light indices. The textures cover
+//   the whole ring buffer, in which this frame's data starts at u_gridOffsets.
+layout (std140) uniform LightGrid {
+    uvec4 u_gridSize; // tiles x and y on the screen, depth slices, number of lights
+    vec4 u_gridDepth; // scale and bias of the log of the depth
+    uvec4 u_gridOffsets; // first texel of the light data, clusters and light indices
+};
+
+uniform samplerBuffer u_lightData;
+uniform usamplerBuffer u_lightClusters;
+uniform usamplerBuffer u_lightIndices;
+
+vec3 getNormal( vec3 a, vec3 b, vec3 c ) {
+  return normalize( cross( b - a, c - a ) );
+}
+
+vec3 fromHomogeneous( vec4 v ) {
+    if ( v.w == 0 ) {
+        return v.xyz;
+    } else {
+        return v.xyz / v.w;
+    }
+}
+
+// Moves the vertex outward by the spike factor. Only vertices further than
+// 1 from the origin (the spike tips) are moved.
+vec3 spikePosition( vec3 position, float spike ) {
+#ifdef BUZZ_SPIKES
+    float xtraLen = max( 0, length( position ) - 1 );
+    return normalize( position ) * pow( 1 + xtraLen, spike );
+#else
+    return position;
+#endif
+}
+
+// Computes the color of a vertex lit by the global lights and the point lights near it
+// ka, ks and kd are the ambient, specular and diffuse multipliers, p is the specular power
+vec3 shade( vec3 vertexPosition, vec3 N, vec3 color, float ka, float ks, float kd, float p ) {
+#ifndef BUZZ_LIT
+    return color;
+#else
+    vec3 ambientLightColor = vec3( 0 );
+    vec3 diffuseLightColor = vec3( 0 );
+    vec3 specularLightColor = vec3( 0 );
+    for ( int i = 0; i < BUZZ_NUM_LIGHTS; i++ ) {
+        // Normalized vector pointing to the light
+        vec3 L = normalize( u_lights[i].position - vertexPosition );
+        vec3 R = 2 * dot( N, L ) * N - L; // Mirror of L along surface normal
+        vec3 V = normalize( -vertexPosition ); // Points toward the camera
+        ambientLightColor += ( u_lights[i].color * ka ) / BUZZ_NUM_LIGHTS; // Average ambient color
+        diffuseLightColor += u_lights[i].color * kd * max( 0, dot( N, L ) );
+        specularLightColor += u_lights[i].color * ks * pow( max( 0, dot( R, V ) ), p );
+    }
+
+#ifdef BUZZ_POINT_LIGHTS
+    // The point lights of the cluster this vertex lies in. The tiles on the screen
+    //   are surrounded by a guard band of one tile, so a vertex just outside the
+    //   view still finds the lights near it. Vertices beyond it use its outer tiles.
+    vec4 viewPosition = u_viewMat * vec4( vertexPosition, 1.0 );
+    vec4 clipPosition = u_projectionMat * viewPosition;
+    vec2 screen = ( clipPosition.xy / max( abs( clipPosition.w ), 1e-4 ) ) * 0.5 + 0.5;
+    ivec3 gridSize = ivec3( u_gridSize.xy + 2u, u_gridSize.z );
+    ivec3 cluster = ivec3( floor( screen * vec2( u_gridSize.xy ) ) + 1.0,
+                           floor( log( max( -viewPosition.z, 1e-6 ) ) * u_gridDepth.x + u_gridDepth.y ) );
+    cluster = clamp( cluster, ivec3( 0 ), gridSize - 1 );
+    int clusterIndex = ( cluster.z * gridSize.y + cluster.y ) * gridSize.x + cluster.x;
+    uvec2 range = texelFetch( u_lightClusters, int( u_gridOffsets.y ) + clusterIndex ).xy;
+    for ( uint i = range.x; i < range.x + range.y; i++ ) {
+        int light = int( u_gridOffsets.x ) + 2 * int( texelFetch( u_lightIndices, int( u_gridOffsets.z + i ) ).x );
+        vec4 positionRadius = texelFetch( u_lightData, light );
+        vec3 lightColor = texelFetch( u_lightData, light + 1 ).rgb;
+
+        vec3 toLight = positionRadius.xyz - vertexPosition;
+        float d = length( toLight ) / positionRadius.w;
+        // Falls off smoothly to nothing at the radius
+        float attenuation = clamp( 1 - d * d, 0, 1 );
+        attenuation *= attenuation;
+        if ( attenuation > 0 ) {
+            vec3 L = normalize( toLight );
+            vec3 R = 2 * dot( N, L ) * N - L;
+            vec3 V = normalize( -vertexPosition );
+            diffuseLightColor += attenuation * lightColor * kd * max( 0, dot( N, L ) );
+            specularLightColor += attenuation * lightColor * ks * pow( max( 0, dot( R, V ) ), p );
+        }
+    }
+#endif
+
+    return ( ambientLightColor + diffuseLightColor ) * color + specularLightColor;
+#endif
+}
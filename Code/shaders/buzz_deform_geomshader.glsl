@@ -0,0 +1,27 @@
+#version 330 core
+
+// This is the geometry stage of the indexed deform shader. It emits every
+// corner of the deformed triangle along with the face normal, which are
+// captured by transform feedback.
+
+#include "buzz_common.glsl"
+
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+// -- Input from the vertex stage
+in vec3 v_modelPosition[];
+
+// -- Captured output, in model space
+out vec3 tf_position;
+out vec3 tf_normal;
+
+void main() {
+    vec3 N = getNormal( v_modelPosition[0], v_modelPosition[1], v_modelPosition[2] );
+    for ( int i = 0; i < 3; i++ ) {
+        tf_position = v_modelPosition[i];
+        tf_normal = N;
+        EmitVertex( );
+    }
+    EndPrimitive( );
+}
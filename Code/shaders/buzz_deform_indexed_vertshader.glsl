@@ -0,0 +1,19 @@
+#version 330 core
+
+// This is the indexed variant of the deform vertex shader. The face normal
+// is computed by the deform geometry shader, which has all corners of the
+// triangle available.
+
+#include "buzz_common.glsl"
+
+uniform float u_deformSpike;
+
+// -- Input attributes
+layout (location = 0) in vec3 in_position;
+
+// -- Output of vertex stage
+out vec3 v_modelPosition;
+
+void main() {
+    v_modelPosition = spikePosition( in_position, u_deformSpike );
+}
@@ -0,0 +1,28 @@
+#version 330 core
+
+// This shader deforms the buzz batch once for a spike factor. It has no
+// fragment stage, as its output is captured by transform feedback (with the
+// rasterizer discarded). All balls with that spike factor are then drawn from
+// the captured positions and normals by the cached buzz shaders.
+
+#include "buzz_common.glsl"
+
+uniform float u_deformSpike;
+
+// -- Input attributes
+// Note that for every vertex, all positions in its triangle are also included
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec3 in_position2;
+layout (location = 2) in vec3 in_position3;
+
+// -- Captured output, in model space
+out vec3 tf_position;
+out vec3 tf_normal;
+
+void main() {
+    tf_position = spikePosition( in_position, u_deformSpike );
+    vec3 modP2 = spikePosition( in_position2, u_deformSpike );
+    vec3 modP3 = spikePosition( in_position3, u_deformSpike );
+
+    tf_normal = getNormal( tf_position, modP2, modP3 );
+}
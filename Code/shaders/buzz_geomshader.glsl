@@ -0,0 +1,39 @@
+#version 330 core
+
+// This is the geometry stage of the indexed buzz shaders. It receives the
+// deformed positions of all corners of a triangle, from which it computes the
+// face normal. The triangle is lit once, at its centroid, and all corners get
+// that color, which the rasterizer thus interpolates to a constant. This is
+// three times less lighting than shading every corner, at the cost of the
+// variation of the specular and point light terms across a face, which the
+// unindexed buzz shader does show.
+
+#include "buzz_common.glsl"
+
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 3) out;
+
+// -- Input from the vertex stage
+in vec3 v_modelPosition[];
+in vec3 v_worldPosition[];
+in mat3 v_normalMat[];
+in vec3 v_color[];
+in vec4 v_material[]; // ka, ks, kd, p
+
+// -- Output of geometry stage
+out vec3 vertexColor;
+
+void main() {
+    vec3 N = normalize( v_normalMat[0] * getNormal( v_modelPosition[0], v_modelPosition[1], v_modelPosition[2] ) );
+    vec3 centroid = ( v_worldPosition[0] + v_worldPosition[1] + v_worldPosition[2] ) / 3.0;
+    // The per-object parameters are the same for all corners
+    vec4 material = v_material[0];
+    vec3 faceColor = shade( centroid, N, v_color[0], material.x, material.y, material.z, material.w );
+
+    for ( int i = 0; i < 3; i++ ) {
+        vertexColor = faceColor;
+        gl_Position = u_projectionMat * u_viewMat * vec4( v_worldPosition[i], 1.0 );
+        EmitVertex( );
+    }
+    EndPrimitive( );
+}
@@ -0,0 +1,31 @@
+#version 330 core
+
+// This is the instanced variant of the indexed buzz vertex shader. All
+// per-object parameters are per-instance attributes.
+
+#include "buzz_common.glsl"
+
+// -- Input attributes
+layout (location = 0) in vec3 in_position;
+
+// -- Instance attributes
+layout (location = 3) in mat4 in_modelMat; // Occupies locations 3-6
+layout (location = 7) in mat3 in_normalMat; // Occupies locations 7-9
+layout (location = 10) in vec3 in_color;
+layout (location = 11) in vec4 in_material; // ka, ks, kd, p
+layout (location = 12) in float in_spike;
+
+// -- Output of vertex stage
+out vec3 v_modelPosition;
+out vec3 v_worldPosition;
+out mat3 v_normalMat;
+out vec3 v_color;
+out vec4 v_material; // ka, ks, kd, p
+
+void main() {
+    v_modelPosition = spikePosition( in_position, in_spike );
+    v_worldPosition = fromHomogeneous( in_modelMat * vec4( v_modelPosition, 1.0 ) );
+    v_normalMat = in_normalMat;
+    v_color = in_color;
+    v_material = in_material;
+}
@@ -0,0 +1,27 @@
+#version 330 core
+
+// This is the vertex stage of the indexed buzz shader. It only deforms the
+// vertex, as the face normal and the lighting are computed in the geometry
+// shader, which has all corners of the triangle available.
+
+#include "buzz_common.glsl"
+
+// -- Input attributes
+layout (location = 0) in vec3 in_position;
+
+// -- Output of vertex stage
+// The per-object parameters are passed on as well, such that the geometry
+//   shader is shared with the instanced variant
+out vec3 v_modelPosition;
+out vec3 v_worldPosition;
+out mat3 v_normalMat;
+out vec3 v_color;
+out vec4 v_material; // ka, ks, kd, p
+
+void main() {
+    v_modelPosition = spikePosition( in_position, u_spike );
+    v_worldPosition = fromHomogeneous( u_modelMat * vec4( v_modelPosition, 1.0 ) );
+    v_normalMat = u_normalMat;
+    v_color = u_color;
+    v_material = vec4( u_ka, u_ks, u_kd, u_p );
+}
@@ -0,0 +1,35 @@
+#version 330 core
+
+// This is the instanced variant of the buzz vertex shader. All per-object
+// parameters are per-instance attributes, such that all balls sharing a
+// batch are drawn with a single draw call.
+
+#include "buzz_common.glsl"
+
+// -- Input attributes
+// Note that for every vertex, all positions in its triangle are also included
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec3 in_position2;
+layout (location = 2) in vec3 in_position3;
+
+// -- Instance attributes
+layout (location = 3) in mat4 in_modelMat; // Occupies locations 3-6
+layout (location = 7) in mat3 in_normalMat; // Occupies locations 7-9
+layout (location = 10) in vec3 in_color;
+layout (location = 11) in vec4 in_material; // ka, ks, kd, p
+layout (location = 12) in float in_spike;
+
+// -- Output of vertex stage
+out vec3 vertexColor;
+
+void main() {
+    vec3 modP1 = spikePosition( in_position, in_spike );
+    vec3 modP2 = spikePosition( in_position2, in_spike );
+    vec3 modP3 = spikePosition( in_position3, in_spike );
+
+    vec3 vertexPosition = fromHomogeneous( in_modelMat * vec4( modP1, 1.0 ) );
+    vec3 N = normalize( in_normalMat * getNormal( modP1, modP2, modP3 ) );
+
+    vertexColor = shade( vertexPosition, N, in_color, in_material.x, in_material.y, in_material.z, in_material.w );
+    gl_Position = u_projectionMat * u_viewMat * vec4( vertexPosition, 1.0 );
+}
@@ -0,0 +1,268 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <algorithm>
+#include <cmath>
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+
+// Operations on a float, and (with SSE2) on F4, a vector of 4 floats. As both types
+// support the same operations, a kernel can be written once as a template over the
+// scalar type. It is then instantiated for F4 where available, and for float to
+// process the remainder or as fallback.
+
+// -- Scalar operations
+
+template< typename S >
+inline S load( const float *p );
+
+template<>
+inline float load< float >( const float *p ) {
+    return *p;
+}
+
+inline void store( float *p, float v ) {
+    *p = v;
+}
+
+inline float sqrtS( float a ) {
+    return std::sqrt( a );
+}
+
+// As maxps, which returns b if either is NaN, and of 0 and -0 the second
+inline float maxS( float a, float b ) {
+    return a > b ? a : b;
+}
+
+#if !defined( __SSE2__ )
+// With SSE2, powS( ) and sinCosS( ) run the F4 versions on a single lane instead (see below)
+inline float powS( float a, float b ) {
+    return std::pow( a, b );
+}
+#endif
+
+inline float floorS( float a ) {
+    return std::floor( a );
+}
+
+// Returns v / w, or v if w is 0
+inline float divideUnlessZero( float v, float w ) {
+    return w == 0 ? v : v / w;
+}
+
+// Returns a if a <= limit, and its mirror 2 * limit - a otherwise
+inline float mirrorAbove( float a, float limit ) {
+    return a > limit ? 2 * limit - a : a;
+}
+
+#if !defined( __SSE2__ )
+// Computes the sine and cosine of a (in radians)
+inline void sinCosS( float a, float& s, float& c ) {
+    s = std::sin( a );
+    c = std::cos( a );
+}
+#endif
+
+// The number of floats processed at once by the vector type
+const int SIMD_WIDTH = 4;
+
+#if defined( __SSE2__ )
+// -- Operations on 4 floats at once
+
+struct F4 {
+    __m128 v;
+
+    F4( ) { }
+    F4( __m128 v ) : v( v ) { }
+    F4( float f ) : v( _mm_set1_ps( f ) ) { }
+};
+
+template<>
+inline F4 load< F4 >( const float *p ) {
+    return _mm_loadu_ps( p );
+}
+
+inline void store( float *p, F4 v ) {
+    _mm_storeu_ps( p, v.v );
+}
+
+inline F4 operator+( F4 a, F4 b ) {
+    return _mm_add_ps( a.v, b.v );
+}
+
+inline F4 operator-( F4 a, F4 b ) {
+    return _mm_sub_ps( a.v, b.v );
+}
+
+inline F4 operator-( F4 a ) {
+    // Flips the sign bit, like a scalar negation
+    return _mm_xor_ps( a.v, _mm_set1_ps( -0.0f ) );
+}
+
+inline F4 operator*( F4 a, F4 b ) {
+    return _mm_mul_ps( a.v, b.v );
+}
+
+inline F4 operator/( F4 a, F4 b ) {
+    return _mm_div_ps( a.v, b.v );
+}
+
+inline F4 sqrtS( F4 a ) {
+    return _mm_sqrt_ps( a.v );
+}
+
+inline F4 maxS( F4 a, F4 b ) {
+    return _mm_max_ps( a.v, b.v );
+}
+
+inline F4 floorS( F4 a ) {
+    // Truncation rounds toward zero, so negative non-integers are one too high.
+    // Only valid for values that fit in an int.
+    __m128 truncated = _mm_cvtepi32_ps( _mm_cvttps_epi32( a.v ) );
+    __m128 tooHigh = _mm_cmpgt_ps( truncated, a.v );
+    return _mm_sub_ps( truncated, _mm_and_ps( tooHigh, _mm_set1_ps( 1.0f ) ) );
+}
+
+// Computes a^b for all lanes as 2^( b * log2( a ) ), with the logarithm and exponential
+// polynomials of the Cephes library. The relative error is below 2e-7 * max( 1, |b * log2( a )| ).
+// Unlike std::pow, negative a gives NaN for any b, and results below 2^-126 are flushed to 0.
+inline F4 powS( F4 a, float b ) {
+    if ( b == 0 ) {
+        return F4( 1.0f );
+    }
+    const __m128 one = _mm_set1_ps( 1.0f );
+
+    // a = m * 2^e, with m in [sqrt( 0.5 ), sqrt( 2 ) ), so log2( a ) = e + log2( m )
+    __m128 m = _mm_or_ps( _mm_and_ps( a.v, _mm_castsi128_ps( _mm_set1_epi32( 0x007FFFFF ) ) ), _mm_set1_ps( 0.5f ) );
+    __m128i exponent = _mm_sub_epi32( _mm_srli_epi32( _mm_castps_si128( a.v ), 23 ), _mm_set1_epi32( 126 ) );
+    __m128 e = _mm_cvtepi32_ps( exponent );
+    __m128 isSmall = _mm_cmplt_ps( m, _mm_set1_ps( 0.707106781186547524f ) );
+    e = _mm_sub_ps( e, _mm_and_ps( isSmall, one ) );
+    m = _mm_sub_ps( _mm_add_ps( m, _mm_and_ps( isSmall, m ) ), one );
+
+    // ln( 1 + m ) for m in [sqrt( 0.5 ) - 1, sqrt( 2 ) - 1)
+    __m128 z = _mm_mul_ps( m, m );
+    __m128 logPoly = _mm_set1_ps( 7.0376836292e-2f );
+    logPoly = _mm_add_ps( _mm_mul_ps( logPoly, m ), _mm_set1_ps( -1.1514610310e-1f ) );
+    logPoly = _mm_add_ps( _mm_mul_ps( logPoly, m ), _mm_set1_ps( 1.1676998740e-1f ) );
+    logPoly = _mm_add_ps( _mm_mul_ps( logPoly, m ), _mm_set1_ps( -1.2420140846e-1f ) );
+    logPoly = _mm_add_ps( _mm_mul_ps( logPoly, m ), _mm_set1_ps( 1.4249322787e-1f ) );
+    logPoly = _mm_add_ps( _mm_mul_ps( logPoly, m ), _mm_set1_ps( -1.6668057665e-1f ) );
+    logPoly = _mm_add_ps( _mm_mul_ps( logPoly, m ), _mm_set1_ps( 2.0000714765e-1f ) );
+    logPoly = _mm_add_ps( _mm_mul_ps( logPoly, m ), _mm_set1_ps( -2.4999993993e-1f ) );
+    logPoly = _mm_add_ps( _mm_mul_ps( logPoly, m ), _mm_set1_ps( 3.3333331174e-1f ) );
+    logPoly = _mm_mul_ps( _mm_mul_ps( logPoly, m ), z );
+    logPoly = _mm_add_ps( _mm_sub_ps( logPoly, _mm_mul_ps( z, _mm_set1_ps( 0.5f ) ) ), m );
+
+    // t = b * log2( a ), of which 2^t is split into 2^n * 2^f with n an integer
+    const __m128 bb = _mm_set1_ps( b );
+    __m128 t = _mm_add_ps( _mm_mul_ps( bb, e ), _mm_mul_ps( bb, _mm_mul_ps( logPoly, _mm_set1_ps( 1.44269504088896341f ) ) ) );
+    __m128 isOverflow = _mm_cmpge_ps( t, _mm_set1_ps( 128.0f ) );
+    __m128 isUnderflow = _mm_cmplt_ps( t, _mm_set1_ps( -126.0f ) );
+    // Clamped such that 2^n is a normal float. Only f is then off, for results that are replaced.
+    __m128 n = _mm_min_ps( _mm_max_ps( t, _mm_set1_ps( -126.0f ) ), _mm_set1_ps( 127.0f ) );
+    n = floorS( F4( _mm_add_ps( n, _mm_set1_ps( 0.5f ) ) ) ).v;
+    n = _mm_min_ps( n, _mm_set1_ps( 127.0f ) );
+    __m128 x = _mm_mul_ps( _mm_sub_ps( t, n ), _mm_set1_ps( 0.693147180559945309f ) );
+
+    // e^x for x in [-ln( 2 ) / 2, ln( 2 ) / 2]
+    z = _mm_mul_ps( x, x );
+    __m128 expPoly = _mm_set1_ps( 1.9875691500e-4f );
+    expPoly = _mm_add_ps( _mm_mul_ps( expPoly, x ), _mm_set1_ps( 1.3981999507e-3f ) );
+    expPoly = _mm_add_ps( _mm_mul_ps( expPoly, x ), _mm_set1_ps( 8.3334519073e-3f ) );
+    expPoly = _mm_add_ps( _mm_mul_ps( expPoly, x ), _mm_set1_ps( 4.1665795894e-2f ) );
+    expPoly = _mm_add_ps( _mm_mul_ps( expPoly, x ), _mm_set1_ps( 1.6666665459e-1f ) );
+    expPoly = _mm_add_ps( _mm_mul_ps( expPoly, x ), _mm_set1_ps( 5.0000001201e-1f ) );
+    expPoly = _mm_add_ps( _mm_add_ps( _mm_mul_ps( expPoly, z ), x ), one );
+    __m128 scale = _mm_castsi128_ps( _mm_slli_epi32( _mm_add_epi32( _mm_cvttps_epi32( n ), _mm_set1_epi32( 127 ) ), 23 ) );
+    __m128 result = _mm_mul_ps( expPoly, scale );
+
+    // The special cases, of which a denormal a is taken to be 0
+    const __m128 infinity = _mm_set1_ps( INFINITY );
+    __m128 isZero = _mm_cmplt_ps( a.v, _mm_set1_ps( 1.17549435e-38f ) ); // Also true for negative a
+    __m128 isInfinite = _mm_cmpeq_ps( a.v, infinity );
+    __m128 isInvalid = _mm_cmpnle_ps( _mm_setzero_ps( ), a.v ); // Negative, or NaN
+    // The results for a = 0 and for a = infinity are each other's reciprocal
+    const __m128 zeroResult = b > 0 ? _mm_setzero_ps( ) : infinity;
+    const __m128 infiniteResult = b > 0 ? infinity : _mm_setzero_ps( );
+    result = _mm_andnot_ps( isUnderflow, _mm_or_ps( _mm_and_ps( isOverflow, infinity ), _mm_andnot_ps( isOverflow, result ) ) );
+    result = _mm_or_ps( _mm_and_ps( isZero, zeroResult ), _mm_andnot_ps( isZero, result ) );
+    result = _mm_or_ps( _mm_and_ps( isInfinite, infiniteResult ), _mm_andnot_ps( isInfinite, result ) );
+    return _mm_or_ps( isInvalid, result );
+}
+
+inline F4 divideUnlessZero( F4 v, F4 w ) {
+    __m128 isZero = _mm_cmpeq_ps( w.v, _mm_setzero_ps( ) );
+    __m128 divided = _mm_div_ps( v.v, w.v );
+    return _mm_or_ps( _mm_and_ps( isZero, v.v ), _mm_andnot_ps( isZero, divided ) );
+}
+
+inline F4 mirrorAbove( F4 a, float limit ) {
+    __m128 isAbove = _mm_cmpgt_ps( a.v, _mm_set1_ps( limit ) );
+    __m128 mirrored = _mm_sub_ps( _mm_set1_ps( 2 * limit ), a.v );
+    return _mm_or_ps( _mm_and_ps( isAbove, mirrored ), _mm_andnot_ps( isAbove, a.v ) );
+}
+
+// Computes the sine and cosine of all lanes, with the polynomials of the Cephes
+// library. The error is within a few ulp for |a| up to about 8192.
+inline void sinCosS( F4 a, F4& s, F4& c ) {
+    const __m128 signMask = _mm_set1_ps( -0.0f );
+    __m128 x = a.v;
+    __m128 sinSign = _mm_and_ps( x, signMask );
+    x = _mm_andnot_ps( signMask, x ); // |a|
+
+    // The octant of |a|, rounded up to an even one
+    __m128i j = _mm_cvttps_epi32( _mm_mul_ps( x, _mm_set1_ps( 1.27323954473516f ) ) ); // 4 / pi
+    j = _mm_add_epi32( j, _mm_set1_epi32( 1 ) );
+    j = _mm_and_si128( j, _mm_set1_epi32( ~1 ) );
+    __m128 y = _mm_cvtepi32_ps( j );
+
+    __m128 swapSinSign = _mm_castsi128_ps( _mm_slli_epi32( _mm_and_si128( j, _mm_set1_epi32( 4 ) ), 29 ) );
+    __m128 usesSinPoly = _mm_castsi128_ps( _mm_cmpeq_epi32( _mm_and_si128( j, _mm_set1_epi32( 2 ) ), _mm_setzero_si128( ) ) );
+    __m128 cosSign = _mm_castsi128_ps( _mm_slli_epi32( _mm_andnot_si128( _mm_sub_epi32( j, _mm_set1_epi32( 2 ) ), _mm_set1_epi32( 4 ) ), 29 ) );
+    sinSign = _mm_xor_ps( sinSign, swapSinSign );
+
+    // Extended precision reduction to [-pi/4, pi/4]
+    x = _mm_sub_ps( x, _mm_mul_ps( y, _mm_set1_ps( 0.78515625f ) ) );
+    x = _mm_sub_ps( x, _mm_mul_ps( y, _mm_set1_ps( 2.4187564849853515625e-4f ) ) );
+    x = _mm_sub_ps( x, _mm_mul_ps( y, _mm_set1_ps( 3.77489497744594108e-8f ) ) );
+    __m128 z = _mm_mul_ps( x, x );
+
+    __m128 cosPoly = _mm_set1_ps( 2.443315711809948e-5f );
+    cosPoly = _mm_add_ps( _mm_mul_ps( cosPoly, z ), _mm_set1_ps( -1.388731625493765e-3f ) );
+    cosPoly = _mm_add_ps( _mm_mul_ps( cosPoly, z ), _mm_set1_ps( 4.166664568298827e-2f ) );
+    cosPoly = _mm_mul_ps( _mm_mul_ps( cosPoly, z ), z );
+    cosPoly = _mm_sub_ps( cosPoly, _mm_mul_ps( z, _mm_set1_ps( 0.5f ) ) );
+    cosPoly = _mm_add_ps( cosPoly, _mm_set1_ps( 1.0f ) );
+
+    __m128 sinPoly = _mm_set1_ps( -1.9515295891e-4f );
+    sinPoly = _mm_add_ps( _mm_mul_ps( sinPoly, z ), _mm_set1_ps( 8.3321608736e-3f ) );
+    sinPoly = _mm_add_ps( _mm_mul_ps( sinPoly, z ), _mm_set1_ps( -1.6666654611e-1f ) );
+    sinPoly = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( sinPoly, z ), x ), x );
+
+    // In odd quarter turns the polynomials swap roles
+    __m128 sinValue = _mm_or_ps( _mm_and_ps( usesSinPoly, sinPoly ), _mm_andnot_ps( usesSinPoly, cosPoly ) );
+    __m128 cosValue = _mm_or_ps( _mm_and_ps( usesSinPoly, cosPoly ), _mm_andnot_ps( usesSinPoly, sinPoly ) );
+    s = _mm_xor_ps( sinValue, sinSign );
+    c = _mm_xor_ps( cosValue, cosSign );
+}
+
+// -- Scalar versions of the polynomials above
+
+// The scalar powS( ) and sinCosS( ) compute a single lane of the F4 versions, such that a
+// kernel gives the same results for the remainder as for the vectors
+inline float powS( float a, float b ) {
+    return _mm_cvtss_f32( powS( F4( a ), b ).v );
+}
+
+inline void sinCosS( float a, float& s, float& c ) {
+    F4 s4, c4;
+    sinCosS( F4( a ), s4, c4 );
+    s = _mm_cvtss_f32( s4.v );
+    c = _mm_cvtss_f32( c4.v );
+}
+#endif
+
+#endif // SIMD_H
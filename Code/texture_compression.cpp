@@ -0,0 +1,603 @@
+#include "texture_compression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Documentation can be found in the texture_compression.h file
+
+// The OpenGL enums of the formats. Named differently from those in the OpenGL headers,
+// as this file is also compiled into the texture_compressor tool, which uses no OpenGL.
+static const quint32 FORMAT_RGB_S3TC_DXT1 = 0x83F0;
+static const quint32 FORMAT_RGBA_S3TC_DXT5 = 0x83F3;
+static const quint32 FORMAT_RG_RGTC2 = 0x8DBD;
+static const quint32 BASE_FORMAT_RG = 0x8227;
+static const quint32 BASE_FORMAT_RGB = 0x1907;
+static const quint32 BASE_FORMAT_RGBA = 0x1908;
+
+static const quint8 KTX_IDENTIFIER[ 12 ] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+static const quint32 KTX_ENDIANNESS = 0x04030201;
+static const int KTX_HEADER_SIZE = 64;
+
+int blockBytes( BlockFormat format ) {
+    return ( format == BlockFormat::BC1 ) ? 8 : 16;
+}
+
+size_t compressedSize( int width, int height, BlockFormat format ) {
+    return size_t( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 ) * blockBytes( format );
+}
+
+quint32 glInternalFormat( BlockFormat format ) {
+    switch ( format ) {
+    case BlockFormat::BC1: return FORMAT_RGB_S3TC_DXT1;
+    case BlockFormat::BC3: return FORMAT_RGBA_S3TC_DXT5;
+    case BlockFormat::BC5: return FORMAT_RG_RGTC2;
+    }
+    return 0;
+}
+
+// -- Block encoding
+
+namespace {
+
+// The pixels of a 4x4 block, row by row, as RGBA floats in [0, 255]
+struct Block {
+    float pixels[ 16 ][ 4 ];
+};
+
+// Reads the block at the given block coordinates. Pixels outside the image repeat the
+// nearest edge pixel, such that they do not affect the endpoints much.
+void fetchBlock( const RgbaImage& image, int blockX, int blockY, Block& block ) {
+    for ( int y = 0; y < 4; y++ ) {
+        const int py = std::min( blockY * 4 + y, image.height - 1 );
+        for ( int x = 0; x < 4; x++ ) {
+            const int px = std::min( blockX * 4 + x, image.width - 1 );
+            const quint8 *pixel = &image.pixels[ ( size_t( py ) * image.width + px ) * 4 ];
+            for ( int c = 0; c < 4; c++ ) {
+                block.pixels[ y * 4 + x ][ c ] = pixel[ c ];
+            }
+        }
+    }
+}
+
+void storeBlock( RgbaImage& image, int blockX, int blockY, const quint8 pixels[ 16 ][ 4 ] ) {
+    for ( int y = 0; y < 4 && blockY * 4 + y < image.height; y++ ) {
+        for ( int x = 0; x < 4 && blockX * 4 + x < image.width; x++ ) {
+            quint8 *pixel = &image.pixels[ ( size_t( blockY * 4 + y ) * image.width + blockX * 4 + x ) * 4 ];
+            std::memcpy( pixel, pixels[ y * 4 + x ], 4 );
+        }
+    }
+}
+
+void writeLe16( quint8 *p, quint16 v ) {
+    p[ 0 ] = quint8( v );
+    p[ 1 ] = quint8( v >> 8 );
+}
+
+quint16 readLe16( const quint8 *p ) {
+    return quint16( p[ 0 ] | ( p[ 1 ] << 8 ) );
+}
+
+quint32 readLe32( const quint8 *p ) {
+    return quint32( p[ 0 ] ) | ( quint32( p[ 1 ] ) << 8 ) | ( quint32( p[ 2 ] ) << 16 ) | ( quint32( p[ 3 ] ) << 24 );
+}
+
+// -- BC1 colors
+
+quint16 packRgb565( const float color[ 3 ] ) {
+    const int r = int( std::min( std::max( color[ 0 ], 0.0f ), 255.0f ) * 31 / 255 + 0.5f );
+    const int g = int( std::min( std::max( color[ 1 ], 0.0f ), 255.0f ) * 63 / 255 + 0.5f );
+    const int b = int( std::min( std::max( color[ 2 ], 0.0f ), 255.0f ) * 31 / 255 + 0.5f );
+    return quint16( ( r << 11 ) | ( g << 5 ) | b );
+}
+
+void unpackRgb565( quint16 packed, int color[ 3 ] ) {
+    const int r = ( packed >> 11 ) & 31;
+    const int g = ( packed >> 5 ) & 63;
+    const int b = packed & 31;
+    color[ 0 ] = ( r << 3 ) | ( r >> 2 );
+    color[ 1 ] = ( g << 2 ) | ( g >> 4 );
+    color[ 2 ] = ( b << 3 ) | ( b >> 2 );
+}
+
+// The four colors of a block in which the first endpoint is larger
+void colorPalette( quint16 c0, quint16 c1, bool isFourColor, int palette[ 4 ][ 4 ] ) {
+    unpackRgb565( c0, palette[ 0 ] );
+    unpackRgb565( c1, palette[ 1 ] );
+    for ( int c = 0; c < 3; c++ ) {
+        if ( isFourColor ) {
+            palette[ 2 ][ c ] = ( 2 * palette[ 0 ][ c ] + palette[ 1 ][ c ] ) / 3;
+            palette[ 3 ][ c ] = ( palette[ 0 ][ c ] + 2 * palette[ 1 ][ c ] ) / 3;
+        } else {
+            palette[ 2 ][ c ] = ( palette[ 0 ][ c ] + palette[ 1 ][ c ] ) / 2;
+            palette[ 3 ][ c ] = 0;
+        }
+    }
+    for ( int i = 0; i < 4; i++ ) {
+        palette[ i ][ 3 ] = 255;
+    }
+    if ( !isFourColor ) {
+        palette[ 3 ][ 3 ] = 0;
+    }
+}
+
+// Picks the nearest palette color for every pixel
+// @return The squared error of the block
+float colorIndices( const Block& block, quint16 c0, quint16 c1, quint32& indices ) {
+    int palette[ 4 ][ 4 ];
+    colorPalette( c0, c1, true, palette );
+
+    float error = 0;
+    indices = 0;
+    for ( int i = 0; i < 16; i++ ) {
+        float best = std::numeric_limits< float >::max( );
+        int bestIndex = 0;
+        for ( int j = 0; j < 4; j++ ) {
+            float distance = 0;
+            for ( int c = 0; c < 3; c++ ) {
+                const float d = block.pixels[ i ][ c ] - palette[ j ][ c ];
+                distance += d * d;
+            }
+            if ( distance < best ) {
+                best = distance;
+                bestIndex = j;
+            }
+        }
+        indices |= quint32( bestIndex ) << ( 2 * i );
+        error += best;
+    }
+    return error;
+}
+
+// Solves for the endpoints that best reproduce the pixels with the given indices
+// @return False if the indices do not determine the endpoints
+bool fitEndpoints( const Block& block, quint32 indices, float e0[ 3 ], float e1[ 3 ] ) {
+    // The weight of the first endpoint in the color of every index
+    static const float WEIGHTS[ 4 ] = { 1.0f, 0.0f, 2.0f / 3, 1.0f / 3 };
+
+    float aa = 0, ab = 0, bb = 0;
+    float ax[ 3 ] = { 0, 0, 0 }, bx[ 3 ] = { 0, 0, 0 };
+    for ( int i = 0; i < 16; i++ ) {
+        const float a = WEIGHTS[ ( indices >> ( 2 * i ) ) & 3 ];
+        const float b = 1 - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for ( int c = 0; c < 3; c++ ) {
+            ax[ c ] += a * block.pixels[ i ][ c ];
+            bx[ c ] += b * block.pixels[ i ][ c ];
+        }
+    }
+
+    const float determinant = aa * bb - ab * ab;
+    if ( std::abs( determinant ) < 1e-6f ) {
+        return false;
+    }
+    for ( int c = 0; c < 3; c++ ) {
+        e0[ c ] = ( bb * ax[ c ] - ab * bx[ c ] ) / determinant;
+        e1[ c ] = ( aa * bx[ c ] - ab * ax[ c ] ) / determinant;
+    }
+    return true;
+}
+
+// Orders the endpoints for the four-color mode, and remaps the indices accordingly
+void orderEndpoints( quint16& c0, quint16& c1, quint32& indices ) {
+    if ( c0 < c1 ) {
+        std::swap( c0, c1 );
+        // Swaps indices 0 and 1, and 2 and 3
+        indices ^= 0x55555555u;
+    } else if ( c0 == c1 ) {
+        indices = 0;
+    }
+}
+
+void encodeColorBlock( const Block& block, quint8 *out ) {
+    float mean[ 3 ] = { 0, 0, 0 };
+    for ( int i = 0; i < 16; i++ ) {
+        for ( int c = 0; c < 3; c++ ) {
+            mean[ c ] += block.pixels[ i ][ c ] / 16;
+        }
+    }
+
+    // The principal axis of the colors, by power iteration on their covariance
+    float covariance[ 3 ][ 3 ] = { };
+    for ( int i = 0; i < 16; i++ ) {
+        float d[ 3 ];
+        for ( int c = 0; c < 3; c++ ) {
+            d[ c ] = block.pixels[ i ][ c ] - mean[ c ];
+        }
+        for ( int r = 0; r < 3; r++ ) {
+            for ( int c = 0; c < 3; c++ ) {
+                covariance[ r ][ c ] += d[ r ] * d[ c ];
+            }
+        }
+    }
+    // Starts from the column of the channel that varies most, which is never orthogonal
+    // to the principal axis
+    int widest = 0;
+    for ( int c = 1; c < 3; c++ ) {
+        if ( covariance[ c ][ c ] > covariance[ widest ][ widest ] ) {
+            widest = c;
+        }
+    }
+    float axis[ 3 ] = { covariance[ 0 ][ widest ], covariance[ 1 ][ widest ], covariance[ 2 ][ widest ] };
+    if ( covariance[ widest ][ widest ] < 1e-6f ) {
+        axis[ 0 ] = axis[ 1 ] = axis[ 2 ] = 1;
+    }
+    for ( int iteration = 0; iteration < 8; iteration++ ) {
+        float next[ 3 ];
+        for ( int r = 0; r < 3; r++ ) {
+            next[ r ] = covariance[ r ][ 0 ] * axis[ 0 ] + covariance[ r ][ 1 ] * axis[ 1 ] + covariance[ r ][ 2 ] * axis[ 2 ];
+        }
+        const float length = std::max( std::max( std::abs( next[ 0 ] ), std::abs( next[ 1 ] ) ), std::abs( next[ 2 ] ) );
+        if ( length < 1e-6f ) {
+            break; // A single color, so any axis will do
+        }
+        for ( int c = 0; c < 3; c++ ) {
+            axis[ c ] = next[ c ] / length;
+        }
+    }
+    const float axisLength = std::sqrt( axis[ 0 ] * axis[ 0 ] + axis[ 1 ] * axis[ 1 ] + axis[ 2 ] * axis[ 2 ] );
+    for ( float& a : axis ) {
+        a /= axisLength;
+    }
+
+    // The endpoints span the colors along the axis, slightly inset, as the extremes
+    // are reproduced less often than the colors in between
+    float minT = std::numeric_limits< float >::max( );
+    float maxT = -std::numeric_limits< float >::max( );
+    for ( int i = 0; i < 16; i++ ) {
+        float t = 0;
+        for ( int c = 0; c < 3; c++ ) {
+            t += ( block.pixels[ i ][ c ] - mean[ c ] ) * axis[ c ];
+        }
+        minT = std::min( minT, t );
+        maxT = std::max( maxT, t );
+    }
+    const float inset = ( maxT - minT ) / 16;
+    float e0[ 3 ], e1[ 3 ];
+    for ( int c = 0; c < 3; c++ ) {
+        e0[ c ] = mean[ c ] + axis[ c ] * ( maxT - inset );
+        e1[ c ] = mean[ c ] + axis[ c ] * ( minT + inset );
+    }
+
+    quint16 c0 = packRgb565( e0 );
+    quint16 c1 = packRgb565( e1 );
+    quint32 indices;
+    float error = colorIndices( block, c0, c1, indices );
+    orderEndpoints( c0, c1, indices );
+
+    // Refines the endpoints for the chosen indices, as long as that reduces the error
+    for ( int iteration = 0; iteration < 2 && error > 0; iteration++ ) {
+        if ( !fitEndpoints( block, indices, e0, e1 ) ) {
+            break;
+        }
+        quint16 r0 = packRgb565( e0 );
+        quint16 r1 = packRgb565( e1 );
+        quint32 refinedIndices;
+        const float refinedError = colorIndices( block, r0, r1, refinedIndices );
+        if ( refinedError >= error ) {
+            break;
+        }
+        orderEndpoints( r0, r1, refinedIndices );
+        c0 = r0;
+        c1 = r1;
+        indices = refinedIndices;
+        error = refinedError;
+    }
+
+    writeLe16( out, c0 );
+    writeLe16( out + 2, c1 );
+    for ( int i = 0; i < 4; i++ ) {
+        out[ 4 + i ] = quint8( indices >> ( 8 * i ) );
+    }
+}
+
+void decodeColorBlock( const quint8 *in, bool allowThreeColor, quint8 pixels[ 16 ][ 4 ] ) {
+    const quint16 c0 = readLe16( in );
+    const quint16 c1 = readLe16( in + 2 );
+    int palette[ 4 ][ 4 ];
+    colorPalette( c0, c1, c0 > c1 || !allowThreeColor, palette );
+
+    const quint32 indices = readLe32( in + 4 );
+    for ( int i = 0; i < 16; i++ ) {
+        const int index = ( indices >> ( 2 * i ) ) & 3;
+        for ( int c = 0; c < 4; c++ ) {
+            pixels[ i ][ c ] = quint8( palette[ index ][ c ] );
+        }
+    }
+}
+
+// -- Single channels (BC3 alpha, and both BC5 channels)
+
+// The eight values between the endpoints, of which the first is larger
+void channelPalette( int v0, int v1, int palette[ 8 ] ) {
+    palette[ 0 ] = v0;
+    palette[ 1 ] = v1;
+    if ( v0 > v1 ) {
+        for ( int i = 1; i < 7; i++ ) {
+            palette[ i + 1 ] = ( ( 7 - i ) * v0 + i * v1 + 3 ) / 7;
+        }
+    } else {
+        for ( int i = 1; i < 5; i++ ) {
+            palette[ i + 1 ] = ( ( 5 - i ) * v0 + i * v1 + 2 ) / 5;
+        }
+        palette[ 6 ] = 0;
+        palette[ 7 ] = 255;
+    }
+}
+
+void encodeChannelBlock( const Block& block, int channel, quint8 *out ) {
+    float minValue = 255, maxValue = 0;
+    for ( int i = 0; i < 16; i++ ) {
+        minValue = std::min( minValue, block.pixels[ i ][ channel ] );
+        maxValue = std::max( maxValue, block.pixels[ i ][ channel ] );
+    }
+    const int v0 = int( maxValue + 0.5f );
+    const int v1 = int( minValue + 0.5f );
+    int palette[ 8 ];
+    channelPalette( v0, v1, palette );
+
+    quint64 indices = 0;
+    for ( int i = 0; i < 16; i++ ) {
+        const float value = block.pixels[ i ][ channel ];
+        int bestIndex = 0;
+        for ( int j = 1; j < 8; j++ ) {
+            if ( std::abs( value - palette[ j ] ) < std::abs( value - palette[ bestIndex ] ) ) {
+                bestIndex = j;
+            }
+        }
+        indices |= quint64( bestIndex ) << ( 3 * i );
+    }
+
+    out[ 0 ] = quint8( v0 );
+    out[ 1 ] = quint8( v1 );
+    for ( int i = 0; i < 6; i++ ) {
+        out[ 2 + i ] = quint8( indices >> ( 8 * i ) );
+    }
+}
+
+void decodeChannelBlock( const quint8 *in, int channel, quint8 pixels[ 16 ][ 4 ] ) {
+    int palette[ 8 ];
+    channelPalette( in[ 0 ], in[ 1 ], palette );
+
+    quint64 indices = 0;
+    for ( int i = 0; i < 6; i++ ) {
+        indices |= quint64( in[ 2 + i ] ) << ( 8 * i );
+    }
+    for ( int i = 0; i < 16; i++ ) {
+        pixels[ i ][ channel ] = quint8( palette[ ( indices >> ( 3 * i ) ) & 7 ] );
+    }
+}
+
+} // namespace
+
+std::vector< quint8 > compressImage( const RgbaImage& image, BlockFormat format ) {
+    const int blocksX = ( image.width + 3 ) / 4;
+    const int blocksY = ( image.height + 3 ) / 4;
+    const int numBytes = blockBytes( format );
+
+    std::vector< quint8 > blocks( compressedSize( image.width, image.height, format ) );
+    Block block;
+    for ( int by = 0; by < blocksY; by++ ) {
+        for ( int bx = 0; bx < blocksX; bx++ ) {
+            fetchBlock( image, bx, by, block );
+            quint8 *out = &blocks[ ( size_t( by ) * blocksX + bx ) * numBytes ];
+            switch ( format ) {
+            case BlockFormat::BC1:
+                encodeColorBlock( block, out );
+                break;
+            case BlockFormat::BC3:
+                encodeChannelBlock( block, 3, out );
+                encodeColorBlock( block, out + 8 );
+                break;
+            case BlockFormat::BC5:
+                encodeChannelBlock( block, 0, out );
+                encodeChannelBlock( block, 1, out + 8 );
+                break;
+            }
+        }
+    }
+    return blocks;
+}
+
+RgbaImage decompressImage( const quint8 *blocks, int width, int height, BlockFormat format ) {
+    const int blocksX = ( width + 3 ) / 4;
+    const int blocksY = ( height + 3 ) / 4;
+    const int numBytes = blockBytes( format );
+
+    RgbaImage image( width, height );
+    quint8 pixels[ 16 ][ 4 ];
+    for ( int by = 0; by < blocksY; by++ ) {
+        for ( int bx = 0; bx < blocksX; bx++ ) {
+            const quint8 *in = &blocks[ ( size_t( by ) * blocksX + bx ) * numBytes ];
+            switch ( format ) {
+            case BlockFormat::BC1:
+                decodeColorBlock( in, true, pixels );
+                break;
+            case BlockFormat::BC3:
+                decodeColorBlock( in + 8, false, pixels );
+                decodeChannelBlock( in, 3, pixels );
+                break;
+            case BlockFormat::BC5:
+                for ( int i = 0; i < 16; i++ ) {
+                    pixels[ i ][ 2 ] = 0;
+                    pixels[ i ][ 3 ] = 255;
+                }
+                decodeChannelBlock( in, 0, pixels );
+                decodeChannelBlock( in + 8, 1, pixels );
+                break;
+            }
+            storeBlock( image, bx, by, pixels );
+        }
+    }
+    return image;
+}
+
+// -- Mipmaps
+
+// Halves the image, where an odd last row or column is averaged with the one before it
+static RgbaImage downsample( const RgbaImage& image, bool isNormalMap ) {
+    RgbaImage result( std::max( 1, image.width / 2 ), std::max( 1, image.height / 2 ) );
+
+    for ( int y = 0; y < result.height; y++ ) {
+        for ( int x = 0; x < result.width; x++ ) {
+            float sum[ 4 ] = { 0, 0, 0, 0 };
+            for ( int dy = 0; dy < 2; dy++ ) {
+                const int sy = std::min( 2 * y + dy, image.height - 1 );
+                for ( int dx = 0; dx < 2; dx++ ) {
+                    const int sx = std::min( 2 * x + dx, image.width - 1 );
+                    const quint8 *pixel = &image.pixels[ ( size_t( sy ) * image.width + sx ) * 4 ];
+                    if ( isNormalMap ) {
+                        // Z follows from X and Y, as the normals have unit length
+                        const float nx = pixel[ 0 ] / 127.5f - 1;
+                        const float ny = pixel[ 1 ] / 127.5f - 1;
+                        sum[ 0 ] += nx;
+                        sum[ 1 ] += ny;
+                        sum[ 2 ] += std::sqrt( std::max( 0.0f, 1 - nx * nx - ny * ny ) );
+                    } else {
+                        for ( int c = 0; c < 4; c++ ) {
+                            sum[ c ] += pixel[ c ];
+                        }
+                    }
+                }
+            }
+
+            quint8 *out = &result.pixels[ ( size_t( y ) * result.width + x ) * 4 ];
+            if ( isNormalMap ) {
+                const float length = std::sqrt( sum[ 0 ] * sum[ 0 ] + sum[ 1 ] * sum[ 1 ] + sum[ 2 ] * sum[ 2 ] );
+                for ( int c = 0; c < 3; c++ ) {
+                    const float n = ( length > 0 ) ? sum[ c ] / length : ( c == 2 ? 1.0f : 0.0f );
+                    out[ c ] = quint8( std::min( std::max( ( n + 1 ) * 127.5f + 0.5f, 0.0f ), 255.0f ) );
+                }
+                out[ 3 ] = 255;
+            } else {
+                for ( int c = 0; c < 4; c++ ) {
+                    out[ c ] = quint8( sum[ c ] / 4 + 0.5f );
+                }
+            }
+        }
+    }
+    return result;
+}
+
+std::vector< RgbaImage > buildMipChain( const RgbaImage& image, bool isNormalMap ) {
+    std::vector< RgbaImage > levels;
+    levels.push_back( image );
+    while ( levels.back( ).width > 1 || levels.back( ).height > 1 ) {
+        levels.push_back( downsample( levels.back( ), isNormalMap ) );
+    }
+    return levels;
+}
+
+double psnr( const RgbaImage& a, const RgbaImage& b, int numChannels ) {
+    double sumSquared = 0;
+    const size_t numPixels = size_t( a.width ) * a.height;
+    for ( size_t i = 0; i < numPixels; i++ ) {
+        for ( int c = 0; c < numChannels; c++ ) {
+            const double d = double( a.pixels[ i * 4 + c ] ) - b.pixels[ i * 4 + c ];
+            sumSquared += d * d;
+        }
+    }
+    const double mse = sumSquared / ( numPixels * numChannels );
+    if ( mse == 0 ) {
+        return std::numeric_limits< double >::infinity( );
+    }
+    return 10 * std::log10( 255.0 * 255.0 / mse );
+}
+
+// -- KTX
+
+static void appendLe32( QByteArray& data, quint32 v ) {
+    const char bytes[ 4 ] = { char( v ), char( v >> 8 ), char( v >> 16 ), char( v >> 24 ) };
+    data.append( bytes, 4 );
+}
+
+QByteArray writeKtx( const CompressedTexture& texture ) {
+    quint32 baseFormat = BASE_FORMAT_RGB;
+    if ( texture.format == BlockFormat::BC3 ) {
+        baseFormat = BASE_FORMAT_RGBA;
+    } else if ( texture.format == BlockFormat::BC5 ) {
+        baseFormat = BASE_FORMAT_RG;
+    }
+
+    QByteArray data;
+    data.append( reinterpret_cast< const char * >( KTX_IDENTIFIER ), sizeof( KTX_IDENTIFIER ) );
+    appendLe32( data, KTX_ENDIANNESS );
+    appendLe32( data, 0 ); // glType, 0 for compressed formats
+    appendLe32( data, 1 ); // glTypeSize
+    appendLe32( data, 0 ); // glFormat, 0 for compressed formats
+    appendLe32( data, glInternalFormat( texture.format ) );
+    appendLe32( data, baseFormat );
+    appendLe32( data, quint32( texture.levels[ 0 ].width ) );
+    appendLe32( data, quint32( texture.levels[ 0 ].height ) );
+    appendLe32( data, 0 ); // pixelDepth
+    appendLe32( data, 0 ); // numberOfArrayElements
+    appendLe32( data, 1 ); // numberOfFaces
+    appendLe32( data, quint32( texture.levels.size( ) ) );
+    appendLe32( data, 0 ); // bytesOfKeyValueData
+
+    // Every block is a multiple of 4 bytes, so the levels need no padding
+    for ( const CompressedTexture::Level& level : texture.levels ) {
+        appendLe32( data, quint32( level.data.size( ) ) );
+        data.append( reinterpret_cast< const char * >( level.data.data( ) ), int( level.data.size( ) ) );
+    }
+    return data;
+}
+
+bool readKtx( const QByteArray& data, CompressedTexture& texture, QString& error ) {
+    const quint8 *p = reinterpret_cast< const quint8 * >( data.constData( ) );
+    const size_t size = size_t( data.size( ) );
+
+    if ( size < KTX_HEADER_SIZE || std::memcmp( p, KTX_IDENTIFIER, sizeof( KTX_IDENTIFIER ) ) != 0 ) {
+        error = "not a KTX file";
+        return false;
+    }
+    if ( readLe32( p + 12 ) != KTX_ENDIANNESS ) {
+        error = "big-endian KTX files are not supported";
+        return false;
+    }
+
+    const quint32 internalFormat = readLe32( p + 28 );
+    if ( internalFormat == FORMAT_RGB_S3TC_DXT1 ) {
+        texture.format = BlockFormat::BC1;
+    } else if ( internalFormat == FORMAT_RGBA_S3TC_DXT5 ) {
+        texture.format = BlockFormat::BC3;
+    } else if ( internalFormat == FORMAT_RG_RGTC2 ) {
+        texture.format = BlockFormat::BC5;
+    } else {
+        error = QString( "unsupported internal format 0x%1" ).arg( internalFormat, 0, 16 );
+        return false;
+    }
+
+    const int width = int( readLe32( p + 36 ) );
+    const int height = int( readLe32( p + 40 ) );
+    const quint32 depth = readLe32( p + 44 );
+    const quint32 numElements = readLe32( p + 48 );
+    const quint32 numFaces = readLe32( p + 52 );
+    const int numLevels = std::max( 1, int( readLe32( p + 56 ) ) );
+    const quint32 keyValueBytes = readLe32( p + 60 );
+    if ( width <= 0 || height <= 0 || depth > 1 || numElements > 0 || numFaces != 1 || numLevels > 32 ) {
+        error = "only single 2D textures are supported";
+        return false;
+    }
+
+    size_t offset = KTX_HEADER_SIZE + size_t( keyValueBytes );
+    texture.levels.clear( );
+    for ( int i = 0; i < numLevels; i++ ) {
+        CompressedTexture::Level level;
+        level.width = std::max( 1, width >> i );
+        level.height = std::max( 1, height >> i );
+
+        const size_t levelSize = compressedSize( level.width, level.height, texture.format );
+        if ( offset + 4 > size || readLe32( p + offset ) != levelSize || offset + 4 + levelSize > size ) {
+            error = QString( "mip level %1 is truncated or has the wrong size" ).arg( i );
+            return false;
+        }
+        level.data.assign( p + offset + 4, p + offset + 4 + levelSize );
+        texture.levels.push_back( std::move( level ) );
+        offset += 4 + ( ( levelSize + 3 ) & ~size_t( 3 ) );
+    }
+    return true;
+}
@@ -0,0 +1,109 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+
+// Block compression of textures (BC1, BC3 and BC5, also known as DXT1, DXT5 and RGTC2),
+// and the KTX container in which the compressed mip levels are stored. These formats
+// are decoded by the GPU itself, so a texture takes 4 (BC3 and BC5) to 8 (BC1) times less
+// memory and upload bandwidth than as RGBA8. Textures are compressed offline by the
+// texture_compressor tool in tools/, and loaded by the TextureLoader.
+
+/**
+ * @brief The RgbaImage struct is an uncompressed image, with tightly packed RGBA8 rows
+ */
+struct RgbaImage {
+    int width;
+    int height;
+    std::vector< quint8 > pixels;
+
+    RgbaImage( ) : width( 0 ), height( 0 ) { }
+    RgbaImage( int width, int height )
+        : width( width ), height( height ), pixels( size_t( width ) * height * 4 ) { }
+};
+
+/**
+ * @brief The BlockFormat enum lists the supported formats, each of which encodes
+ *   blocks of 4x4 pixels into a fixed number of bytes
+ */
+enum class BlockFormat {
+    BC1, // RGB in 8 bytes per block, for opaque color maps
+    BC3, // RGBA in 16 bytes per block, for color maps with alpha
+    BC5 // RG in 16 bytes per block, for the X and Y of tangent space normal maps
+};
+
+/**
+ * @brief The CompressedTexture struct is a block compressed texture with its mip levels
+ */
+struct CompressedTexture {
+    struct Level {
+        int width;
+        int height;
+        std::vector< quint8 > data;
+    };
+
+    BlockFormat format;
+    // From the full size to 1x1, or fewer
+    std::vector< Level > levels;
+};
+
+int blockBytes( BlockFormat format );
+/**
+ * @brief compressedSize The number of bytes of an image of the given size, of which
+ *   partial blocks at the right and bottom edge are stored as whole blocks
+ */
+size_t compressedSize( int width, int height, BlockFormat format );
+/**
+ * @brief glInternalFormat The OpenGL internal format of the block format, as
+ *   passed to glCompressedTexImage2D
+ */
+quint32 glInternalFormat( BlockFormat format );
+
+/**
+ * @brief compressImage Encodes the image block by block. The colors of a BC1 and BC3
+ *   block lie on a line between two endpoints, which is fitted to the principal axis of
+ *   the colors and then refined by least squares. Alpha, and both channels of BC5, are
+ *   encoded between their minimum and maximum.
+ * @return The blocks, row by row
+ */
+std::vector< quint8 > compressImage( const RgbaImage& image, BlockFormat format );
+
+/**
+ * @brief decompressImage Decodes blocks as the GPU would, which allows checking the quality
+ *   of the compression. BC1 yields an opaque image, and BC5 yields its two channels as red
+ *   and green, with blue 0 and alpha 255.
+ */
+RgbaImage decompressImage( const quint8 *blocks, int width, int height, BlockFormat format );
+
+/**
+ * @brief buildMipChain Halves the image with a box filter until it is 1x1
+ * @param image The full-size image, which is the first level
+ * @param isNormalMap If true, the red and green channels hold the X and Y of unit normals,
+ *   which are averaged as normals instead of colors
+ */
+std::vector< RgbaImage > buildMipChain( const RgbaImage& image, bool isNormalMap );
+
+/**
+ * @brief psnr The peak signal-to-noise ratio between two images of the same size, over their
+ *   first numChannels channels, in dB. Identical images yield infinity.
+ */
+double psnr( const RgbaImage& a, const RgbaImage& b, int numChannels );
+
+/**
+ * @brief writeKtx Serializes the texture to the KTX (version 1) container format
+ */
+QByteArray writeKtx( const CompressedTexture& texture );
+
+/**
+ * @brief readKtx Parses a KTX (version 1) file of one of the supported block formats
+ * @param data The contents of the file
+ * @param texture Receives the texture
+ * @param error Receives the reason the file could not be read
+ * @return True if the file was read, false otherwise
+ */
+bool readKtx( const QByteArray& data, CompressedTexture& texture, QString& error );
+
+#endif // TEXTURE_COMPRESSION_H
@@ -0,0 +1,228 @@
+#include "texture_loader.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QImage>
+#include <QtGlobal>
+#include <algorithm>
+#include <cstring>
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+
+// Documentation can be found in the texture_loader.h file
+
+// Copies the pixels of an ARGB32 image with its rows from bottom to top, as (0,0) is
+// bottom left in OpenGL, and every 0xAARRGGBB word swizzled to the bytes R, G, B, A
+static void flipToRgba( const QImage& image, quint8 *out ) {
+    const int width = image.width( );
+    const int height = image.height( );
+
+    for ( int y = 0; y < height; y++ ) {
+        const quint32 *src = reinterpret_cast< const quint32 * >( image.constScanLine( height - 1 - y ) );
+        quint8 *dst = out + size_t( y ) * width * 4;
+        int x = 0;
+#if defined( __SSE2__ ) && Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        // In memory a word is B, G, R, A, so only red and blue swap places
+        const __m128i alphaGreen = _mm_set1_epi32( int( 0xFF00FF00u ) );
+        const __m128i lowByte = _mm_set1_epi32( 0xFF );
+        for ( ; x + 4 <= width; x += 4 ) {
+            const __m128i p = _mm_loadu_si128( reinterpret_cast< const __m128i * >( src + x ) );
+            const __m128i red = _mm_and_si128( _mm_srli_epi32( p, 16 ), lowByte );
+            const __m128i blue = _mm_slli_epi32( _mm_and_si128( p, lowByte ), 16 );
+            const __m128i rgba = _mm_or_si128( _mm_and_si128( p, alphaGreen ), _mm_or_si128( red, blue ) );
+            _mm_storeu_si128( reinterpret_cast< __m128i * >( dst + 4 * x ), rgba );
+        }
+#endif
+        for ( ; x < width; x++ ) {
+            const QRgb pixel = src[ x ];
+            dst[ 4 * x ] = quint8( qRed( pixel ) );
+            dst[ 4 * x + 1 ] = quint8( qGreen( pixel ) );
+            dst[ 4 * x + 2 ] = quint8( qBlue( pixel ) );
+            dst[ 4 * x + 3 ] = quint8( qAlpha( pixel ) );
+        }
+    }
+}
+
+TextureLoader::TextureLoader( QOpenGLFunctions_3_3_Core *pGl )
+    : pGl( pGl ),
+      isCancelled( false ),
+      numLoading( 0 ) {
+    pGl->glGenBuffers( 1, &pbo );
+}
+
+TextureLoader::~TextureLoader( ) {
+    // The jobs that did not start yet return right away
+    isCancelled = true;
+    JobSystem::instance( ).wait( decodeJobs );
+
+    pGl->glDeleteBuffers( 1, &pbo );
+}
+
+void TextureLoader::load( const QString& file, Callback onLoaded ) {
+    numLoading++;
+
+    // Owned by the job until it is handed over to the ready queue
+    DecodedImage *pImage = new DecodedImage { file, std::move( onLoaded ), QString( ), 0, 0, { }, false, { } };
+    JobSystem::instance( ).submitBackground( [this, pImage]( ) {
+        std::unique_ptr< DecodedImage > image( pImage );
+        if ( isCancelled ) {
+            return;
+        }
+        decode( *image );
+
+        std::lock_guard< std::mutex > lock( readyMutex );
+        readyImages.push_back( std::move( image ) );
+    }, decodeJobs );
+}
+
+size_t TextureLoader::DecodedImage::numBytes( ) const {
+    if ( !isCompressed ) {
+        return pixels.size( );
+    }
+    size_t sum = 0;
+    for ( const CompressedTexture::Level& level : compressed.levels ) {
+        sum += level.data.size( );
+    }
+    return sum;
+}
+
+void TextureLoader::decode( DecodedImage& image ) {
+    // Errors are reported by update( ), which runs on the main thread
+    if ( image.file.endsWith( ".ktx", Qt::CaseInsensitive ) ) {
+        QFile file( image.file );
+        if ( !file.open( QIODevice::ReadOnly ) ) {
+            image.error = file.errorString( );
+        } else if ( readKtx( file.readAll( ), image.compressed, image.error ) ) {
+            image.isCompressed = true;
+            image.width = image.compressed.levels[ 0 ].width;
+            image.height = image.compressed.levels[ 0 ].height;
+        }
+        return;
+    }
+
+    QImage decoded( image.file );
+    if ( decoded.isNull( ) ) {
+        image.error = "the image could not be decoded";
+        return;
+    }
+    if ( decoded.format( ) != QImage::Format_ARGB32 ) {
+        decoded = decoded.convertToFormat( QImage::Format_ARGB32 );
+    }
+
+    image.width = decoded.width( );
+    image.height = decoded.height( );
+    image.pixels.resize( size_t( image.width ) * image.height * 4 );
+    flipToRgba( decoded, image.pixels.data( ) );
+}
+
+void TextureLoader::update( ) {
+    size_t numUploaded = 0;
+    while ( numUploaded < UPLOAD_BUDGET ) {
+        std::unique_ptr< DecodedImage > image;
+        {
+            std::lock_guard< std::mutex > lock( readyMutex );
+            if ( readyImages.empty( ) ) {
+                break;
+            }
+            // An image that would exceed the budget waits for the next frame, unless
+            // it is the first, as it would otherwise never fit
+            if ( numUploaded > 0 && numUploaded + readyImages.front( )->numBytes( ) > UPLOAD_BUDGET ) {
+                break;
+            }
+            image = std::move( readyImages.front( ) );
+            readyImages.pop_front( );
+        }
+        numLoading--;
+
+        if ( !image->error.isEmpty( ) ) {
+            qDebug( ) << ":: Failed to load texture" << image->file << "-" << image->error;
+            continue;
+        }
+        if ( image->isCompressed ) {
+            uploadCompressed( *image );
+        } else {
+            upload( *image );
+        }
+        numUploaded += image->numBytes( );
+    }
+}
+
+bool TextureLoader::stream( const std::vector< const std::vector< quint8 > * >& arrays ) {
+    size_t size = 0;
+    for ( const std::vector< quint8 > *pArray : arrays ) {
+        size += pArray->size( );
+    }
+
+    pGl->glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo );
+    // Orphans the previous storage, which the driver may still be copying from
+    pGl->glBufferData( GL_PIXEL_UNPACK_BUFFER, GLsizeiptr( size ), nullptr, GL_STREAM_DRAW );
+    quint8 *pMapped = static_cast< quint8 * >( pGl->glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr( size ),
+                                               GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT ) );
+    if ( pMapped != nullptr ) {
+        for ( const std::vector< quint8 > *pArray : arrays ) {
+            std::memcpy( pMapped, pArray->data( ), pArray->size( ) );
+            pMapped += pArray->size( );
+        }
+    }
+    // The contents are lost when the buffer got corrupted (e.g. by a mode switch) while mapped
+    if ( pMapped == nullptr || !pGl->glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER ) ) {
+        pGl->glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+        return false;
+    }
+    return true;
+}
+
+void TextureLoader::upload( const DecodedImage& image ) {
+    // An offset into the pixel buffer, unless streaming failed
+    const void *pPixels = stream( { &image.pixels } ) ? nullptr : image.pixels.data( );
+
+    GLuint texture;
+    pGl->glGenTextures( 1, &texture );
+    pGl->glBindTexture( GL_TEXTURE_2D, texture );
+    pGl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    pGl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    pGl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+    pGl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    // The rows are tightly packed, which the default alignment of 4 allows for RGBA
+    pGl->glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pPixels );
+    pGl->glGenerateMipmap( GL_TEXTURE_2D );
+    pGl->glBindTexture( GL_TEXTURE_2D, 0 );
+    pGl->glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+    image.onLoaded( texture );
+}
+
+void TextureLoader::uploadCompressed( const DecodedImage& image ) {
+    const std::vector< CompressedTexture::Level >& levels = image.compressed.levels;
+    std::vector< const std::vector< quint8 > * > arrays;
+    for ( const CompressedTexture::Level& level : levels ) {
+        arrays.push_back( &level.data );
+    }
+    const bool isStreamed = stream( arrays );
+
+    GLuint texture;
+    pGl->glGenTextures( 1, &texture );
+    pGl->glBindTexture( GL_TEXTURE_2D, texture );
+    pGl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    pGl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    pGl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels.size( ) > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+    pGl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    // The file may hold fewer levels than the full chain, which is then still complete
+    pGl->glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint( levels.size( ) ) - 1 );
+
+    const GLenum internalFormat = glInternalFormat( image.compressed.format );
+    size_t offset = 0;
+    for ( size_t i = 0; i < levels.size( ); i++ ) {
+        const CompressedTexture::Level& level = levels[ i ];
+        const void *pData = isStreamed ? reinterpret_cast< const void * >( offset ) : level.data.data( );
+        pGl->glCompressedTexImage2D( GL_TEXTURE_2D, GLint( i ), internalFormat, level.width, level.height, 0,
+                                     GLsizei( level.data.size( ) ), pData );
+        offset += level.data.size( );
+    }
+    pGl->glBindTexture( GL_TEXTURE_2D, 0 );
+    pGl->glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+    image.onLoaded( texture );
+}
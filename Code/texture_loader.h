@@ -0,0 +1,112 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include "job_system.h"
+#include "texture_compression.h"
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <QString>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief The TextureLoader class loads image files into mipmapped 2D textures, without
+ *   stalling the frames that are rendered in the meantime.
+ *
+ * An image is decoded as a background job of the JobSystem. The decoded pixels are flipped
+ *   (as (0,0) is bottom left in OpenGL) and swizzled to RGBA in a single SSE2 pass. Every
+ *   frame, update( ) uploads the decoded images within a byte budget through a pixel buffer
+ *   object. The storage of the buffer is orphaned before every upload, such that writing
+ *   to it never waits for the driver to finish reading an earlier upload, and the copy to
+ *   the texture happens asynchronously on the GPU. The mipmaps are generated by the GPU.
+ *
+ * Files with the .ktx extension hold block compressed textures (see texture_compression.h),
+ *   including their mip levels. They are uploaded as they are with glCompressedTexImage2D,
+ *   which takes 4 to 8 times less bandwidth and memory. BC1 and BC3 need the (ubiquitous)
+ *   EXT_texture_compression_s3tc extension, while BC5 is part of OpenGL 3.
+ *
+ * Many textures thus load progressively over several frames, while rendering continues.
+ *
+ * Note that this class can only be used after OpenGL is initialised. All functions,
+ *   including the destructor (which deletes the pixel buffer object), must be called on
+ *   the thread of the OpenGL context, with the context current.
+ */
+class TextureLoader {
+public:
+    /**
+     * @brief Callback Receives a loaded texture, of which it takes ownership (such as
+     *   by assigning it to a Material)
+     */
+    typedef std::function< void( GLuint ) > Callback;
+
+    TextureLoader( QOpenGLFunctions_3_3_Core *pGl );
+    ~TextureLoader( );
+
+    /**
+     * @brief load Starts loading the image file into a texture. Files that cannot be
+     *   decoded are reported, and never passed to the callback.
+     * @param file The path of the image or KTX file, which may be a resource
+     * @param onLoaded Called by update( ) once the texture is ready to be drawn with
+     */
+    void load( const QString& file, Callback onLoaded );
+
+    /**
+     * @brief update Uploads the images that finished decoding since the last call, up to
+     *   a budget of UPLOAD_BUDGET bytes per call. Meant to be called once per frame.
+     */
+    void update( );
+
+    /**
+     * @brief numPending The number of textures that have been requested, but not passed
+     *   to their callback yet
+     */
+    int numPending( ) const { return numLoading; }
+
+    // The maximum number of bytes uploaded by a call to update( ). A single larger
+    // image is still uploaded, but on its own.
+    static const size_t UPLOAD_BUDGET = 4 * 1024 * 1024;
+
+private:
+    struct DecodedImage {
+        QString file;
+        Callback onLoaded;
+        // Set if the file could not be decoded
+        QString error;
+
+        int width;
+        int height;
+        // Tightly packed RGBA rows, from bottom to top
+        std::vector< quint8 > pixels;
+
+        bool isCompressed;
+        CompressedTexture compressed;
+
+        size_t numBytes( ) const;
+    };
+
+    static void decode( DecodedImage& image );
+    void upload( const DecodedImage& image );
+    void uploadCompressed( const DecodedImage& image );
+    // Copies the arrays back to back into the orphaned pixel buffer, and leaves it bound
+    // @return False if that failed, in which case the pixel buffer is unbound
+    bool stream( const std::vector< const std::vector< quint8 > * >& arrays );
+
+    QOpenGLFunctions_3_3_Core *pGl;
+    GLuint pbo;
+
+    // The decode jobs, which refer to this loader
+    JobCounter decodeJobs;
+    std::atomic< bool > isCancelled;
+
+    // The images that were decoded, but not uploaded yet
+    std::mutex readyMutex;
+    std::deque< std::unique_ptr< DecodedImage > > readyImages;
+
+    int numLoading;
+};
+
+#endif // TEXTURE_LOADER_H
@@ -0,0 +1,25 @@
+#-------------------------------------------------
+#
+# Offline tool that times the parallel parts of a frame with a given number of job workers
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = job_benchmark
+TEMPLATE = app
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../job_system.cpp \
+    ../../light_grid.cpp \
+    ../../ring_buffer.cpp \
+    ../../culling.cpp
+
+HEADERS += ../../job_system.h \
+    ../../light_grid.h \
+    ../../ring_buffer.h \
+    ../../culling.h
@@ -0,0 +1,117 @@
+#include "culling.h"
+#include "job_system.h"
+#include "light_grid.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// Times the parts of a frame that run on the JobSystem, with the given number of workers, to
+// measure how they scale with the number of threads:
+// - lights: LightGrid::build( ), which bins the lights in a parallelFor( ) over the lights and
+//   one over the depth slices.
+// - bvh: BoundingVolumeHierarchy::build( ), which splits the tree into nested jobs.
+// - lights behind a long job: LightGrid::build( ) right after submitting a job that takes
+//   --long-job ms from the main thread, as the scene does with the evaluation of the next
+//   frame. The main thread should leave that job to the workers while it waits for the bins.
+// The JobSystem starts its workers once, so every thread count is a run of its own.
+//
+// Example: for n in 1 2 4 8; do job_benchmark --workers $n; done
+
+typedef std::mt19937 Random;
+
+static float uniform(Random& random, float min, float max)
+{
+    return std::uniform_real_distribution<float>(min, max)(random);
+}
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+static double maximum(const std::vector<double>& values)
+{
+    return *std::max_element(values.begin(), values.end());
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times the parallel parts of a frame with a given number of job workers.");
+    parser.addHelpOption();
+    QCommandLineOption workersOption("workers", "The number of workers, besides the main thread. 0 for the default.", "count", "0");
+    QCommandLineOption lightsOption("lights", "The number of point lights to bin.", "count", "4096");
+    QCommandLineOption spheresOption("spheres", "The number of bounding spheres to build the tree over.", "count", "100000");
+    QCommandLineOption longJobOption("long-job", "The duration of the long job, in ms.", "ms", "20");
+    QCommandLineOption runsOption("runs", "The number of runs, of which the median is reported.", "count", "31");
+    parser.addOption(workersOption);
+    parser.addOption(lightsOption);
+    parser.addOption(spheresOption);
+    parser.addOption(longJobOption);
+    parser.addOption(runsOption);
+    parser.process(a);
+    const int numLights = std::max(1, parser.value(lightsOption).toInt());
+    const int numSpheres = std::max(1, parser.value(spheresOption).toInt());
+    const int longJobMs = std::max(0, parser.value(longJobOption).toInt());
+    const int numRuns = std::max(1, parser.value(runsOption).toInt());
+
+    JobSystem::setNumWorkers(parser.value(workersOption).toInt());
+    JobSystem& jobs = JobSystem::instance();
+
+    // The lights and spheres are spread over the view of the camera at the origin
+    Random random(1);
+    LightGrid grid(nullptr);
+    for (int i = 0; i < numLights; i++) {
+        grid.lights().push_back(PointLight { QVector3D(uniform(random, -50, 50), uniform(random, -30, 30), uniform(random, -100, 0)),
+                                             QVector3D(1, 1, 1), uniform(random, 0.5f, 3.0f) });
+    }
+    std::vector<BoundingSphere> spheres(numSpheres);
+    for (BoundingSphere& sphere : spheres) {
+        sphere.center = QVector3D(uniform(random, -500, 500), uniform(random, -500, 500), uniform(random, -500, 500));
+        sphere.radius = uniform(random, 0.5f, 2.0f);
+    }
+    QMatrix4x4 viewMat;
+    QMatrix4x4 projectionMat;
+    projectionMat.perspective(60.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+
+    std::vector<double> lightTimes, bvhTimes, behindTimes;
+    BoundingVolumeHierarchy bvh;
+    QElapsedTimer timer;
+    for (int run = 0; run < numRuns; run++) {
+        timer.start();
+        grid.build(viewMat, projectionMat, 100.0f);
+        lightTimes.push_back(timer.nsecsElapsed() / 1e6);
+
+        timer.start();
+        bvh.build(spheres);
+        bvhTimes.push_back(timer.nsecsElapsed() / 1e6);
+
+        JobCounter longJob;
+        jobs.submit([longJobMs]() {
+            QElapsedTimer busy;
+            busy.start();
+            while (busy.elapsed() < longJobMs) { }
+        }, longJob);
+        timer.start();
+        grid.build(viewMat, projectionMat, 100.0f);
+        behindTimes.push_back(timer.nsecsElapsed() / 1e6);
+        jobs.wait(longJob);
+    }
+
+    // The main thread picking up the long job shows in the maximum rather than the median
+    qDebug().noquote() << QString(":: %1 threads, median / max of %2 runs: lights %3 / %4 ms, bvh %5 / %6 ms, "
+                                  "lights behind a long job %7 / %8 ms")
+                          .arg(jobs.numThreads()).arg(numRuns)
+                          .arg(median(lightTimes), 0, 'f', 3).arg(maximum(lightTimes), 0, 'f', 3)
+                          .arg(median(bvhTimes), 0, 'f', 3).arg(maximum(bvhTimes), 0, 'f', 3)
+                          .arg(median(behindTimes), 0, 'f', 3).arg(maximum(behindTimes), 0, 'f', 3);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#-------------------------------------------------
+#
+# Offline tool that checks pure renderer logic against reference versions of it
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = logic_check
+TEMPLATE = app
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../range_allocator.cpp \
+    ../../light_grid.cpp \
+    ../../ring_buffer.cpp \
+    ../../job_system.cpp \
+    ../../deform_cache.cpp \
+    ../../program_cache.cpp \
+    ../../shader_permutations.cpp \
+    ../../buzz_reference.cpp
+
+HEADERS += ../../range_allocator.h \
+    ../../light_grid.h \
+    ../../ring_buffer.h \
+    ../../job_system.h \
+    ../../radix_sort.h \
+    ../../uniforms.h \
+    ../../deform_cache.h \
+    ../../program_cache.h \
+    ../../shader_permutations.h \
+    ../../buzz_reference.h \
+    ../../batch.h
+
+RESOURCES += ../../resources.qrc
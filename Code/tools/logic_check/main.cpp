@@ -0,0 +1,477 @@
+#include "buzz_reference.h"
+#include "deform_cache.h"
+#include "light_grid.h"
+#include "program_cache.h"
+#include "radix_sort.h"
+#include "range_allocator.h"
+#include "shader_permutations.h"
+
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QFile>
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Checks the pure logic of the renderer, which needs no OpenGL context, against reference
+// versions of it:
+// - RangeAllocator, against an array of a flag per unit. After every allocation and free, the
+//   free ranges should be exactly the maximal runs of free units (so freed ranges are merged),
+//   and every allocation should return the first run that is large enough. reset( ), as used
+//   to compact a MeshArena, should leave a single free range.
+// - LightGrid, against the lights of every point within the radius of a light. Every such
+//   point in the view should be in a cluster that lists the light.
+// - radixSort( ), against std::stable_sort, including keys of which bytes are all the same.
+// - buzzVertexShaderBatch( ), against buzzVertexShader( ), bit for bit. The number of vertices is
+//   not a multiple of 4, such that the scalar remainder is compared as well.
+// - DeformCache, against buzzDeform( ), which extrudes the spikes as the buzz shaders do when
+//   they are drawn without the cache. A deform should be shared by the draws with the same
+//   spike factor, and its batch reused in the next frame. This check needs an OpenGL 3.3
+//   context, and is skipped without one.
+//
+// Example: QT_QPA_PLATFORM=offscreen logic_check --seed 7
+
+typedef std::mt19937 Random;
+
+static bool checkFreeRanges(const RangeAllocator& allocator, const std::vector<bool>& used)
+{
+    std::vector<std::pair<GLintptr, GLsizeiptr>> expected;
+    for (GLintptr i = 0; i < GLintptr(used.size()); i++) {
+        if (used[i]) continue;
+        if (!expected.empty() && expected.back().first + expected.back().second == i) {
+            expected.back().second++;
+        } else {
+            expected.emplace_back(i, 1);
+        }
+    }
+    const std::vector<std::pair<GLintptr, GLsizeiptr>> actual(allocator.ranges().begin(), allocator.ranges().end());
+    return actual == expected;
+}
+
+// The offset first-fit should return, or -1
+static GLintptr firstFit(const std::vector<bool>& used, GLsizeiptr size)
+{
+    GLsizeiptr run = 0;
+    for (GLintptr i = 0; i < GLintptr(used.size()); i++) {
+        run = used[i] ? 0 : run + 1;
+        if (run == size) return i + 1 - size;
+    }
+    return -1;
+}
+
+static bool checkRangeAllocator(Random& random, int numSteps)
+{
+    const GLsizeiptr capacity = 1024;
+    RangeAllocator allocator;
+    allocator.reset(0, capacity);
+    std::vector<bool> used(capacity, false);
+    std::vector<std::pair<GLintptr, GLsizeiptr>> allocations;
+
+    for (int step = 0; step < numSteps; step++) {
+        // Mostly allocates until it runs full, then mostly frees
+        const bool isAllocation = allocations.empty() || std::uniform_int_distribution<int>(0, 2)(random) != 0;
+        if (isAllocation) {
+            const GLsizeiptr size = std::uniform_int_distribution<GLsizeiptr>(1, 64)(random);
+            const GLintptr expected = firstFit(used, size);
+            const GLintptr offset = allocator.allocate(size);
+            if (offset != expected) {
+                qDebug() << "::   Step" << step << "allocated" << size << "at" << offset << "instead of" << expected;
+                return false;
+            }
+            if (offset >= 0) {
+                std::fill(used.begin() + offset, used.begin() + offset + size, true);
+                allocations.emplace_back(offset, size);
+            }
+        } else {
+            const size_t index = std::uniform_int_distribution<size_t>(0, allocations.size() - 1)(random);
+            const std::pair<GLintptr, GLsizeiptr> allocation = allocations[index];
+            allocations[index] = allocations.back();
+            allocations.pop_back();
+            allocator.free(allocation.first, allocation.second);
+            std::fill(used.begin() + allocation.first, used.begin() + allocation.first + allocation.second, false);
+        }
+        if (!checkFreeRanges(allocator, used)) {
+            qDebug() << "::   Step" << step << "left free ranges that differ from the free units";
+            return false;
+        }
+    }
+
+    // Packs the allocations back to back, as MeshArena::compact( ) does
+    GLsizeiptr packed = 0;
+    for (const std::pair<GLintptr, GLsizeiptr>& allocation : allocations) {
+        packed += allocation.second;
+    }
+    allocator.reset(packed, capacity);
+    std::fill(used.begin(), used.end(), false);
+    std::fill(used.begin(), used.begin() + packed, true);
+    if (!checkFreeRanges(allocator, used)) {
+        qDebug() << "::   Compacting to" << packed << "units did not leave a single free range";
+        return false;
+    }
+    return true;
+}
+
+static float uniform(Random& random, float min, float max)
+{
+    return std::uniform_real_distribution<float>(min, max)(random);
+}
+
+static bool checkLightGrid(Random& random, int numLights, int samplesPerLight)
+{
+    const float far = 100.0f;
+    // Binning does not use OpenGL, only upload( ) does
+    LightGrid grid(nullptr);
+    for (int i = 0; i < numLights; i++) {
+        grid.lights().push_back(PointLight { QVector3D(uniform(random, -20, 20), uniform(random, -12, 12), uniform(random, -40, 8)),
+                                             QVector3D(1, 1, 1), uniform(random, 0.2f, 5.0f) });
+    }
+    QMatrix4x4 projectionMat;
+    projectionMat.perspective(60.0f, 16.0f / 9.0f, 0.1f, far);
+    QMatrix4x4 viewMat;
+    viewMat.translate(0, 0, -10);
+    viewMat.rotate(20, 0, 1, 0);
+    grid.build(viewMat, projectionMat, far);
+
+    // Every cluster lists its lights once and in order, and no other references exist
+    int numReferences = 0;
+    for (int cluster = 0; cluster < LightGrid::NUM_CLUSTERS; cluster++) {
+        const std::vector<uint32_t> lights = grid.clusterLights(cluster);
+        if (std::adjacent_find(lights.begin(), lights.end(), std::greater_equal<uint32_t>()) != lights.end()) {
+            qDebug() << "::   Cluster" << cluster << "lists its lights out of order, or twice";
+            return false;
+        }
+        numReferences += int(lights.size());
+    }
+    if (numReferences != grid.numReferences()) {
+        qDebug() << "::   The clusters hold" << numReferences << "references instead of" << grid.numReferences();
+        return false;
+    }
+
+    // Every point that a light reaches, up to a tile beyond the screen, is in a cluster with it
+    const float guardX = 1 + 2.0f / LightGrid::TILES_X;
+    const float guardY = 1 + 2.0f / LightGrid::TILES_Y;
+    long numChecked = 0;
+    long numMissing = 0;
+    for (int light = 0; light < numLights; light++) {
+        const PointLight& pointLight = grid.lights()[light];
+        for (int sample = 0; sample < samplesPerLight; sample++) {
+            const QVector3D offset(uniform(random, -1, 1), uniform(random, -1, 1), uniform(random, -1, 1));
+            if (offset.lengthSquared() > 1) continue;
+            const QVector3D viewPosition = viewMat.map(pointLight.position + offset * pointLight.radius * 0.999f);
+            const QVector3D ndc = projectionMat.map(viewPosition);
+            const float depth = -viewPosition.z();
+            if (depth <= 0.1f || depth >= far || std::abs(ndc.x()) > guardX || std::abs(ndc.y()) > guardY) continue;
+
+            numChecked++;
+            const std::vector<uint32_t> lights = grid.clusterLights(grid.clusterOf(viewPosition));
+            if (!std::binary_search(lights.begin(), lights.end(), uint32_t(light))) {
+                numMissing++;
+            }
+        }
+    }
+    qDebug() << "::   Binned" << numLights << "lights into" << grid.numReferences() << "references, checked"
+             << numChecked << "points";
+    if (numMissing > 0) {
+        qDebug() << "::  " << numMissing << "points are in a cluster without their light";
+        return false;
+    }
+    return true;
+}
+
+struct SortEntry
+{
+    uint64_t key;
+    uint32_t index;
+};
+
+static bool checkRadixSort(Random& random, int numEntries)
+{
+    // Random keys, keys of which the upper bytes are the same (as the program id of a
+    // RenderQueue typically is), and keys that are all the same
+    const uint64_t masks[] = { ~uint64_t(0), 0xFFFFFF, 0 };
+    // Few distinct keys, such that the order of equal keys is checked too
+    std::vector<uint64_t> keys(1000);
+    for (uint64_t& key : keys) {
+        key = uint64_t(random()) << 32 | random();
+    }
+    std::vector<SortEntry> scratch;
+    for (uint64_t mask : masks) {
+        std::vector<SortEntry> entries(numEntries);
+        for (int i = 0; i < numEntries; i++) {
+            const size_t key = std::uniform_int_distribution<size_t>(0, keys.size() - 1)(random);
+            entries[i] = SortEntry { keys[key] & mask, uint32_t(i) };
+        }
+        std::vector<SortEntry> expected = entries;
+        std::stable_sort(expected.begin(), expected.end(),
+                         [](const SortEntry& a, const SortEntry& b) { return a.key < b.key; });
+        radixSort(entries, scratch);
+        for (int i = 0; i < numEntries; i++) {
+            if (entries[i].key != expected[i].key || entries[i].index != expected[i].index) {
+                qDebug() << "::   Keys masked by" << QString::number(mask, 16) << "differ at" << i;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Reads a shader from the resources of the application, with its includes resolved as
+// BuzzScene does
+static QString loadShaderSource(const QString& file)
+{
+    QFile shaderFile(":/shaders/" + file);
+    if (!shaderFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qDebug() << ":: Failed to open shader" << file;
+        return QString();
+    }
+
+    QString source;
+    QTextStream in(&shaderFile);
+    while (!in.atEnd()) {
+        const QString line = in.readLine();
+        if (line.startsWith("#include \"")) {
+            source += loadShaderSource(line.section('"', 1, 1));
+        } else {
+            source += line + "\n";
+        }
+    }
+    return source;
+}
+
+// A batch of buzz vertices without indices, in the vertex format of the deform shader
+class VertexBatch : public GeneralBatch
+{
+public:
+    VertexBatch(QOpenGLFunctions_3_3_Core *pGl, const QVector<BuzzVertex3>& vertices)
+        : pGl(pGl), numVertices(vertices.size())
+    {
+        pGl->glGenVertexArrays(1, &vao);
+        pGl->glGenBuffers(1, &vbo);
+        pGl->glBindVertexArray(vao);
+        pGl->glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        pGl->glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertices.size() * sizeof(BuzzVertex3)), vertices.constData(),
+                          GL_STATIC_DRAW);
+        for (GLuint i = 0; i < 3; i++) {
+            pGl->glEnableVertexAttribArray(i);
+            pGl->glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, sizeof(BuzzVertex3),
+                                       reinterpret_cast<void *>(i * sizeof(QVector3D)));
+        }
+        pGl->glBindVertexArray(0);
+        pGl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    ~VertexBatch()
+    {
+        pGl->glDeleteBuffers(1, &vbo);
+        pGl->glDeleteVertexArrays(1, &vao);
+    }
+
+    void draw() { bind(); drawBound(); }
+    void drawBound() { pGl->glDrawArrays(GL_TRIANGLES, 0, numVertices); }
+    void bind() { pGl->glBindVertexArray(vao); }
+    GLuint vertexArray() const { return vao; }
+    void drawInstanced(int numInstances) { pGl->glDrawArraysInstanced(GL_TRIANGLES, 0, numVertices, numInstances); }
+    int triangleCount() const { return numVertices / 3; }
+
+private:
+    QOpenGLFunctions_3_3_Core *pGl;
+    GLuint vao;
+    GLuint vbo;
+    int numVertices;
+};
+
+// Triangles around the unit sphere, of which the corners lie up to half a unit beyond it
+// such that the spikes extrude them
+static QVector<BuzzVertex3> randomTriangles(Random& random, int numTriangles)
+{
+    QVector<BuzzVertex3> vertices;
+    for (int t = 0; t < numTriangles; t++) {
+        QVector3D direction;
+        do {
+            direction = QVector3D(uniform(random, -1, 1), uniform(random, -1, 1), uniform(random, -1, 1));
+        } while (direction.lengthSquared() > 1 || direction.lengthSquared() < 0.01f);
+        direction.normalize();
+        const QVector3D u = QVector3D::crossProduct(direction, std::abs(direction.x()) < 0.9f ? QVector3D(1, 0, 0)
+                                                                                          : QVector3D(0, 1, 0)).normalized();
+        const QVector3D v = QVector3D::crossProduct(direction, u);
+        QVector3D corners[3] = { direction, direction + 0.1f * u, direction + 0.1f * v };
+        for (QVector3D& corner : corners) {
+            corner = corner.normalized() * uniform(random, 0.8f, 1.5f);
+        }
+        // As in BuzzBatch, every vertex lists the corners of its triangle starting at itself
+        vertices.append(BuzzVertex3(corners[0], corners[1], corners[2]));
+        vertices.append(BuzzVertex3(corners[1], corners[2], corners[0]));
+        vertices.append(BuzzVertex3(corners[2], corners[0], corners[1]));
+    }
+    return vertices;
+}
+
+static bool sameBits(float a, float b)
+{
+    return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+static bool checkBuzzReference(Random& random)
+{
+    BuzzShaderUniforms uniforms;
+    for (int i = 0; i < BuzzShaderUniforms::NUM_LIGHTS; i++) {
+        uniforms.lightPositions[i] = QVector3D(uniform(random, -10, 10), uniform(random, -10, 10), uniform(random, -10, 10));
+        uniforms.lightColors[i] = Color3D(uniform(random, 0, 1), uniform(random, 0, 1), uniform(random, 0, 1));
+    }
+    uniforms.spike = 1.7f;
+    uniforms.projectionMat.perspective(60.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+    uniforms.viewMat.translate(0, 0, -5);
+    uniforms.modelMat.rotate(30, 1, 1, 0);
+    uniforms.modelMat.scale(1.5f);
+    uniforms.normalMat = uniforms.modelMat.normalMatrix();
+    uniforms.color = Color3D(0.8f, 0.4f, 0.2f);
+    uniforms.ka = 0.2f;
+    uniforms.ks = 0.7f;
+    uniforms.kd = 0.6f;
+    uniforms.p = 32.0f;
+
+    // 3 * 1001 vertices, so the last one is handled by the scalar remainder
+    const QVector<BuzzVertex3> vertices = randomTriangles(random, 1001);
+    BuzzShaderOutputsSoA outputs;
+    buzzVertexShaderBatch(uniforms, BuzzVerticesSoA(vertices), outputs);
+
+    for (int i = 0; i < vertices.size(); i++) {
+        const BuzzShaderOutput expected = buzzVertexShader(uniforms, vertices[i]);
+        for (int c = 0; c < 4; c++) {
+            if (!sameBits(outputs.position[c][i], expected.position[c])) {
+                qDebug() << "::   Position" << c << "of vertex" << i << "differs:" << outputs.position[c][i] << "!="
+                         << expected.position[c];
+                return false;
+            }
+        }
+        for (int c = 0; c < 3; c++) {
+            if (!sameBits(outputs.color[c][i], expected.color[c])) {
+                qDebug() << "::   Color" << c << "of vertex" << i << "differs:" << outputs.color[c][i] << "!="
+                         << expected.color[c];
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Compares the positions and normals captured by a deform, read back through the buffer of
+// its VAO, with those of buzzDeform( )
+static bool compareDeform(QOpenGLFunctions_3_3_Core& gl, GeneralBatch& deformed, const QVector<BuzzVertex3>& vertices,
+                          float spike)
+{
+    if (deformed.triangleCount() * 3 != vertices.size()) {
+        qDebug() << "::   Spike" << spike << "deformed" << deformed.triangleCount() << "triangles instead of"
+                 << vertices.size() / 3;
+        return false;
+    }
+    std::vector<float> captured(6 * vertices.size());
+    deformed.bind();
+    GLint buffer = 0;
+    gl.glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &buffer);
+    gl.glBindBuffer(GL_ARRAY_BUFFER, GLuint(buffer));
+    gl.glGetBufferSubData(GL_ARRAY_BUFFER, 0, GLsizeiptr(captured.size() * sizeof(float)), captured.data());
+    gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl.glBindVertexArray(0);
+
+    // The GPU rounds pow( ) and normalize( ) differently, so the values are close but not equal
+    float maxError = 0;
+    for (int i = 0; i < vertices.size(); i++) {
+        QVector3D position, normal;
+        buzzDeform(vertices[i], spike, position, normal);
+        const float *pCaptured = &captured[6 * i];
+        const QVector3D capturedPosition(pCaptured[0], pCaptured[1], pCaptured[2]);
+        const QVector3D capturedNormal(pCaptured[3], pCaptured[4], pCaptured[5]);
+        maxError = std::max(maxError, (capturedPosition - position).length() / position.length());
+        maxError = std::max(maxError, (capturedNormal - normal).length());
+    }
+    qDebug() << "::   Spike" << spike << "deviates up to" << maxError << "from the direct deform";
+    return maxError <= 1e-4f;
+}
+
+static bool checkDeformCache(Random& random)
+{
+    QSurfaceFormat format;
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setVersion(3, 3);
+    QOffscreenSurface surface;
+    surface.setFormat(format);
+    surface.create();
+    QOpenGLContext context;
+    context.setFormat(format);
+    if (!context.create() || !context.makeCurrent(&surface)) {
+        qDebug() << "::   Skipped, as there is no OpenGL 3.3 context";
+        return true;
+    }
+    QOpenGLFunctions_3_3_Core gl;
+    gl.initializeOpenGLFunctions();
+
+    // The binary of the program is not kept
+    QTemporaryDir binaries;
+    ProgramCache programs(&gl, binaries.path());
+    DeformCache cache(&gl, programs, ShaderPermutations::specialize(loadShaderSource("buzz_deform_vertshader.glsl"),
+                                                                    ShaderPermutations::SPIKES));
+    if (!programs.finish()) {
+        return false;
+    }
+    const QVector<BuzzVertex3> vertices = randomTriangles(random, 1000);
+    VertexBatch source(&gl, vertices);
+
+    bool passed = true;
+    cache.beginFrame();
+    const std::shared_ptr<GeneralBatch> pFirst = cache.deform(source, 1.5f);
+    const std::shared_ptr<GeneralBatch> pShared = cache.deform(source, 1.5f);
+    const std::shared_ptr<GeneralBatch> pSecond = cache.deform(source, 2.5f);
+    if (pShared != pFirst || pSecond == pFirst || cache.numDeforms() != 2) {
+        qDebug() << "::   The same spike factor was deformed twice, or different ones shared a batch";
+        passed = false;
+    }
+    passed = compareDeform(gl, *pFirst, vertices, 1.5f) && passed;
+    passed = compareDeform(gl, *pSecond, vertices, 2.5f) && passed;
+
+    // The batches of the previous frame are deformed anew
+    cache.beginFrame();
+    const std::shared_ptr<GeneralBatch> pReused = cache.deform(source, 3.0f);
+    if (pReused != pFirst || cache.numDeforms() != 1) {
+        qDebug() << "::   The next frame did not reuse the batch of the previous one";
+        passed = false;
+    }
+    passed = compareDeform(gl, *pReused, vertices, 3.0f) && passed;
+
+    context.doneCurrent();
+    return passed;
+}
+
+static bool report(const char *name, bool passed)
+{
+    qDebug() << "::" << name << (passed ? "passed" : "FAILED");
+    return passed;
+}
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Checks pure renderer logic against reference versions of it.");
+    parser.addHelpOption();
+    QCommandLineOption seedOption("seed", "The seed of the random inputs.", "seed", "1");
+    parser.addOption(seedOption);
+    parser.process(a);
+
+    Random random(parser.value(seedOption).toUInt());
+    bool passed = report("RangeAllocator", checkRangeAllocator(random, 20000));
+    passed = report("LightGrid", checkLightGrid(random, 2000, 200)) && passed;
+    passed = report("radixSort", checkRadixSort(random, 100000)) && passed;
+    passed = report("buzzVertexShaderBatch", checkBuzzReference(random)) && passed;
+    passed = report("DeformCache", checkDeformCache(random)) && passed;
+    return passed ? 0 : 1;
+}
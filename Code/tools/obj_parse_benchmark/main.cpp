@@ -0,0 +1,66 @@
+#include "objparser.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <algorithm>
+#include <vector>
+
+// Times parseObjParallel on 1, 2, 4 and 8 threads, and prints the median time of every
+// thread count with its speedup over a single thread. The file is read into memory first,
+// so only the parsing is timed. The parser uses at most one thread per 256 KiB, so the
+// file should be several MB large to show any scaling.
+//
+// Example: obj_parse_benchmark --runs 20 large_model.obj
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times the OBJ parser on 1, 2, 4 and 8 threads.");
+    parser.addHelpOption();
+    QCommandLineOption runsOption("runs", "The number of runs per thread count.", "count", "10");
+    parser.addOption(runsOption);
+    parser.addPositionalArgument("input", "The .obj file to parse.");
+    parser.process(a);
+
+    const QStringList files = parser.positionalArguments();
+    if (files.size() != 1) {
+        parser.showHelp(1);
+    }
+    const int numRuns = std::max(1, parser.value(runsOption).toInt());
+
+    QFile file(files[0]);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << ":: Failed to read" << files[0];
+        return 1;
+    }
+    const QByteArray contents = file.readAll();
+    const char *begin = contents.constData();
+    const char *end = begin + contents.size();
+    qDebug() << ":: Parsing" << contents.size() << "bytes," << numRuns << "runs per thread count";
+
+    double singleMs = 0;
+    for (int numThreads = 1; numThreads <= 8; numThreads *= 2) {
+        std::vector<double> times;
+        for (int run = 0; run < numRuns; run++) {
+            ObjChunk chunk;
+            QElapsedTimer timer;
+            timer.start();
+            parseObjParallel(begin, end, chunk, numThreads);
+            times.push_back(timer.nsecsElapsed() / 1e6);
+        }
+        std::sort(times.begin(), times.end());
+        const double medianMs = times[times.size() / 2];
+        if (numThreads == 1) {
+            singleMs = medianMs;
+        }
+        qDebug() << "::  " << numThreads << "threads:" << medianMs << "ms (min" << times.front() << "ms), speedup"
+                 << singleMs / medianMs;
+    }
+    return 0;
+}
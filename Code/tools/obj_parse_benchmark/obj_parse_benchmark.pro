@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Offline tool that times the OBJ parser on different numbers of threads
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = obj_parse_benchmark
+TEMPLATE = app
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../objparser.cpp
+
+HEADERS += ../../objparser.h \
+    ../../parallel.h
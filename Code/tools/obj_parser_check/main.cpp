@@ -0,0 +1,179 @@
+#include "objparser.h"
+
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+#include <cstring>
+
+// Parses an .obj file with the in-place parser (serially and on several threads) and with
+// the QTextStream parser that Model used before, and checks that all records are the same.
+// Floats are compared by their bits, so any rounding difference is reported. Note that the
+// parallel parser uses fewer threads for small files (at most one per 256 KiB). Before the
+// file, a few literals beyond the range of a float are checked to parse as 0, as they do
+// with QString::toFloat().
+//
+// Example: obj_parser_check ../../models/buzzball.obj
+
+// The former parser of Model, which split every line into QStrings
+static void parseTextStream(QIODevice& device, ObjChunk& out)
+{
+    QTextStream in(&device);
+    while (!in.atEnd()) {
+        const QString line = in.readLine();
+        if (line.startsWith("#")) continue; // skip comments
+
+        const QStringList tokens = line.split(" ", QString::SkipEmptyParts);
+        if (tokens.isEmpty()) continue;
+
+        if (tokens[0] == "v") {
+            out.positions.append(QVector3D(tokens[1].toFloat(), tokens[2].toFloat(), tokens[3].toFloat()));
+        }
+        if (tokens[0] == "vn") {
+            out.normals.append(QVector3D(tokens[1].toFloat(), tokens[2].toFloat(), tokens[3].toFloat()));
+        }
+        if (tokens[0] == "vt") {
+            out.texCoords.append(QVector2D(tokens[1].toFloat(), tokens[2].toFloat()));
+        }
+        if (tokens[0] == "f") {
+            for (int i = 1; i != tokens.size(); ++i) {
+                const QStringList elements = tokens[i].split("/");
+                // -1 since .obj count from 1
+                out.indices.append(elements[0].toInt() - 1);
+                if (elements.size() > 1 && !elements[1].isEmpty()) {
+                    out.texCoordIndices.append(elements[1].toInt() - 1);
+                }
+                if (elements.size() > 2 && !elements[2].isEmpty()) {
+                    out.normalIndices.append(elements[2].toInt() - 1);
+                }
+            }
+        }
+    }
+}
+
+static bool sameBits(float a, float b)
+{
+    return std::memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+static bool sameValue(const QVector3D& a, const QVector3D& b)
+{
+    return sameBits(a.x(), b.x()) && sameBits(a.y(), b.y()) && sameBits(a.z(), b.z());
+}
+
+static bool sameValue(const QVector2D& a, const QVector2D& b)
+{
+    return sameBits(a.x(), b.x()) && sameBits(a.y(), b.y());
+}
+
+static bool sameValue(unsigned a, unsigned b)
+{
+    return a == b;
+}
+
+// Reports the first difference between two record arrays
+template<typename T>
+static bool compare(const char *name, const QVector<T>& expected, const QVector<T>& actual)
+{
+    if (expected.size() != actual.size()) {
+        qDebug() << "::  " << name << "count differs:" << expected.size() << "!=" << actual.size();
+        return false;
+    }
+    for (int i = 0; i < expected.size(); i++) {
+        if (!sameValue(expected[i], actual[i])) {
+            qDebug() << "::  " << name << "differ at" << i << ":" << expected[i] << "!=" << actual[i];
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool compare(const QString& label, const ObjChunk& expected, const ObjChunk& actual)
+{
+    // Not short-circuited, such that every kind of record is reported
+    bool same = compare("positions", expected.positions, actual.positions);
+    same = compare("normals", expected.normals, actual.normals) && same;
+    same = compare("texture coordinates", expected.texCoords, actual.texCoords) && same;
+    same = compare("position indices", expected.indices, actual.indices) && same;
+    same = compare("texture coordinate indices", expected.texCoordIndices, actual.texCoordIndices) && same;
+    same = compare("normal indices", expected.normalIndices, actual.normalIndices) && same;
+    qDebug() << "::" << label << (same ? "matches" : "DIFFERS");
+    return same;
+}
+
+// Checks that literals beyond the range of a float fail, and so are 0, while "inf" is kept
+static bool checkOutOfRange()
+{
+    QByteArray contents =
+        "v 1e39 -4e38 3.4028236e38\n"
+        "v 1e400 -1e400 123456789012345678901234567890e20\n"
+        "vn 3.4028234e38 -1e-50 inf\n"
+        "vt -inf 1.5\n";
+
+    QBuffer buffer(&contents);
+    buffer.open(QIODevice::ReadOnly);
+    ObjChunk expected;
+    parseTextStream(buffer, expected);
+
+    ObjChunk actual;
+    parseObj(contents.constData(), contents.constData() + contents.size(), actual);
+    bool same = compare("Out of range literals", expected, actual);
+
+    for (const QVector3D& position : actual.positions) {
+        if (!sameValue(position, QVector3D(0.0f, 0.0f, 0.0f))) {
+            qDebug() << "::   position" << position << "is not 0";
+            same = false;
+        }
+    }
+    return same;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Checks the in-place OBJ parser against the former QTextStream parser.");
+    parser.addHelpOption();
+    QCommandLineOption threadsOption("threads", "The number of threads of the parallel parser.", "count", "8");
+    parser.addOption(threadsOption);
+    parser.addPositionalArgument("input", "The .obj file to parse.");
+    parser.process(a);
+
+    const QStringList files = parser.positionalArguments();
+    if (files.size() != 1) {
+        parser.showHelp(1);
+    }
+
+    QFile file(files[0]);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << ":: Failed to read" << files[0];
+        return 1;
+    }
+    const QByteArray contents = file.readAll();
+    file.seek(0);
+
+    bool same = checkOutOfRange();
+
+    ObjChunk expected;
+    parseTextStream(file, expected);
+    qDebug() << ":: Read" << expected.positions.size() << "positions," << expected.normals.size() << "normals,"
+             << expected.texCoords.size() << "texture coordinates and" << expected.indices.size() << "corners";
+
+    const char *begin = contents.constData();
+    const char *end = begin + contents.size();
+
+    ObjChunk serial;
+    parseObj(begin, end, serial);
+    same = compare("parseObj", expected, serial) && same;
+
+    const int numThreads = parser.value(threadsOption).toInt();
+    ObjChunk parallel;
+    parseObjParallel(begin, end, parallel, numThreads);
+    same = compare(QString("parseObjParallel (%1 threads)").arg(numThreads), expected, parallel) && same;
+
+    return same ? 0 : 1;
+}
@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Offline tool that checks the in-place OBJ parser against the former QTextStream parser
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = obj_parser_check
+TEMPLATE = app
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../objparser.cpp
+
+HEADERS += ../../objparser.h \
+    ../../parallel.h
@@ -0,0 +1,107 @@
+#include "texture_compression.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QImage>
+#include <cstring>
+
+// Compresses an image to a block compressed KTX texture with all its mip levels, such
+// that the TextureLoader uploads it without any conversion. Every level is decoded again
+// and compared to the uncompressed level, and the texture is only written when the full
+// size level is within the PSNR bound.
+//
+// Example: texture_compressor --format bc5 --normal-map bricks_normal.png bricks_normal.ktx
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compresses an image to a BC1, BC3 or BC5 KTX texture.");
+    parser.addHelpOption();
+    QCommandLineOption formatOption("format", "Block format: bc1 (RGB), bc3 (RGBA) or bc5 (RG, for normal maps).", "format", "bc1");
+    QCommandLineOption normalMapOption("normal-map", "The image is a tangent space normal map, of which the mip levels are averaged as normals.");
+    QCommandLineOption noMipsOption("no-mips", "Store only the full size level.");
+    QCommandLineOption minPsnrOption("min-psnr", "Fail if the full size level decodes with a lower PSNR (in dB).", "dB", "30");
+    parser.addOptions({formatOption, normalMapOption, noMipsOption, minPsnrOption});
+    parser.addPositionalArgument("input", "The image to compress.");
+    parser.addPositionalArgument("output", "The KTX file to write.");
+    parser.process(a);
+
+    const QStringList files = parser.positionalArguments();
+    if (files.size() != 2) {
+        parser.showHelp(1);
+    }
+
+    BlockFormat format;
+    int numChannels;
+    const QString formatName = parser.value(formatOption).toLower();
+    if (formatName == "bc1") {
+        format = BlockFormat::BC1;
+        numChannels = 3;
+    } else if (formatName == "bc3") {
+        format = BlockFormat::BC3;
+        numChannels = 4;
+    } else if (formatName == "bc5") {
+        format = BlockFormat::BC5;
+        numChannels = 2;
+    } else {
+        qDebug() << ":: Unknown format" << formatName;
+        return 1;
+    }
+
+    QImage image(files[0]);
+    if (image.isNull()) {
+        qDebug() << ":: Failed to read" << files[0];
+        return 1;
+    }
+    // The rows go from bottom to top, as (0,0) is bottom left in OpenGL
+    image = image.convertToFormat(QImage::Format_RGBA8888).mirrored();
+
+    RgbaImage source(image.width(), image.height());
+    for (int y = 0; y < image.height(); y++) {
+        memcpy(&source.pixels[size_t(y) * image.width() * 4], image.constScanLine(y), size_t(image.width()) * 4);
+    }
+
+    std::vector<RgbaImage> levels;
+    if (parser.isSet(noMipsOption)) {
+        levels.push_back(source);
+    } else {
+        levels = buildMipChain(source, parser.isSet(normalMapOption));
+    }
+
+    CompressedTexture texture;
+    texture.format = format;
+    double sourcePsnr = 0;
+    for (size_t i = 0; i < levels.size(); i++) {
+        const RgbaImage& level = levels[i];
+        CompressedTexture::Level compressed = { level.width, level.height, compressImage(level, format) };
+
+        const double levelPsnr = psnr(level, decompressImage(compressed.data.data(), level.width, level.height, format), numChannels);
+        qDebug().nospace() << ":: Level " << i << " (" << level.width << "x" << level.height << "): " << levelPsnr << " dB";
+        if (i == 0) {
+            sourcePsnr = levelPsnr;
+        }
+        texture.levels.push_back(std::move(compressed));
+    }
+
+    // Small levels have too few pixels to be judged by, so only the full size one is checked
+    const double minPsnr = parser.value(minPsnrOption).toDouble();
+    if (sourcePsnr < minPsnr) {
+        qDebug() << ":: PSNR of" << sourcePsnr << "dB is below the bound of" << minPsnr << "dB, no texture written";
+        return 2;
+    }
+
+    const QByteArray ktx = writeKtx(texture);
+    QFile output(files[1]);
+    if (!output.open(QIODevice::WriteOnly) || output.write(ktx) != ktx.size()) {
+        qDebug() << ":: Failed to write" << files[1];
+        return 1;
+    }
+
+    const size_t uncompressedBytes = size_t(source.width) * source.height * 4 * (levels.size() > 1 ? 4.0 / 3 : 1);
+    qDebug() << ":: Wrote" << ktx.size() << "bytes," << double(uncompressedBytes) / ktx.size() << "times smaller than RGBA8";
+    return 0;
+}
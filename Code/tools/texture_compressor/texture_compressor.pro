@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Offline tool that compresses images to block compressed KTX textures
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = texture_compressor
+TEMPLATE = app
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../texture_compression.cpp
+
+HEADERS += ../../texture_compression.h
@@ -0,0 +1,183 @@
+#include "transform.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QQuaternion>
+#include <algorithm>
+#include <cmath>
+
+// Times Transform3f, which composes its matrix lazily in closed form, against the former
+// Transform3f, which rebuilt its matrix through the QMatrix4x4 chain on every setter and
+// left the normal matrix to QMatrix4x4::normalMatrix(). Every case is timed per
+// transform, in the way the animators use them. The matrices of both are compared first.
+//
+// Example: transform_benchmark --iterations 2000000
+
+// The former Transform3f, of which every setter rebuilt the matrix
+class ChainTransform {
+public:
+    ChainTransform() : scale(1, 1, 1) { }
+
+    ChainTransform(float scale, QVector3D rotation, QVector3D translation)
+            : translation(translation), rotation(rotation), scale(scale, scale, scale) {
+        rebuildMatrix();
+    }
+
+    QMatrix4x4 matrix() const { return _matrix; }
+    QMatrix3x3 normalMatrix() const { return _matrix.normalMatrix(); }
+
+    void setRotation(float xAngle, float yAngle, float zAngle) {
+        rotation = QVector3D(xAngle, yAngle, zAngle);
+        rebuildMatrix();
+    }
+
+    void setTranslationX(float x) {
+        translation.setX(x);
+        rebuildMatrix();
+    }
+
+    void setTranslationY(float y) {
+        translation.setY(y);
+        rebuildMatrix();
+    }
+
+    void setScale(float scale) {
+        this->scale = QVector3D(scale, scale, scale);
+        rebuildMatrix();
+    }
+
+private:
+    QVector3D translation;
+    QVector3D rotation;
+    QVector3D scale;
+    QMatrix4x4 _matrix;
+
+    void rebuildMatrix() {
+        // Note that for Qt matrices the operations are applied in reverse
+        _matrix.setToIdentity();
+        _matrix.translate(translation);
+        _matrix.rotate(QQuaternion::fromEulerAngles(rotation));
+        _matrix.scale(scale);
+    }
+};
+
+// Keeps the compiler from removing the timed work
+static volatile float sink;
+
+// The time per iteration of f, in nanoseconds, as the best of a few runs
+template<typename F>
+static double timePerIteration(int iterations, const F& f)
+{
+    double best = 1e30;
+    for (int run = 0; run < 5; run++) {
+        float sum = 0;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < iterations; i++) {
+            sum += f(i);
+        }
+        best = std::min(best, double(timer.nsecsElapsed()) / iterations);
+        sink = sum;
+    }
+    return best;
+}
+
+template<typename T>
+static float rotated(int i)
+{
+    T t;
+    t.setRotation(i * 0.1f, i * 0.2f, i * 0.3f);
+    return t.matrix().constData()[5];
+}
+
+template<typename T>
+static float bounced(int i)
+{
+    T t;
+    t.setTranslationY(i * 0.001f);
+    return t.matrix().constData()[13];
+}
+
+template<typename T>
+static float composed(int i)
+{
+    T t(0.5f, QVector3D(i * 0.1f, 0, i * 0.2f), QVector3D(1, 2, 3));
+    t.setTranslationX(float(i));
+    t.setScale(2);
+    return t.matrix().constData()[0];
+}
+
+template<typename T>
+static float withNormals(int i)
+{
+    T t;
+    t.setRotation(i * 0.1f, i * 0.2f, i * 0.3f);
+    return t.matrix().constData()[5] + t.normalMatrix()(1, 1);
+}
+
+// The largest difference of n elements, relative to the element (or absolute below 1)
+static float maxDifference(const float *a, const float *b, int n)
+{
+    float maxDiff = 0;
+    for (int k = 0; k < n; k++) {
+        maxDiff = std::max(maxDiff, std::abs(a[k] - b[k]) / std::max(1.0f, std::abs(b[k])));
+    }
+    return maxDiff;
+}
+
+// The largest difference of the matrices and normal matrices of both, over many transforms
+static float maxDifference()
+{
+    float maxDiff = 0;
+    for (int i = 0; i < 1000; i++) {
+        const float s = 0.5f + 0.01f * i;
+        const QVector3D r(i * 37.0f, i * -11.0f, i * 5.0f);
+        const QVector3D t(i * 0.3f, -i * 0.2f, 1.0f);
+        const Transform3f lazy(s, r, t);
+        const ChainTransform chain(s, r, t);
+        maxDiff = std::max(maxDiff, maxDifference(lazy.matrix().constData(), chain.matrix().constData(), 16));
+        maxDiff = std::max(maxDiff, maxDifference(lazy.normalMatrix().constData(), chain.normalMatrix().constData(), 9));
+    }
+    return maxDiff;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times the lazy Transform3f against the former QMatrix4x4 chain.");
+    parser.addHelpOption();
+    QCommandLineOption iterationsOption("iterations", "The number of transforms per case.", "count", "1000000");
+    parser.addOption(iterationsOption);
+    parser.process(a);
+    const int iterations = std::max(1, parser.value(iterationsOption).toInt());
+
+    const float maxDiff = maxDifference();
+    qDebug() << ":: Largest relative difference of the matrices:" << maxDiff;
+    if (maxDiff > 1e-5f) {
+        qDebug() << ":: The matrices DIFFER";
+        return 1;
+    }
+
+    struct Case {
+        const char *name;
+        float (*chain)(int);
+        float (*lazy)(int);
+    };
+    const Case cases[] = {
+        { "setRotation + matrix", rotated<ChainTransform>, rotated<Transform3f> },
+        { "setTranslationY + matrix", bounced<ChainTransform>, bounced<Transform3f> },
+        { "ctor + 2 setters + matrix", composed<ChainTransform>, composed<Transform3f> },
+        { "setRotation + matrix + normalMatrix", withNormals<ChainTransform>, withNormals<Transform3f> }
+    };
+    for (const Case& c : cases) {
+        const double chainNs = timePerIteration(iterations, c.chain);
+        const double lazyNs = timePerIteration(iterations, c.lazy);
+        qDebug().nospace() << "::   " << c.name << ": " << chainNs << " ns -> " << lazyNs << " ns ("
+                           << (chainNs / lazyNs) << "x)";
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Offline tool that times the lazy Transform3f against the former QMatrix4x4 chain
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = transform_benchmark
+TEMPLATE = app
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../transform.cpp
+
+HEADERS += ../../transform.h
@@ -0,0 +1,225 @@
+#include "ring_buffer.h"
+#include "uniforms.h"
+
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QMatrix4x4>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLShaderProgram>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Times the CPU cost per object of the non-instanced draw loop, before and after the uniform
+// buffers:
+// - by name: as Material::applyTo( ) and AnimatedBatch::render( ) did before, every material
+//   and object uniform is set with QOpenGLShaderProgram::setUniformValue( ) by its name.
+// - uniform buffers: the object block is written to a RingBuffer, after which every draw binds
+//   the range of its material and object, as the RenderQueue does (without skipping binds).
+// Every object is drawn as a single triangle with the rasterizer discarded, such that the
+// driver validates the changed state for every draw but the GPU has next to no work. The
+// GPU is waited for between runs, outside of the timings.
+//
+// Example: QT_QPA_PLATFORM=offscreen uniform_benchmark --objects 10000 --runs 50
+
+static const char *byNameSource =
+    "#version 330 core\n"
+    "uniform mat4 u_modelMat;\n"
+    "uniform mat3 u_normalMat;\n"
+    "uniform float u_spike;\n"
+    "uniform vec3 u_color;\n"
+    "uniform float u_ka;\n"
+    "uniform float u_ks;\n"
+    "uniform float u_kd;\n"
+    "uniform float u_p;\n"
+    "out vec3 vertexColor;\n"
+    "void main() {\n"
+    "    vec3 n = u_normalMat * vec3(0, 0, 1);\n"
+    "    gl_Position = u_modelMat * vec4(float(gl_VertexID) * u_spike, 0, 0, 1);\n"
+    "    vertexColor = u_color * (u_ka + u_kd * n.z) + vec3(u_ks * u_p);\n"
+    "}\n";
+
+// The blocks as in buzz_common.glsl
+static const char *uniformBufferSource =
+    "#version 330 core\n"
+    "layout (std140) uniform Object {\n"
+    "    mat4 u_modelMat;\n"
+    "    mat3 u_normalMat;\n"
+    "    float u_spike;\n"
+    "};\n"
+    "layout (std140) uniform Material {\n"
+    "    vec3 u_color;\n"
+    "    float u_ka;\n"
+    "    float u_ks;\n"
+    "    float u_kd;\n"
+    "    float u_p;\n"
+    "};\n"
+    "out vec3 vertexColor;\n"
+    "void main() {\n"
+    "    vec3 n = u_normalMat * vec3(0, 0, 1);\n"
+    "    gl_Position = u_modelMat * vec4(float(gl_VertexID) * u_spike, 0, 0, 1);\n"
+    "    vertexColor = u_color * (u_ka + u_kd * n.z) + vec3(u_ks * u_p);\n"
+    "}\n";
+
+static const int NUM_MATERIALS = 16;
+
+struct Object
+{
+    QMatrix4x4 modelMat;
+    QMatrix3x3 normalMat;
+    float spike;
+    int material;
+};
+
+static bool build(QOpenGLShaderProgram& program, const char *source)
+{
+    if (!program.addShaderFromSourceCode(QOpenGLShader::Vertex, source) || !program.link()) {
+        qDebug() << ":: Failed to build a program -" << program.log();
+        return false;
+    }
+    return true;
+}
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+int main(int argc, char *argv[])
+{
+    QGuiApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Times the per-object uniform updates by name against the uniform buffers.");
+    parser.addHelpOption();
+    QCommandLineOption objectsOption("objects", "The number of objects drawn per run.", "count", "10000");
+    QCommandLineOption runsOption("runs", "The number of runs, of which the median is reported.", "count", "50");
+    parser.addOption(objectsOption);
+    parser.addOption(runsOption);
+    parser.process(a);
+    const int numObjects = std::max(1, parser.value(objectsOption).toInt());
+    const int numRuns = std::max(1, parser.value(runsOption).toInt());
+
+    QSurfaceFormat format;
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setVersion(3, 3);
+    QOffscreenSurface surface;
+    surface.setFormat(format);
+    surface.create();
+    QOpenGLContext context;
+    context.setFormat(format);
+    if (!context.create() || !context.makeCurrent(&surface)) {
+        qDebug() << ":: Failed to create an OpenGL 3.3 context";
+        return 1;
+    }
+    QOpenGLFunctions_3_3_Core gl;
+    gl.initializeOpenGLFunctions();
+    qDebug() << ":: Using" << reinterpret_cast<const char *>(gl.glGetString(GL_RENDERER));
+
+    QOpenGLShaderProgram byName;
+    QOpenGLShaderProgram uniformBuffers;
+    if (!build(byName, byNameSource) || !build(uniformBuffers, uniformBufferSource)) {
+        return 1;
+    }
+    gl.glUniformBlockBinding(uniformBuffers.programId(), gl.glGetUniformBlockIndex(uniformBuffers.programId(), "Object"),
+                             UB_OBJECT);
+    gl.glUniformBlockBinding(uniformBuffers.programId(), gl.glGetUniformBlockIndex(uniformBuffers.programId(), "Material"),
+                             UB_MATERIAL);
+
+    // The materials, each at an offset that can be bound, as in a MaterialBuffer
+    GLint alignment = 256;
+    gl.glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    const GLsizeiptr materialStride = (GLsizeiptr(sizeof(MaterialBlock)) + alignment - 1) / alignment * alignment;
+    std::vector<char> materialData(NUM_MATERIALS * materialStride, 0);
+    MaterialBlock materials[NUM_MATERIALS];
+    for (int i = 0; i < NUM_MATERIALS; i++) {
+        materials[i] = MaterialBlock { { 0.5f, 0.1f * i, 0.2f }, 0.2f, 0.6f, 0.7f, 32.0f, 0.0f };
+        std::memcpy(&materialData[i * materialStride], &materials[i], sizeof(MaterialBlock));
+    }
+    GLuint materialBuffer;
+    gl.glGenBuffers(1, &materialBuffer);
+    gl.glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+    gl.glBufferData(GL_UNIFORM_BUFFER, GLsizeiptr(materialData.size()), materialData.data(), GL_STATIC_DRAW);
+    gl.glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    std::vector<Object> objects(numObjects);
+    for (int i = 0; i < numObjects; i++) {
+        objects[i].modelMat.translate(float(i % 100), float(i / 100), 0);
+        objects[i].modelMat.rotate(float(i), 0, 1, 0);
+        objects[i].normalMat = objects[i].modelMat.normalMatrix();
+        objects[i].spike = 1 + 0.001f * i;
+        objects[i].material = i % NUM_MATERIALS;
+    }
+
+    RingBuffer ringBuffer(&gl, numObjects * 256);
+    std::vector<RingBuffer::Allocation> allocations(numObjects);
+
+    GLuint vao;
+    gl.glGenVertexArrays(1, &vao);
+    gl.glBindVertexArray(vao);
+    gl.glEnable(GL_RASTERIZER_DISCARD);
+
+    QElapsedTimer timer;
+    std::vector<double> byNameNs;
+    std::vector<double> uniformBufferNs;
+    for (int run = 0; run < numRuns; run++) {
+        byName.bind();
+        timer.start();
+        for (const Object& object : objects) {
+            const MaterialBlock& material = materials[object.material];
+            byName.setUniformValue("u_color", QVector3D(material.color[0], material.color[1], material.color[2]));
+            byName.setUniformValue("u_ka", material.ka);
+            byName.setUniformValue("u_ks", material.ks);
+            byName.setUniformValue("u_kd", material.kd);
+            byName.setUniformValue("u_p", material.p);
+            byName.setUniformValue("u_modelMat", object.modelMat);
+            byName.setUniformValue("u_normalMat", object.normalMat);
+            byName.setUniformValue("u_spike", object.spike);
+            gl.glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        byNameNs.push_back(double(timer.nsecsElapsed()) / numObjects);
+        gl.glFinish();
+
+        uniformBuffers.bind();
+        ringBuffer.beginFrame();
+        timer.start();
+        for (int i = 0; i < numObjects; i++) {
+            const Object& object = objects[i];
+            // As AnimatedBatch::writeObject( )
+            allocations[i] = ringBuffer.allocateUniform(sizeof(ObjectBlock));
+            ObjectBlock& block = *static_cast<ObjectBlock *>(allocations[i].pData);
+            std::copy(object.modelMat.constData(), object.modelMat.constData() + 16, block.modelMat);
+            for (int column = 0; column < 3; column++) {
+                std::copy(object.normalMat.constData() + 3 * column, object.normalMat.constData() + 3 * column + 3,
+                          block.normalMat[column]);
+            }
+            block.spike = object.spike;
+        }
+        ringBuffer.unmap();
+        for (int i = 0; i < numObjects; i++) {
+            gl.glBindBufferRange(GL_UNIFORM_BUFFER, UB_MATERIAL, materialBuffer, objects[i].material * materialStride,
+                                 sizeof(MaterialBlock));
+            ringBuffer.bindUniform(UB_OBJECT, allocations[i]);
+            gl.glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        uniformBufferNs.push_back(double(timer.nsecsElapsed()) / numObjects);
+        ringBuffer.endFrame();
+        gl.glFinish();
+    }
+
+    const double before = median(byNameNs);
+    const double after = median(uniformBufferNs);
+    qDebug().nospace() << ":: Per object: " << before << " ns by name -> " << after << " ns with uniform buffers ("
+                       << (before / after) << "x), median of " << numRuns << " runs of " << numObjects << " objects";
+
+    gl.glDisable(GL_RASTERIZER_DISCARD);
+    gl.glBindVertexArray(0);
+    gl.glDeleteVertexArrays(1, &vao);
+    gl.glDeleteBuffers(1, &materialBuffer);
+    return 0;
+}
@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Offline tool that times the per-object uniform updates by name against the uniform buffers
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = uniform_benchmark
+TEMPLATE = app
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../ring_buffer.cpp
+
+HEADERS += ../../ring_buffer.h \
+    ../../uniforms.h
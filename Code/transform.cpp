@@ -5,13 +5,14 @@
 // See the "transform.h" header file for all documentation
 
 Transform3f::Transform3f( )
-    : scale( 1, 1, 1 ) {
+    : scale( 1, 1, 1 ), isMatrixDirty( false ), isNormalMatrixDirty( false ) {
 
 }
 
 Transform3f::Transform3f( float scale, QVector3D rotation, QVector3D translation )
-        : translation( translation ), rotation( rotation ), scale( scale, scale, scale ) {
-    rebuildMatrix( );
+        : translation( translation ), rotation( rotation ), scale( scale, scale, scale ),
+          isMatrixDirty( true ), isNormalMatrixDirty( true ) {
+
 }
 
 Transform3f Transform3f::Scale( float s ) {
@@ -33,12 +34,35 @@ Transform3f Transform3f::Translation( QVector3D v ) {
 }
 
 QMatrix4x4 Transform3f::matrix( ) const {
+    if ( isMatrixDirty ) {
+        rebuildMatrix( );
+    }
     return _matrix;
 }
 
+QMatrix3x3 Transform3f::normalMatrix( ) const {
+    if ( isNormalMatrixDirty ) {
+        // For M = T * R * S, the inverse transpose of R * S equals R * S^-1
+        if ( qFuzzyIsNull( scale.x( ) * scale.y( ) * scale.z( ) ) ) {
+            // As QMatrix4x4::normalMatrix( ), for a singular matrix
+            _normalMatrix.setToIdentity( );
+        } else {
+            QMatrix3x3 r = rotationMatrix( );
+            for ( int c = 0; c < 3; c++ ) {
+                const float invScale = 1.0f / scale[ c ];
+                for ( int row = 0; row < 3; row++ ) {
+                    _normalMatrix( row, c ) = r( row, c ) * invScale;
+                }
+            }
+        }
+        isNormalMatrixDirty = false;
+    }
+    return _normalMatrix;
+}
+
 void Transform3f::setRotation( float xAngle, float yAngle, float zAngle ) {
     rotation = QVector3D( xAngle, yAngle, zAngle );
-    rebuildMatrix( );
+    markDirty( );
 }
 
 void Transform3f::setTranslation( float x, float y, float z ) {
@@ -47,22 +71,22 @@ void Transform3f::setTranslation( float x, float y, float z ) {
 
 void Transform3f::setTranslation( QVector3D v ) {
     translation = v;
-    rebuildMatrix( );
+    markDirty( );
 }
 
 void Transform3f::setTranslationX( float x ) {
     translation.setX( x );
-    rebuildMatrix( );
+    markDirty( );
 }
 
 void Transform3f::setTranslationY( float y ) {
     translation.setY( y );
-    rebuildMatrix( );
+    markDirty( );
 }
 
 void Transform3f::setTranslationZ( float z ) {
     translation.setZ( z );
-    rebuildMatrix( );
+    markDirty( );
 }
 
 void Transform3f::setScale( float xScale, float yScale, float zScale ) {
@@ -71,17 +95,39 @@ void Transform3f::setScale( float xScale, float yScale, float zScale ) {
 
 void Transform3f::setScale( QVector3D scale ) {
     this->scale = scale;
-    rebuildMatrix( );
+    markDirty( );
 }
 
 void Transform3f::setScale( float scale ) {
     setScale( QVector3D( scale, scale, scale ) );
 }
 
-void Transform3f::rebuildMatrix( ) {
-    // Note that for Qt matrices the operations are applied in reverse
-    _matrix.setToIdentity( );
-    _matrix.translate( translation );
-    _matrix.rotate( QQuaternion::fromEulerAngles( rotation ) );
-    _matrix.scale( scale );
+void Transform3f::markDirty( ) {
+    isMatrixDirty = true;
+    isNormalMatrixDirty = true;
+}
+
+QMatrix3x3 Transform3f::rotationMatrix( ) const {
+    if ( rotation.isNull( ) ) {
+        return QMatrix3x3( );
+    }
+    return QQuaternion::fromEulerAngles( rotation ).toRotationMatrix( );
+}
+
+void Transform3f::rebuildMatrix( ) const {
+    // The closed form of translate( translation ) * rotate( rotation ) * scale( scale ),
+    // as a 4x4 product of these matrices only scales the columns of the rotation
+    QMatrix3x3 r = rotationMatrix( );
+    float *m = _matrix.data( );
+    for ( int c = 0; c < 3; c++ ) {
+        for ( int row = 0; row < 3; row++ ) {
+            m[ c * 4 + row ] = r( row, c ) * scale[ c ];
+        }
+        m[ c * 4 + 3 ] = 0;
+    }
+    m[ 12 ] = translation.x( );
+    m[ 13 ] = translation.y( );
+    m[ 14 ] = translation.z( );
+    m[ 15 ] = 1;
+    isMatrixDirty = false;
 }
@@ -3,6 +3,7 @@
 #ifndef TRANSFORM_H
 #define TRANSFORM_H
 
+#include <QMatrix3x3>
 #include <QMatrix4x4>
 #include <QVector3D>
 
@@ -18,6 +19,11 @@
  *   translation after rotation). This class ensures that any of the composing
  *   transformations can be modified, while maintaining their order as defined
  *   above.
+ *
+ * The matrix is only composed when it is requested after a change, such that
+ *   several setters may be called at the cost of a single composition. As a
+ *   consequence a single Transform3f may not be read from multiple threads at
+ *   once, though separate copies can.
  */
 class Transform3f {
 public:
@@ -58,6 +64,13 @@ public:
      */
     QMatrix4x4 matrix( ) const;
 
+    /**
+     * @brief normalMatrix Returns the normal matrix associated with this transform,
+     *   which equals matrix( ).normalMatrix( )
+     * @return The inverse transpose of the upper-left 3x3 part of the matrix
+     */
+    QMatrix3x3 normalMatrix( ) const;
+
     /**
      * @brief setRotation Sets the rotation of the transform.
      *   All values must be specified in degrees. Note that this resets
@@ -124,9 +137,15 @@ private:
     QVector3D rotation;
     QVector3D scale;
 
-    QMatrix4x4 _matrix;
+    // Composed upon request, when marked dirty
+    mutable QMatrix4x4 _matrix;
+    mutable QMatrix3x3 _normalMatrix;
+    mutable bool isMatrixDirty;
+    mutable bool isNormalMatrixDirty;
 
-    void rebuildMatrix( );
+    void markDirty( );
+    QMatrix3x3 rotationMatrix( ) const;
+    void rebuildMatrix( ) const;
 };
 
 #endif // TRANSFORM_H
@@ -0,0 +1,79 @@
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include <QOpenGLFunctions_3_3_Core>
+#include <cstdint>
+
+// The uniform blocks of the buzz shaders (see "shaders/buzz_common.glsl"). Their
+// contents are stored in uniform buffers, which are bound to these binding points.
+// All but the materials are written to the RingBuffer every frame.
+const GLuint UB_LIGHTS = 0;
+const GLuint UB_CAMERA = 1;
+const GLuint UB_MATERIAL = 2;
+const GLuint UB_OBJECT = 3;
+const GLuint UB_LIGHT_GRID = 4;
+
+// The texture units of the buffer textures of the LightGrid, after the units of the materials
+const GLint TU_LIGHT_DATA = 3;
+const GLint TU_LIGHT_CLUSTERS = 4;
+const GLint TU_LIGHT_INDICES = 5;
+
+const int NUM_LIGHTS = 3;
+
+/**
+ * @brief The LightsBlock struct is the std140 layout of the 'Lights' uniform block
+ */
+struct LightsBlock {
+    struct {
+        float position[ 3 ];
+        float padding0;
+        float color[ 3 ];
+        float padding1;
+    } lights[ NUM_LIGHTS ];
+};
+
+/**
+ * @brief The CameraBlock struct is the std140 layout of the 'Camera' uniform block.
+ *   The matrices are stored column-major.
+ */
+struct CameraBlock {
+    float projectionMat[ 16 ];
+    float viewMat[ 16 ];
+};
+
+/**
+ * @brief The MaterialBlock struct is the std140 layout of the 'Material' uniform block
+ */
+struct MaterialBlock {
+    float color[ 3 ];
+    float ka; // Ambient multiplier
+    float ks; // Specular multiplier
+    float kd; // Diffuse multiplier
+    float p; // Specular exponent (shininess)
+    float padding;
+};
+
+/**
+ * @brief The ObjectBlock struct is the std140 layout of the 'Object' uniform block, which
+ *   holds the per-object parameters of the non-instanced shaders. The matrices are stored
+ *   column-major, where every column of the normal matrix is padded to 4 floats.
+ */
+struct ObjectBlock {
+    float modelMat[ 16 ];
+    float normalMat[ 3 ][ 4 ];
+    float spike;
+    float padding[ 3 ];
+};
+
+/**
+ * @brief The LightGridBlock struct is the std140 layout of the 'LightGrid' uniform block
+ */
+struct LightGridBlock {
+    uint32_t size[ 4 ]; // Tiles along x and y on the screen, depth slices and point lights
+    float depthScale; // The slice of a depth d is log( d ) * depthScale + depthBias
+    float depthBias;
+    float padding[ 2 ];
+    uint32_t offsets[ 4 ]; // The first texel of the light data, clusters and light indices
+};
+
+#endif // UNIFORMS_H
@@ -1,12 +1,95 @@
 #include "mainview.h"
+#include "profiler.h"
 
 #include <QDebug>
+#include <algorithm>
+#include <cstdlib>
+
+// A random number in [min, max]
+static float randomIn(float min, float max)
+{
+    return min + (max - min) * std::rand() / float(RAND_MAX);
+}
 
 // Triggered by pressing a key
 void MainView::keyPressEvent(QKeyEvent *ev)
 {
     switch(ev->key()) {
     case 'A': qDebug() << "A pressed"; break;
+    case 'I':
+        scene.setInstancing(!scene.isInstancing());
+        qDebug() << "Instanced rendering" << (scene.isInstancing() ? "enabled" : "disabled");
+        break;
+    case 'B':
+        scene.setIndexedBatches(!scene.isIndexedBatches());
+        qDebug() << "Indexed buzz batches" << (scene.isIndexedBatches() ? "enabled" : "disabled");
+        break;
+    case 'C':
+        scene.setCulling(!scene.isCulling());
+        qDebug() << "Frustum culling" << (scene.isCulling() ? "enabled" : "disabled")
+                 << "- last frame:" << scene.visibleCount() << "visible," << scene.culledCount() << "culled";
+        break;
+    case 'L':
+        scene.setLevelsOfDetail(!scene.isLevelsOfDetail());
+        qDebug() << "Levels of detail" << (scene.isLevelsOfDetail() ? "enabled" : "disabled")
+                 << "- last frame, balls per level:" << QVector<int>::fromStdVector(scene.levelOfDetailCounts());
+        break;
+    case 'S':
+        scene.setSpiking(!scene.isSpiking());
+        makeCurrent();
+        scene.prepareShaders();
+        doneCurrent();
+        qDebug() << "Spike animation" << (scene.isSpiking() ? "enabled" : "disabled")
+                 << "-" << scene.shaderVariants() << "shader variants built so far";
+        break;
+    case 'D':
+        scene.setDeformCaching(!scene.isDeformCaching());
+        qDebug() << "Deform cache" << (scene.isDeformCaching() ? "enabled" : "disabled")
+                 << "- last frame:" << scene.deformations().numDeforms() << "deform passes over"
+                 << scene.deformations().numVerticesDeformed() << "vertices";
+        break;
+    case 'R': {
+        const RingBuffer& ringBuffer = scene.dynamicData();
+        qDebug() << "Ring buffer: last frame wrote" << ringBuffer.bytesWritten() << "of" << ringBuffer.frameCapacity()
+                 << "bytes, waited" << ringBuffer.fenceWaitNs() / 1000.0 << "us for the GPU";
+        break;
+    }
+    case 'Q': {
+        const RenderQueue::Stats& stats = scene.drawStats();
+        qDebug() << "Render queue: last frame drew" << stats.numPackets << "packets with" << stats.numStateChanges
+                 << "state changes," << stats.numStateChangesAvoided << "avoided";
+        break;
+    }
+    case 'G': {
+        // Adds point lights of saturated colors around the balls
+        LightGrid& grid = scene.pointLights();
+        for (int i = 0; i < 256; i++) {
+            QVector3D color(randomIn(0, 1), randomIn(0, 1), randomIn(0, 1));
+            color /= std::max(color.x(), std::max(color.y(), color.z()));
+            grid.lights().push_back(PointLight { QVector3D(randomIn(-8, 8), randomIn(-8, 8), randomIn(-8, 8)),
+                                                 0.5f * color, randomIn(1.5f, 3) });
+        }
+        makeCurrent();
+        scene.prepareShaders();
+        doneCurrent();
+        qDebug() << "Point lights:" << int(grid.lights().size()) << "- last frame:" << grid.numReferences()
+                 << "references to clusters, at most" << grid.maxPerCluster() << "in one cluster";
+        break;
+    }
+#ifdef BUZZ_PROFILING
+    case 'P': {
+        // Stopping the profiler prints its statistics and exports them
+        Profiler& profiler = Profiler::instance();
+        profiler.setEnabled(!profiler.isEnabled());
+        if (profiler.isEnabled()) {
+            qDebug() << "Profiling started";
+        } else {
+            profiler.dump();
+            profiler.writeCsv("buzz_profile.csv");
+        }
+        break;
+    }
+#endif
     default:
         // ev->key() is an integer. For alpha numeric characters keys it equivalent with the char value ('A' == 65, '1' == 49)
         // Alternatively, you could use Qt Key enums, see http://doc.qt.io/qt-5/qt.html#Key-enum